@@ -0,0 +1,861 @@
+/**
+ * Este ficheiro contem o harness de microbenchmarks das funções de vc.h e plate-recognizer.h
+ * @brief Mede cada função em imagens sintéticas e reais (640x480, 1080p, 4K) com warm-up, mediana e MAD
+ * @file bench.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> // PATH_MAX
+#include <time.h> // clock_gettime()
+#include <unistd.h> // getopt()
+#include "bench.h"
+#include "plate-recognizer.h"
+#include "histogram.h"
+#include "cpu.h"
+#include "planar.h"
+
+/**
+ * Tamanhos de imagem suportados
+ */
+static const struct {
+    const char *name;
+    int width, height;
+} bench_sizes[] = {
+        { "vga",   640,  480  },
+        { "1080p", 1920, 1080 },
+        { "4k",    3840, 2160 },
+};
+
+#define BENCH_NSIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+/**
+ * Tempo monotónico em nanosegundos
+ */
+long long bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Mediana e desvio absoluto mediano (MAD) de n amostras. Ordena o array
+ * @param samples
+ * @param n
+ * @param median
+ * @param mad
+ */
+void bench_stats(long long *samples, int n, long long *median, long long *mad) {
+    long long *dev = (long long *)malloc(n * sizeof(long long));
+
+    qsort(samples, n, sizeof(long long), compare_ll);
+    *median = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+    for (int i = 0; i < n; i++) dev[i] = llabs(samples[i] - *median);
+    qsort(dev, n, sizeof(long long), compare_ll);
+    *mad = (n % 2) ? dev[n / 2] : (dev[n / 2 - 1] + dev[n / 2]) / 2;
+    free(dev);
+}
+
+/**
+ * Imagem sintética parecida com a cena de uma matricula: fundo em gradiente com
+ * ruido, uma zona colorida e uma matricula branca com 6 caracteres escuros.
+ * Tem poucos blobs, para não exceder as etiquetas de vc_binary_blob_labelling()
+ * @param width
+ * @param height
+ * @param plate posição da matricula desenhada
+ * @return
+ */
+IVC *bench_synthetic(int width, int height, OVC *plate) {
+    IVC *img = vc_image_new(width, height, 3, 255);
+    unsigned int seed = 12345;
+
+    if (img == NULL) return NULL;
+
+    // Racio 4 e área acima de 3% da imagem, para ser aceite por isPlateCandidate()
+    OVC p = { 0 };
+    p.width = width * 3 / 10 + 8;
+    p.height = p.width / 4;
+    p.x = (width - p.width) / 2;
+    p.y = height * 3 / 5;
+    p.area = p.width * p.height;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char *px = img->data + y * img->bytesperline + x * 3;
+            int v = 40 + (80 * y) / height;
+
+            seed = seed * 1103515245 + 12345;
+            v += (seed >> 16) % 9 - 4;
+
+            if (x > width / 8 && x < width / 3 && y > height / 8 && y < height / 3) {
+                // Zona colorida (carroçaria)
+                px[0] = 200; px[1] = 30; px[2] = 30;
+                continue;
+            }
+            if (x >= p.x && x < p.x + p.width && y >= p.y && y < p.y + p.height) {
+                int cx = (x - p.x) * 8 / p.width;
+                int cy = (y - p.y) * 4 / p.height;
+                int sx = ((x - p.x) * 32 / p.width) % 4;
+                // 6 caracteres: colunas 1..6, linhas centrais, um traço por caracter
+                v = (cx >= 1 && cx <= 6 && cy >= 1 && cy <= 2 && sx >= 1 && sx <= 2) ? 20 : 230;
+            }
+            px[0] = px[1] = px[2] = (unsigned char)v;
+        }
+    }
+
+    if (plate != NULL) *plate = p;
+    return img;
+}
+
+/**
+ * Desenha uma matricula sintética: fundo branco e, se chars, 6 traços verticais escuros
+ */
+static void bench_draw_plate(IVC *img, OVC p, int chars) {
+    for (int y = p.y; y < p.y + p.height; y++) {
+        for (int x = p.x; x < p.x + p.width; x++) {
+            unsigned char *px = img->data + y * img->bytesperline + x * 3;
+            int cx = (x - p.x) * 8 / p.width;
+            int cy = (y - p.y) * 4 / p.height;
+            int sx = ((x - p.x) * 32 / p.width) % 4;
+            int v = (chars && cx >= 1 && cx <= 6 && cy >= 1 && cy <= 2 && sx >= 1 && sx <= 2) ? 20 : 230;
+            px[0] = px[1] = px[2] = (unsigned char)v;
+        }
+    }
+}
+
+/**
+ * Cena sintética com 4 rectângulos brancos com forma de matricula mas sem caracteres.
+ * Três são etiquetados antes da matricula verdadeira
+ * @param width
+ * @param height
+ * @param plate bounding box da matricula verdadeira
+ * @return
+ */
+IVC *bench_cluttered(int width, int height, OVC *plate) {
+    OVC base;
+    IVC *img = bench_synthetic(width, height, &base);
+
+    if (img == NULL) return NULL;
+
+    // Decoys com as dimensões da matricula
+    OVC p = base;
+
+    // Cima e meio à direita (a zona colorida está à esquerda), baixo à esquerda e à direita,
+    // afastados da matricula para não se juntarem no mesmo blob em 640x480
+    int right = width - width / 80 - p.width;
+    int xs[4] = { right, right, width / 80, right };
+    int ys[4] = { height / 20, height * 3 / 10, base.y, base.y };
+    for (int i = 0; i < 4; i++) {
+        OVC decoy = p;
+        decoy.x = xs[i];
+        decoy.y = ys[i];
+        bench_draw_plate(img, decoy, 0);
+    }
+
+    // A matricula verdadeira é a de bench_synthetic
+    if (plate != NULL) *plate = base;
+    return img;
+}
+
+/**
+ * Redimensiona uma imagem (vizinho mais próximo) para as dimensões pedidas
+ * @param src
+ * @param width
+ * @param height
+ * @return
+ */
+IVC *bench_resize(IVC *src, int width, int height) {
+    IVC *dst = vc_image_new(width, height, src->channels, src->levels);
+
+    if (dst == NULL) return NULL;
+
+    for (int y = 0; y < height; y++) {
+        unsigned char *rowsrc = src->data + (long)(y * src->height / height) * src->bytesperline;
+        unsigned char *rowdst = dst->data + (long)y * dst->bytesperline;
+
+        for (int x = 0; x < width; x++) {
+            memcpy(rowdst + x * dst->channels, rowsrc + (x * src->width / width) * src->channels, src->channels);
+        }
+    }
+    return dst;
+}
+
+static IVC *clone(IVC *src) {
+    IVC *dst = vc_image_new(src->width, src->height, src->channels, src->levels);
+    if (dst != NULL) memcpy(dst->data, src->data, src->bytesperline * src->height);
+    return dst;
+}
+
+static void restore(IVC *dst, IVC *src) {
+    memcpy(dst->data, src->data, src->bytesperline * src->height);
+}
+
+/**
+ * Conjunto de imagens de entrada de uma medição (um tamanho, uma origem)
+ */
+typedef struct {
+    IVC *rgb, *gray, *binary, *labels;
+    IVC *rgb_work, *gray_work, *binary_work;
+    IVC *dst1, *dst3, *plate_bin;
+    VC_PLANAR *planar, *planar_work;
+    OVC *blobs;
+    int nblobs;
+    OVC plate;
+    VC_RECOGNIZER ctx;
+    char file[PATH_MAX];
+    char dir[PATH_MAX];
+    char out[PATH_MAX];
+} BENCH_DATA;
+
+/**
+ * Prepara as entradas de cada estágio a partir da imagem RGB, com os mesmos
+ * parâmetros do pipeline principal de plate-recognizer.c
+ */
+static int data_init(BENCH_DATA *d, IVC *rgb, OVC *plate, const char *dir) {
+    memset(d, 0, sizeof(BENCH_DATA));
+    d->rgb = rgb;
+    if (plate != NULL) d->plate = *plate;
+    d->rgb_work = clone(rgb);
+    d->gray = vc_image_new(rgb->width, rgb->height, 1, 255);
+    d->binary = vc_image_new(rgb->width, rgb->height, 1, 255);
+    d->labels = vc_image_new(rgb->width, rgb->height, 1, 255);
+    d->dst1 = vc_image_new(rgb->width, rgb->height, 1, 255);
+    d->dst3 = vc_image_new(rgb->width, rgb->height, 3, 255);
+
+    if (d->rgb_work == NULL || d->gray == NULL || d->binary == NULL || d->labels == NULL ||
+        d->dst1 == NULL || d->dst3 == NULL) return 0;
+
+    vc_color_remove(d->rgb_work, 12, 250);
+    vc_rgb_to_gray(d->rgb_work, d->gray);
+    vc_brigten(d->gray, 100);
+    vc_gray_to_binary(d->gray, d->dst1, 254);
+    vc_binary_close(d->dst1, d->binary, 2);
+    restore(d->dst1, d->binary);
+    vc_binary_dilate(d->dst1, d->binary, 3);
+    restore(d->rgb_work, rgb);
+    vc_rgb_to_gray(rgb, d->gray);
+
+    d->blobs = vc_binary_blob_labelling(d->binary, d->labels, &d->nblobs);
+    vc_binary_blob_info(d->labels, d->blobs, d->nblobs);
+
+    d->gray_work = clone(d->gray);
+    d->binary_work = clone(d->binary);
+
+    // Matricula (imagens reais): primeiro candidato, senão o maior blob
+    if (d->plate.area == 0) {
+        for (int i = 0; i < d->nblobs; i++) {
+            if (isPlateCandidate(d->blobs[i], rgb->width, rgb->height, 0)) {
+                d->plate = d->blobs[i];
+                break;
+            }
+            if (d->blobs[i].area > d->plate.area) d->plate = d->blobs[i];
+        }
+    }
+    if (d->plate.area == 0) {
+        d->plate.x = d->plate.y = 1;
+        d->plate.width = d->plate.height = 8;
+        d->plate.area = 64;
+    }
+    d->plate_bin = vc_image_new(d->plate.width, d->plate.height, 1, 255);
+    if (d->plate_bin == NULL) return 0;
+
+    d->planar = vc_planar_new(rgb->width, rgb->height);
+    d->planar_work = vc_planar_new(rgb->width, rgb->height);
+    if (d->planar == NULL || d->planar_work == NULL) return 0;
+    vc_planar_from_interleaved(rgb, d->planar);
+
+    snprintf(d->dir, sizeof(d->dir), "%s", dir);
+    vc_recognizer_init(&d->ctx);
+    d->ctx.output_dir = d->dir;
+    snprintf(d->file, sizeof(d->file), "%s/bench_input.ppm", dir);
+    snprintf(d->out, sizeof(d->out), "%s/bench_output.ppm", dir);
+    return vc_write_image(d->file, rgb);
+}
+
+static void data_free(BENCH_DATA *d) {
+    vc_recognizer_free(&d->ctx);
+    vc_image_free(d->rgb);
+    vc_image_free(d->rgb_work);
+    vc_image_free(d->gray);
+    vc_image_free(d->gray_work);
+    vc_image_free(d->binary);
+    vc_image_free(d->binary_work);
+    vc_image_free(d->labels);
+    vc_image_free(d->dst1);
+    vc_image_free(d->dst3);
+    vc_image_free(d->plate_bin);
+    vc_planar_free(d->planar);
+    vc_planar_free(d->planar_work);
+    free(d->blobs);
+    remove(d->file);
+    remove(d->out);
+}
+
+// Parametro que a função de um caso não usa (prepare e run têm todas a mesma assinatura)
+#define BENCH_UNUSED __attribute__((unused))
+
+/**
+ * Um caso de benchmark: prepare() corre fora da medição (repõe as entradas
+ * das funções que alteram a imagem), run() é medido. inner é o numero de
+ * chamadas feitas por run(), o tempo reportado é por chamada
+ */
+typedef struct {
+    const char *name;
+    int params[4];      // Valores de param (0 terminado); {0} corre uma vez com 0
+    int kernels;        // Usa a lista de kernels da linha de comandos em vez de params
+    int inner;
+    void (*prepare)(BENCH_DATA *d, int param);
+    void (*run)(BENCH_DATA *d, int param);
+} BENCH_CASE;
+
+static void prep_rgb(BENCH_DATA *d, int param BENCH_UNUSED) { restore(d->rgb_work, d->rgb); }
+static void prep_gray(BENCH_DATA *d, int param BENCH_UNUSED) { restore(d->gray_work, d->gray); }
+static void prep_binary(BENCH_DATA *d, int param BENCH_UNUSED) { restore(d->binary_work, d->binary); }
+
+static void run_image_new(BENCH_DATA *d, int param BENCH_UNUSED) {
+    vc_image_free(vc_image_new(d->rgb->width, d->rgb->height, 3, 255));
+}
+static void run_read_image(BENCH_DATA *d, int param BENCH_UNUSED) { vc_image_free(vc_read_image(d->file)); }
+static void run_write_image(BENCH_DATA *d, int param BENCH_UNUSED) { vc_write_image(d->out, d->rgb); }
+static void run_rgb_to_gray(BENCH_DATA *d, int param BENCH_UNUSED) { vc_rgb_to_gray(d->rgb, d->dst1); }
+static void run_gray_to_binary(BENCH_DATA *d, int param) { vc_gray_to_binary(d->gray, d->dst1, param); }
+static void run_dilate(BENCH_DATA *d, int param) { vc_binary_dilate(d->binary, d->dst1, param); }
+static void run_erode(BENCH_DATA *d, int param) { vc_binary_erode(d->binary, d->dst1, param); }
+static void run_close(BENCH_DATA *d, int param) { vc_binary_close(d->binary, d->dst1, param); }
+static void run_labelling(BENCH_DATA *d, int param BENCH_UNUSED) {
+    int n = 0;
+    free(vc_binary_blob_labelling(d->binary, d->dst1, &n));
+}
+static void run_blob_info(BENCH_DATA *d, int param BENCH_UNUSED) { vc_binary_blob_info(d->labels, d->blobs, d->nblobs); }
+static void run_downscale(BENCH_DATA *d, int param) {
+    IVC *small = vc_image_new(d->gray->width / param, d->gray->height / param, 1, 255);
+    vc_downscale(d->gray, small, param);
+    vc_image_free(small);
+}
+// O caminho de pyramidCandidates e edgeCandidates, que reduzem o original RGB
+static void run_downscale_rgb(BENCH_DATA *d, int param) {
+    IVC *small = vc_image_new(d->rgb->width / param, d->rgb->height / param, 3, 255);
+    vc_downscale(d->rgb, small, param);
+    vc_image_free(small);
+}
+static void run_gray_median(BENCH_DATA *d, int param) { vc_gray_median(d->gray, d->dst1, param); }
+static void run_box_blur(BENCH_DATA *d, int param) { vc_box_blur(d->gray, d->dst1, param); }
+static void run_box_blur_rgb(BENCH_DATA *d, int param) { vc_box_blur(d->rgb, d->dst3, param); }
+static void run_gaussian_blur(BENCH_DATA *d, int param) { vc_gaussian_blur(d->gray, d->dst1, param); }
+static void run_sobel_x(BENCH_DATA *d, int param BENCH_UNUSED) { vc_gray_sobel_x(d->gray, d->dst1); }
+// A imagem toda rodada param graus à volta do centro (custo por pixel de dst)
+static void run_rgb_deskew(BENCH_DATA *d, int param) {
+    vc_rgb_deskew(d->rgb, d->dst3, d->rgb->width / 2.0f, d->rgb->height / 2.0f, param * 0.0174532925f);
+}
+static void run_brigten(BENCH_DATA *d, int param) { vc_brigten(d->gray_work, param); }
+static void run_brigten_rgb(BENCH_DATA *d, int param) { vc_brigten(d->rgb_work, param); }
+static void run_debug_save(BENCH_DATA *d, int param BENCH_UNUSED) {
+    debugSave(d->dir, "bench_debug", 0, d->rgb);
+}
+static void run_directory_exists(BENCH_DATA *d, int param BENCH_UNUSED) { directory_exists(d->dir); }
+static void run_file_exists(BENCH_DATA *d, int param BENCH_UNUSED) { file_exists(d->file); }
+static void run_rgb_to_gray_px(BENCH_DATA *d, int param BENCH_UNUSED) {
+    unsigned char *p = d->rgb->data;
+    for (long i = 0, n = (long)d->rgb->width * d->rgb->height; i < n; i++, p += 3) {
+        d->dst1->data[i] = rgb_to_gray(p[0], p[1], p[2]);
+    }
+}
+static void run_calcula_desvio(BENCH_DATA *d, int param BENCH_UNUSED) {
+    unsigned char *p = d->rgb->data;
+    for (long i = 0, n = (long)d->rgb->width * d->rgb->height; i < n; i++, p += 3) {
+        d->dst1->data[i] = calcula_desvio(p[0], p[1], p[2]);
+    }
+}
+static void run_invert(BENCH_DATA *d, int param BENCH_UNUSED) { invertImageBinary(d->binary_work); }
+static void run_fill(BENCH_DATA *d, int param BENCH_UNUSED) { fillImage(d->dst3, 255); }
+static void run_crop(BENCH_DATA *d, int param BENCH_UNUSED) {
+    vc_image_free(cropImage(d->rgb, d->plate.x, d->plate.y, d->plate.width, d->plate.height));
+}
+static void run_extract_blob(BENCH_DATA *d, int param BENCH_UNUSED) { extractBlob(d->rgb, d->dst3, d->plate); }
+static void run_extract_blob_binary(BENCH_DATA *d, int param BENCH_UNUSED) { extractBlobBinary(d->binary, d->plate_bin, d->plate); }
+static void run_plate_candidate(BENCH_DATA *d, int param BENCH_UNUSED) {
+    static volatile int sink;
+    sink += isPlateCandidate(d->plate, d->rgb->width, d->rgb->height, 0);
+}
+static void run_pyramid(BENCH_DATA *d, int param) {
+    int n = 0;
+    d->ctx.pyramid_levels = param;
+    free(pyramidCandidates(&d->ctx, d->rgb, &n));
+}
+static void run_edge_candidates(BENCH_DATA *d, int param BENCH_UNUSED) {
+    int n = 0;
+    free(edgeCandidates(&d->ctx, d->rgb, &n));
+}
+static void run_process_image(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    d->ctx.pyramid_levels = param;
+    processImage(&d->ctx, d->file, &result);
+}
+static void run_recognize(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Só o reconhecimento, sem leitura nem gravação de imagens
+    d->ctx.pyramid_levels = param;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+}
+static void run_recognize_tracking(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Frames iguais seguidos: depois da primeira só a janela da matricula é processada
+    d->ctx.track_misses = param;
+    d->ctx.pyramid_levels = 0;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+    d->ctx.track_misses = 0;
+}
+static void run_gate_signature(BENCH_DATA *d, int param BENCH_UNUSED) {
+    unsigned char sig[VC_GATE_GRID * VC_GATE_GRID];
+    vc_gate_signature(d->rgb, sig);
+}
+static void run_recognize_gated(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Frames iguais seguidas: depois da primeira só a assinatura é calculada
+    d->ctx.gate.threshold = param;
+    d->ctx.pyramid_levels = 0;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+    d->ctx.gate.threshold = 0;
+}
+static void run_recognize_max_verify(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Só os param candidatos com melhor pontuação são verificados
+    d->ctx.max_verifications = param;
+    d->ctx.pyramid_levels = 0;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+    d->ctx.max_verifications = 0;
+}
+static void run_recognize_edges(BENCH_DATA *d, int param BENCH_UNUSED) {
+    VC_RESULT result;
+    // Candidatos pela densidade de contornos em vez do preâmbulo de cor
+    d->ctx.edge_candidates = 1;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+    d->ctx.edge_candidates = 0;
+}
+static void run_recognize_parallel(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Candidatos verificados em param threads (o pool fica criado entre repetições)
+    d->ctx.verify_threads = param;
+    d->ctx.pyramid_levels = 0;
+    d->ctx.output_dir = NULL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.output_dir = d->dir;
+    d->ctx.verify_threads = 0;
+}
+static void run_recognize_deadline(BENCH_DATA *d, int param) {
+    VC_RESULT result;
+    // Prazo de param milisegundos: o tempo medido não deve passar muito do orçamento
+    d->ctx.pyramid_levels = 0;
+    d->ctx.output_dir = NULL;
+    d->ctx.deadline = bench_now() + param * 1000000LL;
+    recognize(&d->ctx, d->rgb, &result);
+    d->ctx.deadline = 0;
+    d->ctx.output_dir = d->dir;
+}
+static void run_plate_score(BENCH_DATA *d, int param BENCH_UNUSED) {
+    static volatile float sink;
+    sink += plateScore(d->plate, d->rgb->width, d->rgb->height);
+}
+static void run_color_remove(BENCH_DATA *d, int param BENCH_UNUSED) { vc_color_remove(d->rgb_work, 12, 250); }
+static void run_bounding_box(BENCH_DATA *d, int param BENCH_UNUSED) { desenha_bounding_box(d->rgb_work, d->blobs, d->nblobs); }
+static void run_histogram(BENCH_DATA *d, int param BENCH_UNUSED) {
+    VC_HISTOGRAM h;
+    vc_histogram(d->gray, &h);
+}
+static void run_histogram_parallel(BENCH_DATA *d, int param) {
+    VC_HISTOGRAM h;
+    vc_histogram_parallel(d->gray, &h, param);
+}
+static void run_rgb_to_gray_histogram(BENCH_DATA *d, int param BENCH_UNUSED) {
+    VC_HISTOGRAM h;
+    vc_rgb_to_gray_histogram(d->rgb, d->dst1, &h);
+}
+static void prep_planar(BENCH_DATA *d, int param BENCH_UNUSED) {
+    memcpy(d->planar_work->data, d->planar->data, (size_t)3 * d->planar->stride * d->planar->height);
+}
+static void run_planar_from(BENCH_DATA *d, int param BENCH_UNUSED) { vc_planar_from_interleaved(d->rgb, d->planar_work); }
+static void run_planar_to(BENCH_DATA *d, int param BENCH_UNUSED) { vc_planar_to_interleaved(d->planar, d->dst3); }
+static void run_planar_color_remove(BENCH_DATA *d, int param BENCH_UNUSED) { vc_planar_color_remove(d->planar_work, 12, 250); }
+static void run_planar_to_gray(BENCH_DATA *d, int param BENCH_UNUSED) { vc_planar_to_gray(d->planar, d->dst1); }
+static void run_planar_brigten(BENCH_DATA *d, int param) { vc_planar_brigten(d->planar_work, param); }
+// Estágio antes da binarização do pipeline principal nos dois layouts; o planar inclui a conversão da entrada
+static void run_prebinarise_interleaved(BENCH_DATA *d, int param BENCH_UNUSED) {
+    vc_color_remove(d->rgb_work, 12, 250);
+    vc_rgb_to_gray(d->rgb_work, d->gray_work);
+    vc_brigten(d->gray_work, 100);
+    vc_gray_to_binary(d->gray_work, d->dst1, 254);
+}
+static void run_prebinarise_planar(BENCH_DATA *d, int param BENCH_UNUSED) {
+    vc_planar_from_interleaved(d->rgb, d->planar_work);
+    vc_planar_color_remove(d->planar_work, 12, 250);
+    vc_planar_to_gray(d->planar_work, d->gray_work);
+    vc_brigten(d->gray_work, 100);
+    vc_gray_to_binary(d->gray_work, d->dst1, 254);
+}
+
+// vc_darken() está declarada em plate-recognizer.h mas não tem implementação
+static const BENCH_CASE bench_cases[] = {
+        { "vc_image_new+vc_image_free",  { 0 },          0, 1,    NULL,        run_image_new },
+        { "vc_read_image",               { 0 },          0, 1,    NULL,        run_read_image },
+        { "vc_write_image",              { 0 },          0, 1,    NULL,        run_write_image },
+        { "vc_rgb_to_gray",              { 0 },          0, 1,    NULL,        run_rgb_to_gray },
+        { "vc_gray_to_binary",           { 128 },        0, 1,    NULL,        run_gray_to_binary },
+        { "vc_gray_median",              { 1, 3, 7, 15 }, 0, 1,   NULL,        run_gray_median },
+        { "vc_box_blur",                 { 1, 5, 20 },   0, 1,    NULL,        run_box_blur },
+        { "vc_box_blur_rgb",             { 1, 5, 20 },   0, 1,    NULL,        run_box_blur_rgb },
+        { "vc_gaussian_blur",            { 1, 5 },       0, 1,    NULL,        run_gaussian_blur },
+        { "vc_gray_sobel_x",             { 0 },          0, 1,    NULL,        run_sobel_x },
+        { "vc_rgb_deskew",               { 1, 5, 20 },   0, 1,    NULL,        run_rgb_deskew },
+        { "vc_binary_dilate",            { 0 },          1, 1,    NULL,        run_dilate },
+        { "vc_binary_erode",             { 0 },          1, 1,    NULL,        run_erode },
+        { "vc_binary_close",             { 0 },          1, 1,    NULL,        run_close },
+        { "vc_binary_blob_labelling",    { 0 },          0, 1,    NULL,        run_labelling },
+        { "vc_binary_blob_info",         { 0 },          0, 1,    NULL,        run_blob_info },
+        { "vc_downscale",                { 2, 4 },       0, 1,    NULL,        run_downscale },
+        { "vc_downscale_rgb",            { 2, 4 },       0, 1,    NULL,        run_downscale_rgb },
+        { "vc_brigten",                  { 100 },        0, 1,    prep_gray,   run_brigten },
+        { "vc_brigten_rgb",              { 50 },         0, 1,    prep_rgb,    run_brigten_rgb },
+        { "debugSave",                   { 0 },          0, 1,    NULL,        run_debug_save },
+        { "directory_exists",            { 0 },          0, 100,    NULL,        run_directory_exists },
+        { "file_exists",                 { 0 },          0, 100,    NULL,        run_file_exists },
+        { "rgb_to_gray",                 { 0 },          0, 1,    NULL,        run_rgb_to_gray_px },
+        { "invertImageBinary",           { 0 },          0, 1,    prep_binary, run_invert },
+        { "fillImage",                   { 0 },          0, 1,    NULL,        run_fill },
+        { "cropImage",                   { 0 },          0, 1,    NULL,        run_crop },
+        { "extractBlob",                 { 0 },          0, 1,    NULL,        run_extract_blob },
+        { "extractBlobBinary",           { 0 },          0, 1,    NULL,        run_extract_blob_binary },
+        { "isPlateCandidate",            { 0 },          0, 1000,    NULL,        run_plate_candidate },
+        { "pyramidCandidates",           { 1, 2 },       0, 1,    NULL,        run_pyramid },
+        { "edgeCandidates",              { 0 },          0, 1,    NULL,        run_edge_candidates },
+        { "processImage",                { 0, 1, 2 },    0, 1,    NULL,        run_process_image },
+        { "recognize",                   { 0, 1, 2 },    0, 1,    NULL,        run_recognize },
+        { "recognize_max_verify",        { 1, 2 },       0, 1,    NULL,        run_recognize_max_verify },
+        { "recognize_edges",             { 0 },          0, 1,    NULL,        run_recognize_edges },
+        { "recognize_parallel",          { 2, 4 },       0, 1,    NULL,        run_recognize_parallel },
+        { "recognize_deadline",          { 5, 20 },      0, 1,    NULL,        run_recognize_deadline },
+        { "plateScore",                  { 0 },          0, 1000,    NULL,        run_plate_score },
+        { "recognize_tracking",          { 3 },          0, 1,    NULL,        run_recognize_tracking },
+        { "recognize_gated",             { 8 },          0, 1,    NULL,        run_recognize_gated },
+        { "vc_gate_signature",           { 0 },          0, 1,    NULL,        run_gate_signature },
+        { "calcula_desvio",              { 0 },          0, 1,    NULL,        run_calcula_desvio },
+        { "vc_color_remove",             { 0 },          0, 1,    prep_rgb,    run_color_remove },
+        { "desenha_bounding_box",        { 0 },          0, 1,    prep_rgb,    run_bounding_box },
+        { "vc_histogram",                { 0 },          0, 1,    NULL,        run_histogram },
+        { "vc_histogram_parallel",       { 2, 4 },       0, 1,    NULL,        run_histogram_parallel },
+        { "vc_rgb_to_gray_histogram",    { 0 },          0, 1,    NULL,        run_rgb_to_gray_histogram },
+        { "vc_planar_from_interleaved",  { 0 },          0, 1,    NULL,        run_planar_from },
+        { "vc_planar_to_interleaved",    { 0 },          0, 1,    NULL,        run_planar_to },
+        { "vc_planar_color_remove",      { 0 },          0, 1,    prep_planar, run_planar_color_remove },
+        { "vc_planar_to_gray",           { 0 },          0, 1,    NULL,        run_planar_to_gray },
+        { "vc_planar_brigten",           { 50 },         0, 1,    prep_planar, run_planar_brigten },
+        { "prebinarise_interleaved",     { 0 },          0, 1,    prep_rgb,    run_prebinarise_interleaved },
+        { "prebinarise_planar",          { 0 },          0, 1,    NULL,        run_prebinarise_planar },
+};
+
+#define BENCH_NCASES (int)(sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+/**
+ * Opções da linha de comandos
+ */
+typedef struct {
+    int warmup, reps;
+    int json;
+    int kernels[8], nkernels;
+    int sizes[BENCH_NSIZES], nsizes;
+    const char *filter;
+    const char *real;
+    const char *label;
+    int synthetic_only;
+    int cluttered;              // -C: cena sintética com candidatos falsos
+    int differential;           // -D: compara com o backend de referência em vez de medir
+    const char *golden;         // -G: corpus end-to-end (examples_output)
+    int concurrency[8];         // -L: teste de carga com estas concorrências
+    int nconcurrency;
+    int tolerance;
+    unsigned int seed;
+    int rounds;
+    int verbose;
+    int update;
+} BENCH_OPTIONS;
+
+static int rows = 0;
+
+static void emit(const BENCH_OPTIONS *o, const BENCH_CASE *c, const char *source, IVC *img, int param,
+                 long long median, long long mad, long long min) {
+    const char *name = c->name;
+    // Débito só faz sentido para as funções que percorrem a imagem inteira
+    double mpix = (median > 0 && c->inner == 1) ? ((double)img->width * img->height / 1e6) / (median / 1e9) : 0;
+
+    if (o->json) {
+        printf("%s\n  {\"label\": \"%s\", \"function\": \"%s\", \"image\": \"%s\", \"width\": %d, \"height\": %d, "
+               "\"param\": %d, \"reps\": %d, \"median_ns\": %lld, \"mad_ns\": %lld, \"min_ns\": %lld, \"mpix_s\": %.2f}",
+               rows ? "," : "", o->label, name, source, img->width, img->height, param, o->reps, median, mad, min, mpix);
+    } else {
+        printf("%s,%s,%s,%d,%d,%d,%d,%lld,%lld,%lld,%.2f\n",
+               o->label, name, source, img->width, img->height, param, o->reps, median, mad, min, mpix);
+    }
+    fflush(stdout);
+    rows++;
+}
+
+/**
+ * Corre um caso com um parâmetro: warm-up, reps medições, mediana e MAD
+ */
+static void bench_case(const BENCH_OPTIONS *o, const BENCH_CASE *c, BENCH_DATA *d, const char *source, int param) {
+    long long *samples = (long long *)malloc(o->reps * sizeof(long long));
+    long long median, mad;
+
+    for (int i = 0; i < o->warmup + o->reps; i++) {
+        if (c->prepare != NULL) c->prepare(d, param);
+
+        long long t0 = bench_now();
+        for (int k = 0; k < c->inner; k++) c->run(d, param);
+        long long t1 = bench_now();
+
+        if (i >= o->warmup) samples[i - o->warmup] = (t1 - t0) / c->inner;
+    }
+
+    bench_stats(samples, o->reps, &median, &mad);
+    emit(o, c, source, d->rgb, param, median, mad, samples[0]);
+    free(samples);
+}
+
+static void bench_image(const BENCH_OPTIONS *o, IVC *rgb, OVC *plate, const char *source, const char *dir) {
+    BENCH_DATA d;
+
+    if (!data_init(&d, rgb, plate, dir)) {
+        fprintf(stderr, "bench: cannot prepare %s %dx%d\n", source, rgb->width, rgb->height);
+        data_free(&d);
+        return;
+    }
+
+    for (int c = 0; c < BENCH_NCASES; c++) {
+        const BENCH_CASE *bc = &bench_cases[c];
+
+        if (o->filter != NULL && strstr(bc->name, o->filter) == NULL) continue;
+        fprintf(stderr, "bench: %s %s %dx%d\n", bc->name, source, rgb->width, rgb->height);
+
+        if (bc->kernels) {
+            for (int k = 0; k < o->nkernels; k++) bench_case(o, bc, &d, source, o->kernels[k]);
+        } else {
+            int p = 0;
+            do {
+                bench_case(o, bc, &d, source, bc->params[p]);
+            } while (++p < 4 && bc->params[p] != 0);
+        }
+    }
+    data_free(&d);
+}
+
+static int parse_list(const char *s, int *out, int max) {
+    int n = 0;
+    char buf[128], *tok, *save;
+
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL && n < max; tok = strtok_r(NULL, ",", &save)) {
+        out[n++] = atoi(tok);
+    }
+    return n;
+}
+
+static int parse_sizes(const char *s, int *out) {
+    int n = 0;
+    char buf[128], *tok, *save;
+
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        for (int i = 0; i < BENCH_NSIZES; i++) {
+            if (strcmp(tok, bench_sizes[i].name) == 0 && n < BENCH_NSIZES) out[n++] = i;
+        }
+    }
+    return n;
+}
+
+/**
+ * Remove o directorio temporário e os ficheiros de debug escritos por processImage()
+ */
+static void remove_dir(const char *dir) {
+    char cmd[PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "bench: cannot remove %s\n", dir);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage:\n"
+                    "\t%s [-f csv|json] [-w WARMUP] [-r REPS] [-k KERNELS] [-s SIZES] [-i IMAGE] [-S] [-C] [-x FILTER] [-l LABEL]\n"
+                    "\t-f FORMAT\toutput format (default csv)\n"
+                    "\t-w WARMUP\tunmeasured runs before measuring (default 1)\n"
+                    "\t-r REPS\t\tmeasured runs, reported as median and MAD (default 7)\n"
+                    "\t-k KERNELS\tmorphology kernel sizes (default 3,5,7)\n"
+                    "\t-s SIZES\tvga,1080p,4k (default all)\n"
+                    "\t-i IMAGE\treal image, resized to each size (default examples/Imagem01.ppm)\n"
+                    "\t-S\t\tsynthetic images only\n"
+                    "\t-C\t\talso a synthetic scene with plate-shaped decoys above the plate\n"
+                    "\t-x FILTER\tonly functions whose name contains FILTER\n"
+                    "\t-l LABEL\tvalue of the label column (e.g. the commit)\n"
+                    "\n\t%s -D [-R SEED] [-n ROUNDS] [-v] [IMAGE...]\n"
+                    "\t-D\t\tcompare every kernel with the reference backend on random images and on IMAGE...\n"
+                    "\t\t\t(default examples/*.ppm), printing the first differing pixel, and check the\n"
+                    "\t\t\tplates of the held-out examples\n"
+                    "\t%s -G CORPUS [-T TOLERANCE] [-U]\n"
+                    "\t-G CORPUS\tprocess CORPUS/*/original_1.ppm and compare every output file with the corpus\n"
+                    "\t\t\tand the plates of the held-out examples with the expected text\n"
+                    "\t-T TOLERANCE\tmaximum difference per byte accepted by -G (default 0)\n"
+                    "\t-U\t\tafter comparing, make the corpus match the generated files\n"
+                    "\t%s -L CONCURRENCY [-n PASSES] [-w WARMUP] [-s SIZES] [-f csv|json] [-l LABEL] [IMAGE...]\n"
+                    "\t-L CONCURRENCY\tload test: replay IMAGE... (default examples/*.ppm) and their copies resized to SIZES\n"
+                    "\t\t\tthrough processImage without dumps, with each number of threads in the list (e.g. 1,4),\n"
+                    "\t\t\treporting images/s, p50/p90/p99/max latency and peak RSS\n"
+                    "\t-n PASSES\ttimes the corpus is replayed per measurement (default 2), after WARMUP passes\n", prog, prog, prog, prog);
+}
+
+/**
+ * Main do benchmark
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char **argv) {
+    BENCH_OPTIONS o = { 0 };
+    char dir[] = "/tmp/vc-bench-XXXXXX";
+    int opt;
+
+    o.warmup = 1;
+    o.reps = 7;
+    o.nkernels = parse_list("3,5,7", o.kernels, 8);
+    o.nsizes = parse_sizes("vga,1080p,4k", o.sizes);
+    o.real = "examples/Imagem01.ppm";
+    o.label = "";
+    o.seed = 1;
+    o.rounds = 2;
+
+    while ((opt = getopt(argc, argv, "f:w:r:k:s:i:SCx:l:DG:T:UR:n:vL:")) != -1) {
+        switch (opt) {
+            case 'f': o.json = (strcmp(optarg, "json") == 0); break;
+            case 'w': o.warmup = atoi(optarg); break;
+            case 'r': o.reps = atoi(optarg); break;
+            case 'k': o.nkernels = parse_list(optarg, o.kernels, 8); break;
+            case 's': o.nsizes = parse_sizes(optarg, o.sizes); break;
+            case 'i': o.real = optarg; break;
+            case 'S': o.synthetic_only = 1; break;
+            case 'C': o.cluttered = 1; break;
+            case 'x': o.filter = optarg; break;
+            case 'l': o.label = optarg; break;
+            case 'D': o.differential = 1; break;
+            case 'G': o.golden = optarg; break;
+            case 'T': o.tolerance = atoi(optarg); break;
+            case 'U': o.update = 1; break;
+            case 'R': o.seed = strtoul(optarg, NULL, 10); break;
+            case 'n': o.rounds = atoi(optarg); break;
+            case 'v': o.verbose = 1; break;
+            case 'L': o.nconcurrency = parse_list(optarg, o.concurrency, 8); break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (o.reps < 1 || o.warmup < 0 || o.nsizes == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "bench: cannot create %s\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    char *examples[] = { "examples/Imagem01.ppm", "examples/Imagem02.ppm", "examples/Imagem03.ppm",
+                         "examples/Imagem04.ppm", "examples/dsc00031dt3.ppm", NULL };
+
+    if (o.nconcurrency > 0) {
+        BENCH_LOAD load = { 0 };
+        int ret;
+
+        load.images = optind < argc ? argv + optind : examples;
+        for (int s = 0; s < o.nsizes; s++) {
+            load.widths[s] = bench_sizes[o.sizes[s]].width;
+            load.heights[s] = bench_sizes[o.sizes[s]].height;
+        }
+        load.nsizes = o.nsizes;
+        for (int c = 0; c < o.nconcurrency; c++) {
+            load.concurrency[c] = o.concurrency[c] > 0 ? o.concurrency[c] : 1;
+        }
+        load.nconcurrency = o.nconcurrency;
+        load.passes = o.rounds > 0 ? o.rounds : 1;
+        load.warmup = o.warmup;
+        load.json = o.json;
+        load.label = o.label;
+
+        ret = bench_load(&load, dir);
+        remove_dir(dir);
+        return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (o.differential || o.golden != NULL) {
+        int failures = 0;
+
+        if (o.differential) failures += bench_differential(o.seed, o.rounds, optind < argc ? argv + optind : examples, o.verbose);
+        if (o.golden != NULL) failures += bench_golden(o.golden, dir, o.tolerance, o.update);
+
+        remove_dir(dir);
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    fprintf(stderr, "bench: cpu %s (detected %s, VC_CPU to force a lower level), %s kernels (VC_GENERIC=1 for generic)\n",
+            vc_cpu_name(vc_cpu_level()), vc_cpu_name(vc_cpu_detected()), vc_cpu_specialised() ? "specialised" : "generic");
+
+    IVC *real = o.synthetic_only ? NULL : vc_read_image((char *)o.real);
+    if (!o.synthetic_only && real == NULL) fprintf(stderr, "bench: %s not found, synthetic images only\n", o.real);
+
+    if (o.json) printf("[");
+    else printf("label,function,image,width,height,param,reps,median_ns,mad_ns,min_ns,mpix_s\n");
+
+    for (int s = 0; s < o.nsizes; s++) {
+        int width = bench_sizes[o.sizes[s]].width;
+        int height = bench_sizes[o.sizes[s]].height;
+        OVC plate;
+
+        IVC *synthetic = bench_synthetic(width, height, &plate);
+        if (synthetic != NULL) bench_image(&o, synthetic, &plate, "synthetic", dir);
+
+        if (o.cluttered) {
+            IVC *cluttered = bench_cluttered(width, height, &plate);
+            if (cluttered != NULL) bench_image(&o, cluttered, &plate, "cluttered", dir);
+        }
+
+        if (real != NULL) {
+            IVC *resized = bench_resize(real, width, height);
+            if (resized != NULL) bench_image(&o, resized, NULL, "real", dir);
+        }
+    }
+
+    if (o.json) printf("\n]\n");
+
+    vc_image_free(real);
+
+    remove_dir(dir);
+    return EXIT_SUCCESS;
+}
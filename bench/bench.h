@@ -0,0 +1,40 @@
+/**
+ * Este ficheiro contem as assinaturas das funções auxiliares do benchmark
+ * @brief Relógio monotónico, estatisticas (mediana / MAD), imagens de teste, teste diferencial e teste de carga
+ * @file bench.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_BENCH_H
+#define VC_TP1_13871_14383_17442_BENCH_H
+
+#include "vc.h"
+
+/**
+ * Opções do teste de carga (-L)
+ */
+typedef struct {
+    char **images;                  // Corpus, terminado em NULL
+    int widths[8], heights[8];      // Tamanhos das cópias redimensionadas de cada imagem
+    int nsizes;
+    int concurrency[8];             // Threads de cada medição
+    int nconcurrency;
+    int passes;                     // Vezes que o corpus é processado em cada medição
+    int warmup;                     // Passagens antes de medir
+    int json;
+    const char *label;
+} BENCH_LOAD;
+
+long long bench_now(void);
+void bench_stats(long long *samples, int n, long long *median, long long *mad);
+IVC *bench_synthetic(int width, int height, OVC *plate);
+IVC *bench_cluttered(int width, int height, OVC *plate);
+IVC *bench_resize(IVC *src, int width, int height);
+int bench_differential(unsigned int seed, int rounds, char **images, int verbose);
+int bench_golden(const char *corpus, const char *tmpdir, int tolerance, int update);
+int bench_load(const BENCH_LOAD *o, const char *tmpdir);
+
+#endif //VC_TP1_13871_14383_17442_BENCH_H
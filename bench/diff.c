@@ -0,0 +1,809 @@
+/**
+ * Este ficheiro contem o teste diferencial entre os kernels de vc.c / plate-recognizer.c e o backend de referência
+ * @brief Compara as duas implementações em imagens aleatórias e reais e o resultado de processImage com examples_output
+ * @file diff.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> // PATH_MAX
+#include <dirent.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "reference.h"
+#include "plate-recognizer.h"
+#include "histogram.h"
+#include "cpu.h"
+#include "planar.h"
+
+/**
+ * Tamanhos das imagens aleatórias: larguras impares, 1 pixel, linhas
+ * mais curtas que um registo SIMD e tamanhos que não são multiplos de 16
+ */
+static const int diff_sizes[][2] = {
+        { 1, 1 }, { 2, 2 }, { 3, 5 }, { 7, 3 }, { 16, 16 }, { 17, 9 }, { 31, 33 },
+        { 64, 48 }, { 127, 65 }, { 333, 7 }, { 640, 480 }, { 641, 479 },
+};
+
+#define DIFF_NSIZES (int)(sizeof(diff_sizes) / sizeof(diff_sizes[0]))
+#define DIFF_MAX_KERNEL 9
+
+typedef struct {
+    unsigned int seed;
+    int checks, failures;
+    int verbose;
+} DIFF_STATE;
+
+/**
+ * Matriculas das imagens de exemplo e do directorio de cada uma em examples_output
+ * (texto vazio: não há matricula com 6 caracteres). Só as imagens que não deram
+ * templates a ocr.c: Imagem01 e Imagem03 seriam lidas pelos próprios caracteres
+ */
+static const struct {
+    const char *image;
+    const char *golden;
+    const char *text;
+} diff_plates[] = {
+        { "Imagem02", "02", "8281DH" },
+        { "Imagem04", "04", "11GF03" },
+        { "dsc00031dt3", "05", "" },
+};
+
+#define DIFF_NPLATES (int)(sizeof(diff_plates) / sizeof(diff_plates[0]))
+
+static int exists(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static unsigned int diff_rand(DIFF_STATE *s) {
+    s->seed = s->seed * 1103515245 + 12345;
+    return (s->seed >> 16) & 0x7FFF;
+}
+
+/**
+ * Imagem com 4 bytes a zero depois dos dados: vc_color_remove() lê um byte
+ * depois do ultimo pixel, assim as duas implementações lêem o mesmo valor
+ */
+static IVC *diff_image_new(int width, int height, int channels) {
+    IVC *img = (IVC *)malloc(sizeof(IVC));
+
+    if (img == NULL) return NULL;
+    img->width = width;
+    img->height = height;
+    img->channels = channels;
+    img->levels = 255;
+    img->bytesperline = width * channels;
+    img->allocated = 0;
+    img->site = -1;
+    img->data = (unsigned char *)calloc((size_t)width * height * channels + 4, 1);
+    if (img->data == NULL) return vc_image_free(img);
+    return img;
+}
+
+static IVC *diff_clone(IVC *src) {
+    IVC *dst = diff_image_new(src->width, src->height, src->channels);
+    if (dst != NULL) memcpy(dst->data, src->data, (size_t)src->bytesperline * src->height);
+    return dst;
+}
+
+/**
+ * RGB aleatório: metade dos pixeis quase cinzentos, para vc_color_remove() passar pelos dois ramos
+ */
+static IVC *random_rgb(DIFF_STATE *s, int width, int height) {
+    IVC *img = diff_image_new(width, height, 3);
+
+    for (long i = 0, n = (long)width * height; img != NULL && i < n; i++) {
+        unsigned char *p = img->data + i * 3;
+        if (diff_rand(s) & 1) {
+            int v = diff_rand(s) & 0xFF;
+            p[0] = v;
+            p[1] = MIN(255, v + (int)(diff_rand(s) % 8));
+            p[2] = MAX(0, v - (int)(diff_rand(s) % 8));
+        } else {
+            p[0] = diff_rand(s) & 0xFF;
+            p[1] = diff_rand(s) & 0xFF;
+            p[2] = diff_rand(s) & 0xFF;
+        }
+    }
+    return img;
+}
+
+static IVC *random_gray(DIFF_STATE *s, int width, int height) {
+    IVC *img = diff_image_new(width, height, 1);
+
+    for (long i = 0, n = (long)width * height; img != NULL && i < n; i++) img->data[i] = diff_rand(s) & 0xFF;
+    return img;
+}
+
+/**
+ * Binária aleatória com a densidade pedida (em %). 1 em 32 pixeis fica com
+ * um valor que não é 0 nem 255, como acontece nas imagens de labels
+ */
+static IVC *random_binary(DIFF_STATE *s, int width, int height, int density) {
+    IVC *img = diff_image_new(width, height, 1);
+
+    for (long i = 0, n = (long)width * height; img != NULL && i < n; i++) {
+        img->data[i] = ((int)(diff_rand(s) % 100) < density) ? 255 : 0;
+        if (img->data[i] && (diff_rand(s) % 32) == 0) img->data[i] = 1 + diff_rand(s) % 254;
+    }
+    return img;
+}
+
+/**
+ * Binária com poucos objectos (retângulos) para a etiquetagem não esgotar as etiquetas
+ */
+static IVC *random_blobs(DIFF_STATE *s, int width, int height) {
+    IVC *img = diff_image_new(width, height, 1);
+    int n = 1 + (int)(diff_rand(s) % 40);
+
+    for (int r = 0; img != NULL && r < n; r++) {
+        int w = 1 + diff_rand(s) % MAX(1, width / 4), h = 1 + diff_rand(s) % MAX(1, height / 4);
+        int x0 = diff_rand(s) % width, y0 = diff_rand(s) % height;
+
+        for (int y = y0; y < MIN(height, y0 + h); y++) {
+            for (int x = x0; x < MIN(width, x0 + w); x++) img->data[y * width + x] = 255;
+        }
+    }
+    return img;
+}
+
+/**
+ * Compara duas imagens e reporta o primeiro pixel diferente
+ * @return 1 se forem iguais
+ */
+static int diff_check(DIFF_STATE *s, const char *name, const char *what, int param, IVC *ref, IVC *got) {
+    long n = (long)ref->bytesperline * ref->height, first = -1, count = 0;
+
+    s->checks++;
+    if (got->width != ref->width || got->height != ref->height || got->channels != ref->channels) {
+        printf("FAIL %s %s %dx%dx%d param=%d: output is %dx%dx%d\n", name, what, ref->width, ref->height,
+               ref->channels, param, got->width, got->height, got->channels);
+        s->failures++;
+        return 0;
+    }
+    for (long i = 0; i < n; i++) {
+        if (ref->data[i] != got->data[i]) {
+            if (first < 0) first = i;
+            count++;
+        }
+    }
+    if (first < 0) {
+        if (s->verbose) printf("ok   %s %s %dx%dx%d param=%d\n", name, what, ref->width, ref->height, ref->channels, param);
+        return 1;
+    }
+
+    long px = first / ref->channels;
+    printf("FAIL %s %s %dx%dx%d param=%d: first difference at x=%ld y=%ld c=%ld ref=%d got=%d (%ld bytes differ)\n",
+           name, what, ref->width, ref->height, ref->channels, param,
+           px % ref->width, px / ref->width, first % ref->channels, ref->data[first], got->data[first], count);
+    s->failures++;
+    return 0;
+}
+
+static int diff_check_int(DIFF_STATE *s, const char *name, const char *what, IVC *img, int param, long ref, long got) {
+    s->checks++;
+    if (ref == got) return 1;
+    printf("FAIL %s %s %dx%dx%d param=%d: ref=%ld got=%ld\n", name, what, img->width, img->height, img->channels, param, ref, got);
+    s->failures++;
+    return 0;
+}
+
+static void diff_check_blobs(DIFF_STATE *s, const char *what, IVC *img, OVC *ref, OVC *got, int n) {
+    for (int i = 0; i < n; i++) {
+        if (memcmp(&ref[i], &got[i], sizeof(OVC)) == 0) continue;
+        printf("FAIL vc_binary_blob_info %s %dx%d: blob %d ref=(%d,%d %dx%d area %d perimeter %d label %d) "
+               "got=(%d,%d %dx%d area %d perimeter %d label %d)\n", what, img->width, img->height, i,
+               ref[i].x, ref[i].y, ref[i].width, ref[i].height, ref[i].area, ref[i].perimeter, ref[i].label,
+               got[i].x, got[i].y, got[i].width, got[i].height, got[i].area, got[i].perimeter, got[i].label);
+        s->failures++;
+        return;
+    }
+    s->checks++;
+}
+
+static void diff_check_histogram(DIFF_STATE *s, const char *name, const char *what, IVC *img, int param,
+                                 const VC_HISTOGRAM *ref, const VC_HISTOGRAM *got) {
+    for (int i = 0; i < 256; i++) {
+        if (ref->bins[i] == got->bins[i]) continue;
+        printf("FAIL %s %s %dx%d param=%d: first difference at bin %d ref=%u got=%u\n",
+               name, what, img->width, img->height, param, i, ref->bins[i], got->bins[i]);
+        s->failures++;
+        return;
+    }
+    diff_check_int(s, name, what, img, param, ref->total, got->total);
+}
+
+/**
+ * Layout planar: ida e volta, remoção de cor, cinzentos e clareamento comparados com a referência intercalada
+ */
+static void diff_planar(DIFF_STATE *s, const char *what, IVC *rgb) {
+    VC_PLANAR *planar = vc_planar_new(rgb->width, rgb->height);
+    IVC *ref = diff_image_new(rgb->width, rgb->height, 3);
+    IVC *got = diff_image_new(rgb->width, rgb->height, 3);
+    IVC *gray_ref = diff_image_new(rgb->width, rgb->height, 1);
+    IVC *gray_got = diff_image_new(rgb->width, rgb->height, 1);
+    int thresholds[] = { 0, 12, 40 };
+
+    vc_planar_from_interleaved(rgb, planar);
+    vc_planar_to_interleaved(planar, got);
+    diff_check(s, "vc_planar_to_interleaved", what, 0, rgb, got);
+
+    vc_ref_rgb_to_gray(rgb, gray_ref);
+    vc_planar_to_gray(planar, gray_got);
+    diff_check(s, "vc_planar_to_gray", what, 0, gray_ref, gray_got);
+
+    for (int t = 0; t < 3; t++) {
+        memcpy(ref->data, rgb->data, (size_t)rgb->bytesperline * rgb->height);
+        vc_ref_color_remove(ref, thresholds[t], 250);
+        vc_planar_from_interleaved(rgb, planar);
+        vc_planar_color_remove(planar, thresholds[t], 250);
+        vc_planar_to_interleaved(planar, got);
+        diff_check(s, "vc_planar_color_remove", what, thresholds[t], ref, got);
+    }
+
+    // Clareamento sobre o resultado com threshold 40
+    vc_ref_brigten(ref, 50);
+    vc_planar_brigten(planar, 50);
+    vc_planar_to_interleaved(planar, got);
+    diff_check(s, "vc_planar_brigten", what, 50, ref, got);
+
+    vc_planar_free(planar);
+    vc_image_free(ref);
+    vc_image_free(got);
+    vc_image_free(gray_ref);
+    vc_image_free(gray_got);
+}
+
+/**
+ * Médias e gaussiana de 1 ou 3 canais, também in-place
+ */
+static void diff_blur(DIFF_STATE *s, const char *what, IVC *img) {
+    IVC *ref = diff_image_new(img->width, img->height, img->channels);
+    IVC *got = diff_image_new(img->width, img->height, img->channels);
+    int radii[] = { 0, 1, 2, 7 };
+
+    for (int r = 0; r < 4; r++) {
+        vc_ref_box_blur(img, ref, radii[r]);
+        vc_box_blur(img, got, radii[r]);
+        diff_check(s, "vc_box_blur", what, radii[r], ref, got);
+        memcpy(got->data, img->data, img->bytesperline * img->height);
+        vc_box_blur(got, got, radii[r]);
+        diff_check(s, "vc_box_blur_inplace", what, radii[r], ref, got);
+    }
+    for (int r = 0; r < 4; r++) {
+        vc_ref_box_blur_x(img, ref, radii[r]);
+        memcpy(got->data, img->data, img->bytesperline * img->height);
+        vc_box_blur_x(got, got, radii[r]);
+        diff_check(s, "vc_box_blur_x", what, radii[r], ref, got);
+    }
+    for (int r = 1; r <= 3; r += 2) {
+        vc_ref_gaussian_blur(img, ref, r);
+        vc_gaussian_blur(img, got, r);
+        diff_check(s, "vc_gaussian_blur", what, r, ref, got);
+    }
+    vc_image_free(ref);
+    vc_image_free(got);
+}
+
+/**
+ * Reamostragem rodada com vários angulos e centros (dentro, no canto e fora da imagem, para as margens).
+ * Com angulo 0 e centro inteiro tem de ser uma cópia exacta da região
+ */
+static void diff_deskew(DIFF_STATE *s, const char *what, IVC *rgb) {
+    float angles[] = { 0.0f, 0.07f, -0.3f, 1.2f };
+    float centres[3][2] = { { rgb->width / 2.0f, rgb->height / 2.0f }, { 0.0f, 0.0f }, { rgb->width + 5.5f, -3.25f } };
+    int sizes[2][2] = { { 37, 11 }, { rgb->width, MIN(rgb->height, 64) } };
+
+    if (rgb->width < 4 || rgb->height < 4) return;
+
+    for (int d = 0; d < 2; d++) {
+        IVC *ref = diff_image_new(sizes[d][0], sizes[d][1], 3);
+        IVC *got = diff_image_new(sizes[d][0], sizes[d][1], 3);
+
+        for (int a = 0; a < 4; a++) {
+            for (int c = 0; c < 3; c++) {
+                vc_ref_rgb_deskew(rgb, ref, centres[c][0], centres[c][1], angles[a]);
+                vc_rgb_deskew(rgb, got, centres[c][0], centres[c][1], angles[a]);
+                diff_check(s, "vc_rgb_deskew", what, 10 * a + c, ref, got);
+            }
+        }
+        vc_image_free(ref);
+        vc_image_free(got);
+    }
+
+    int w = MIN(37, rgb->width - 2), h = MIN(11, rgb->height - 2);
+    IVC *ref = cropImage(rgb, 1, 1, w, h);
+    IVC *got = diff_image_new(w, h, 3);
+    vc_rgb_deskew(rgb, got, 1 + (w - 1) / 2.0f, 1 + (h - 1) / 2.0f, 0.0f);
+    diff_check(s, "vc_rgb_deskew_copy", what, 0, ref, got);
+    vc_image_free(ref);
+    vc_image_free(got);
+}
+
+/**
+ * Kernels sobre imagens RGB: cinzentos, remoção de cor, clareamento, médias, reamostragem rodada, redução e histograma
+ */
+static void diff_rgb(DIFF_STATE *s, const char *what, IVC *rgb) {
+    IVC *ref = diff_image_new(rgb->width, rgb->height, 1);
+    IVC *got = diff_image_new(rgb->width, rgb->height, 1);
+    VC_HISTOGRAM href, hgot;
+
+    vc_ref_rgb_to_gray(rgb, ref);
+    vc_rgb_to_gray(rgb, got);
+    diff_check(s, "vc_rgb_to_gray", what, 0, ref, got);
+
+    memset(got->data, 0, got->bytesperline * got->height);
+    vc_rgb_to_gray_histogram(rgb, got, &hgot);
+    diff_check(s, "vc_rgb_to_gray_histogram", what, 0, ref, got);
+    vc_ref_histogram(ref, &href);
+    diff_check_histogram(s, "vc_rgb_to_gray_histogram", what, rgb, 0, &href, &hgot);
+
+    vc_image_free(ref);
+    vc_image_free(got);
+
+    int thresholds[] = { 0, 1, 12, 40, 255, 300 }, value = 50;
+    for (int t = 0; t < 6; t++) {
+        ref = diff_clone(rgb);
+        got = diff_clone(rgb);
+        vc_ref_color_remove(ref, thresholds[t], 250);
+        vc_color_remove(got, thresholds[t], 250);
+        diff_check(s, "vc_color_remove", what, thresholds[t], ref, got);
+        vc_image_free(ref);
+        vc_image_free(got);
+    }
+
+    // Clareamento sobre o resultado com threshold 12, como no pipeline principal
+    ref = diff_clone(rgb);
+    got = diff_clone(rgb);
+    vc_ref_color_remove(ref, 12, 250);
+    vc_ref_color_remove(got, 12, 250);
+    vc_ref_brigten(ref, value);
+    vc_brigten(got, value);
+    diff_check(s, "vc_brigten", what, value, ref, got);
+    vc_image_free(ref);
+    vc_image_free(got);
+
+    diff_planar(s, what, rgb);
+    diff_blur(s, what, rgb);
+    diff_deskew(s, what, rgb);
+
+    for (int factor = 2; factor <= 4; factor += 2) {
+        if (rgb->width / factor == 0 || rgb->height / factor == 0) continue;
+        ref = diff_image_new(rgb->width / factor, rgb->height / factor, 3);
+        got = diff_image_new(rgb->width / factor, rgb->height / factor, 3);
+        vc_ref_downscale(rgb, ref, factor);
+        vc_downscale(rgb, got, factor);
+        diff_check(s, "vc_downscale", what, factor, ref, got);
+        vc_image_free(ref);
+        vc_image_free(got);
+    }
+}
+
+/**
+ * Kernels sobre imagens de 1 canal: binarização, clareamento, médias, mediana, Sobel, redução e histogramas
+ */
+static void diff_gray(DIFF_STATE *s, const char *what, IVC *gray) {
+    IVC *ref = diff_image_new(gray->width, gray->height, 1);
+    IVC *got = diff_image_new(gray->width, gray->height, 1);
+    VC_HISTOGRAM href, hgot;
+    int thresholds[] = { 0, 127, 180, 254, 255 };
+    int radii[] = { 1, 2, 3, 7 };
+
+    for (int t = 0; t < 5; t++) {
+        vc_ref_gray_to_binary(gray, ref, thresholds[t]);
+        vc_gray_to_binary(gray, got, thresholds[t]);
+        diff_check(s, "vc_gray_to_binary", what, thresholds[t], ref, got);
+    }
+
+    memcpy(ref->data, gray->data, gray->bytesperline * gray->height);
+    memcpy(got->data, gray->data, gray->bytesperline * gray->height);
+    vc_ref_brigten(ref, 100);
+    vc_brigten(got, 100);
+    diff_check(s, "vc_brigten", what, 100, ref, got);
+
+    diff_blur(s, what, gray);
+
+    vc_ref_gray_sobel_x(gray, ref);
+    vc_gray_sobel_x(gray, got);
+    diff_check(s, "vc_gray_sobel_x", what, 0, ref, got);
+
+    // Mediana: a versão in-place tem de dar o mesmo que a que escreve noutro buffer
+    for (int r = 0; r < 4; r++) {
+        vc_ref_gray_median(gray, ref, radii[r]);
+        vc_gray_median(gray, got, radii[r]);
+        diff_check(s, "vc_gray_median", what, radii[r], ref, got);
+        memcpy(got->data, gray->data, gray->bytesperline * gray->height);
+        vc_gray_median(got, got, radii[r]);
+        diff_check(s, "vc_gray_median_inplace", what, radii[r], ref, got);
+    }
+    vc_image_free(ref);
+    vc_image_free(got);
+
+    vc_ref_histogram(gray, &href);
+    vc_histogram(gray, &hgot);
+    diff_check_histogram(s, "vc_histogram", what, gray, 0, &href, &hgot);
+    for (int t = 2; t <= 4; t++) {
+        vc_histogram_parallel(gray, &hgot, t);
+        diff_check_histogram(s, "vc_histogram_parallel", what, gray, t, &href, &hgot);
+    }
+
+    for (int factor = 2; factor <= 4; factor += 2) {
+        if (gray->width / factor == 0 || gray->height / factor == 0) continue;
+        ref = diff_image_new(gray->width / factor, gray->height / factor, 1);
+        got = diff_image_new(gray->width / factor, gray->height / factor, 1);
+        vc_ref_downscale(gray, ref, factor);
+        vc_downscale(gray, got, factor);
+        diff_check(s, "vc_downscale", what, factor, ref, got);
+        vc_image_free(ref);
+        vc_image_free(got);
+    }
+}
+
+/**
+ * Morfologia em todos os kernels de 1 a DIFF_MAX_KERNEL e inversão
+ */
+static void diff_binary(DIFF_STATE *s, const char *what, IVC *bin) {
+    IVC *ref = diff_image_new(bin->width, bin->height, 1);
+    IVC *got = diff_image_new(bin->width, bin->height, 1);
+
+    for (int k = 1; k <= DIFF_MAX_KERNEL; k++) {
+        vc_ref_binary_dilate(bin, ref, k);
+        vc_binary_dilate(bin, got, k);
+        diff_check(s, "vc_binary_dilate", what, k, ref, got);
+
+        vc_ref_binary_erode(bin, ref, k);
+        vc_binary_erode(bin, got, k);
+        diff_check(s, "vc_binary_erode", what, k, ref, got);
+
+        vc_ref_binary_close(bin, ref, k);
+        vc_binary_close(bin, got, k);
+        diff_check(s, "vc_binary_close", what, k, ref, got);
+    }
+
+    memcpy(ref->data, bin->data, bin->bytesperline * bin->height);
+    memcpy(got->data, bin->data, bin->bytesperline * bin->height);
+    vc_ref_invert(ref);
+    invertImageBinary(got);
+    diff_check(s, "invertImageBinary", what, 0, ref, got);
+
+    vc_image_free(ref);
+    vc_image_free(got);
+}
+
+/**
+ * Etiquetagem (imagem de labels e numero de blobs) e informação dos blobs
+ */
+static void diff_labelling(DIFF_STATE *s, const char *what, IVC *bin) {
+    IVC *ref = diff_image_new(bin->width, bin->height, 1);
+    IVC *got = diff_image_new(bin->width, bin->height, 1);
+    int nref = 0, ngot = 0;
+
+    OVC *bref = vc_ref_binary_blob_labelling(bin, ref, &nref);
+    OVC *bgot = vc_binary_blob_labelling(bin, got, &ngot);
+
+    if (diff_check_int(s, "vc_binary_blob_labelling", what, bin, 0, nref, ngot) &&
+        diff_check(s, "vc_binary_blob_labelling", what, 0, ref, got) && nref > 0) {
+        vc_ref_binary_blob_info(ref, bref, nref);
+        vc_binary_blob_info(got, bgot, ngot);
+        diff_check_blobs(s, what, bin, bref, bgot, nref);
+    }
+
+    free(bref);
+    free(bgot);
+    vc_image_free(ref);
+    vc_image_free(got);
+}
+
+/**
+ * Compara o texto reconhecido com a matricula esperada de uma imagem de exemplo
+ * @param s
+ * @param what caminho da imagem (ex: examples/Imagem01.ppm) ou directorio do corpus (ex: 01)
+ * @param result
+ * @return 0 se a imagem não é um exemplo conhecido
+ */
+static int diff_check_plate(DIFF_STATE *s, const char *what, const VC_RESULT *result) {
+    const char *base = strrchr(what, '/');
+    size_t len;
+
+    base = (base != NULL) ? base + 1 : what;
+    len = strcspn(base, ".");
+
+    for (int i = 0; i < DIFF_NPLATES; i++) {
+        const char *text = diff_plates[i].text;
+
+        if ((strlen(diff_plates[i].image) != len || strncmp(diff_plates[i].image, base, len) != 0) &&
+            strcmp(diff_plates[i].golden, base) != 0) continue;
+
+        s->checks++;
+        if ((text[0] != 0) == (result->found != 0) && (!result->found || strcmp(result->text, text) == 0)) {
+            if (s->verbose) printf("ok   plate %s: %s\n", what, result->found ? result->text : "not found");
+        } else {
+            printf("FAIL plate %s: expected %s got %s\n", what, text[0] ? text : "not found",
+                   result->found ? result->text : "not found");
+            s->failures++;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Verificação dos candidatos em paralelo: o resultado tem de ser o da verificação sequencial.
+ * Nas imagens de exemplo a matricula lida tem de ser a esperada
+ */
+static void diff_recognize(DIFF_STATE *s, const char *what, IVC *rgb) {
+    VC_RECOGNIZER ctx;
+    VC_RESULT ref, got;
+    int threads[] = { 2, 4, 8 };
+
+    vc_recognizer_init(&ctx);
+    recognize(&ctx, rgb, &ref);
+    diff_check_plate(s, what, &ref);
+    for (int t = 0; t < 3; t++) {
+        ctx.verify_threads = threads[t];
+        recognize(&ctx, rgb, &got);
+        s->checks++;
+        if (memcmp(&ref, &got, sizeof(VC_RESULT)) == 0) {
+            if (s->verbose) printf("ok   recognize %s %dx%d threads=%d\n", what, rgb->width, rgb->height, threads[t]);
+            continue;
+        }
+        printf("FAIL recognize %s %dx%d threads=%d: ref found=%d %.6s at %d,%d got found=%d %.6s at %d,%d\n",
+               what, rgb->width, rgb->height, threads[t], ref.found, ref.text, ref.plate.x, ref.plate.y,
+               got.found, got.text, got.plate.x, got.plate.y);
+        s->failures++;
+    }
+    vc_recognizer_free(&ctx);
+}
+
+/**
+ * Corre todos os kernels nas duas implementações com o nivel SIMD em uso
+ */
+static void diff_level(DIFF_STATE *s, int rounds, char **images) {
+    char what[PATH_MAX + 32];
+
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < DIFF_NSIZES; i++) {
+            int width = diff_sizes[i][0], height = diff_sizes[i][1];
+            snprintf(what, sizeof(what), "random(seed=%u)", s->seed);
+
+            IVC *rgb = random_rgb(s, width, height);
+            IVC *gray = random_gray(s, width, height);
+            IVC *sparse = random_binary(s, width, height, 10);
+            IVC *dense = random_binary(s, width, height, 60);
+            IVC *blobs = random_blobs(s, width, height);
+
+            diff_rgb(s, what, rgb);
+            diff_gray(s, what, gray);
+            diff_binary(s, what, sparse);
+            diff_binary(s, what, dense);
+            diff_labelling(s, what, blobs);
+
+            vc_image_free(rgb);
+            vc_image_free(gray);
+            vc_image_free(sparse);
+            vc_image_free(dense);
+            vc_image_free(blobs);
+        }
+    }
+
+    // Cena com varios candidatos com forma de matricula
+    OVC plate;
+    IVC *cluttered = bench_cluttered(1280, 720, &plate);
+    if (cluttered != NULL) diff_recognize(s, "cluttered", cluttered);
+    vc_image_free(cluttered);
+
+    // Imagens reais: o RGB original e as imagens intermédias do pipeline principal
+    for (int i = 0; images != NULL && images[i] != NULL; i++) {
+        IVC *img = vc_read_image(images[i]);
+        if (img == NULL || img->channels != 3) {
+            printf("skip %s: not a PPM image\n", images[i]);
+            vc_image_free(img);
+            continue;
+        }
+        IVC *rgb = diff_clone(img);
+        IVC *gray = diff_image_new(img->width, img->height, 1);
+        IVC *bin = diff_image_new(img->width, img->height, 1);
+        vc_image_free(img);
+
+        diff_rgb(s, images[i], rgb);
+        diff_recognize(s, images[i], rgb);
+
+        vc_ref_color_remove(rgb, 12, 250);
+        vc_ref_rgb_to_gray(rgb, gray);
+        vc_ref_brigten(gray, 100);
+        diff_gray(s, images[i], gray);
+
+        vc_ref_gray_to_binary(gray, bin, 254);
+        diff_binary(s, images[i], bin);
+        diff_labelling(s, images[i], bin);
+
+        vc_image_free(rgb);
+        vc_image_free(gray);
+        vc_image_free(bin);
+    }
+
+}
+
+/**
+ * Corre todos os kernels nas duas implementações: rounds imagens aleatórias
+ * de cada tamanho e as imagens reais indicadas, uma vez por cada nivel SIMD
+ * até ao nivel em uso (o detectado ou o de VC_CPU), com e sem as versões especializadas
+ * @param seed
+ * @param rounds
+ * @param images imagens reais (NULL terminado)
+ * @param verbose 1 para listar também as comparações iguais
+ * @return numero de comparações diferentes
+ */
+int bench_differential(unsigned int seed, int rounds, char **images, int verbose) {
+    VC_CPU_LEVEL level = vc_cpu_level();
+    int specialised = vc_cpu_specialised();
+    int checks = 0, failures = 0;
+
+    // Cada nivel com as versões especializadas e com as genéricas
+    for (int l = VC_CPU_SCALAR; l <= (int)level; l++) {
+        for (int generic = 0; generic <= 1; generic++) {
+            DIFF_STATE s = { seed, 0, 0, verbose };
+            const char *mode = generic ? "generic" : "specialised";
+
+            vc_cpu_select((VC_CPU_LEVEL)l);
+            vc_cpu_set_specialised(!generic);
+            printf("cpu %s %s\n", vc_cpu_name((VC_CPU_LEVEL)l), mode);
+            diff_level(&s, rounds, images);
+            printf("differential %s %s: %d checks, %d failures\n", vc_cpu_name((VC_CPU_LEVEL)l), mode, s.checks, s.failures);
+
+            checks += s.checks;
+            failures += s.failures;
+        }
+    }
+    vc_cpu_select(level);
+    vc_cpu_set_specialised(specialised);
+
+    printf("differential: %d checks, %d failures\n", checks, failures);
+    return failures;
+}
+
+/**
+ * Compara um ficheiro gerado com o ficheiro do corpus
+ * @return 0 igual, 1 dentro da tolerância, 2 diferente
+ */
+static int golden_file(const char *golden, const char *output, const char *name, int tolerance) {
+    IVC *a = vc_read_image((char *)golden);
+    IVC *b = vc_read_image((char *)output);
+    int ret = 0;
+
+    if (a == NULL || b == NULL || a->width != b->width || a->height != b->height || a->channels != b->channels) {
+        printf("FAIL %s: cannot compare %s with %s\n", name, golden, output);
+        vc_image_free(a);
+        vc_image_free(b);
+        return 2;
+    }
+
+    long n = (long)a->bytesperline * a->height, first = -1, count = 0;
+    int maxdiff = 0;
+    for (long i = 0; i < n; i++) {
+        int d = abs(a->data[i] - b->data[i]);
+        if (d == 0) continue;
+        if (first < 0) first = i;
+        if (d > maxdiff) maxdiff = d;
+        count++;
+    }
+
+    if (first >= 0) {
+        long px = first / a->channels;
+        ret = (maxdiff <= tolerance) ? 1 : 2;
+        printf("%s %s: %ld bytes differ (max %d), first at x=%ld y=%ld c=%ld golden=%d got=%d\n",
+               ret == 1 ? "tol " : "FAIL", name, count, maxdiff, px % a->width, px / a->width,
+               first % a->channels, a->data[first], b->data[first]);
+    }
+    vc_image_free(a);
+    vc_image_free(b);
+    return ret;
+}
+
+/**
+ * Teste end-to-end: para cada directorio do corpus (ex: examples_output/01)
+ * processa o original_1.ppm lá gravado e compara cada ficheiro gerado com o do corpus
+ * e a matricula lida com a esperada
+ * @param corpus
+ * @param tmpdir directorio onde os resultados são gerados
+ * @param tolerance diferença máxima por byte aceite
+ * @param update se 1 actualiza o corpus (copia os ficheiros gerados e remove os que já não são gerados)
+ * @return numero de ficheiros diferentes ou em falta e de matriculas erradas
+ */
+int bench_golden(const char *corpus, const char *tmpdir, int tolerance, int update) {
+    struct dirent **dirs;
+    int ndirs = scandir(corpus, &dirs, NULL, alphasort);
+    int failures = 0, files = 0, tolerated = 0;
+    VC_RECOGNIZER ctx;
+    VC_RESULT result;
+    DIFF_STATE plates = { 0, 0, 0, 0 };
+
+    if (ndirs < 0) {
+        printf("FAIL %s: not found\n", corpus);
+        return 1;
+    }
+
+    for (int d = 0; d < ndirs; d++) {
+        char golden[PATH_MAX], input[PATH_MAX + 16], output[PATH_MAX], name[PATH_MAX];
+
+        snprintf(golden, sizeof(golden), "%s/%s", corpus, dirs[d]->d_name);
+        snprintf(input, sizeof(input), "%s/original_1.ppm", golden);
+        snprintf(output, sizeof(output), "%s/%s", tmpdir, dirs[d]->d_name);
+
+        if (dirs[d]->d_name[0] == '.' || !exists(input)) continue;
+
+        char cmd[PATH_MAX * 2 + 16];
+        snprintf(cmd, sizeof(cmd), "mkdir -p %s", output);
+        if (system(cmd) != 0) continue;
+
+        // Um contexto novo por imagem, como uma execução de bin/plate-recognizer
+        vc_recognizer_init(&ctx);
+        ctx.output_dir = output;
+        processImage(&ctx, input, &result);
+        vc_recognizer_free(&ctx);
+
+        // A matricula lida tem de ser a esperada (directorios dos exemplos)
+        diff_check_plate(&plates, dirs[d]->d_name, &result);
+
+        // Ficheiros do corpus
+        struct dirent **entries;
+        int n = scandir(golden, &entries, NULL, alphasort);
+        for (int e = 0; e < n; e++) {
+            char a[PATH_MAX * 2], b[PATH_MAX * 2];
+
+            if (strstr(entries[e]->d_name, ".ppm") != NULL) {
+                snprintf(a, sizeof(a), "%s/%s", golden, entries[e]->d_name);
+                snprintf(b, sizeof(b), "%s/%s", output, entries[e]->d_name);
+                snprintf(name, sizeof(name), "%s/%s", dirs[d]->d_name, entries[e]->d_name);
+                files++;
+
+                if (!exists(b)) {
+                    printf("FAIL %s: not generated%s\n", name, update ? ", removed" : "");
+                    failures++;
+                    if (update) remove(a);
+                } else {
+                    int r = golden_file(a, b, name, tolerance);
+                    failures += (r == 2);
+                    tolerated += (r == 1);
+                }
+            }
+            free(entries[e]);
+        }
+        free(entries);
+
+        // Ficheiros gerados que o corpus não tem
+        n = scandir(output, &entries, NULL, alphasort);
+        for (int e = 0; e < n; e++) {
+            char a[PATH_MAX * 2];
+            snprintf(a, sizeof(a), "%s/%s", golden, entries[e]->d_name);
+            if (entries[e]->d_name[0] != '.' && !exists(a)) {
+                printf("FAIL %s/%s: not in the corpus\n", dirs[d]->d_name, entries[e]->d_name);
+                failures++;
+            }
+            free(entries[e]);
+        }
+        free(entries);
+
+        // Actualiza o corpus com os resultados da versão actual
+        if (update) {
+            snprintf(cmd, sizeof(cmd), "cp %s/*.ppm %s", output, golden);
+            if (system(cmd) != 0) printf("FAIL %s: cannot update\n", golden);
+        }
+    }
+
+    for (int d = 0; d < ndirs; d++) free(dirs[d]);
+    free(dirs);
+
+    failures += plates.failures;
+    printf("golden: %d files, %d within tolerance %d, %d plates, %d failures\n", files, tolerated, tolerance,
+           plates.checks, failures);
+    return failures;
+}
@@ -0,0 +1,246 @@
+/**
+ * Este ficheiro contem o teste de carga end-to-end do benchmark
+ * @brief Replay de um corpus por processImage com N threads: imagens por segundo, percentis da latência e pico de memória
+ * @file load.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Cada thread tem o seu contexto (como os workers do servidor) e tira a próxima imagem de um indice partilhado,
+ * por isso há sempre N imagens em processamento. A latência de uma imagem é a de processImage completo
+ * (leitura do ficheiro incluida), sem dumps. O pico de memória é o VmHWM do processo, reposto
+ * antes de cada medição (/proc/self/clear_refs) para não contar com a preparação do corpus. As imagens
+ * alocadas por imagem processada e o pico dos bytes das imagens vêm da contabilidade de vc_image_new (memory.h)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> // PATH_MAX
+#include <pthread.h>
+#include "bench.h"
+#include "plate-recognizer.h"
+#include "cpu.h"
+#include "memory.h"
+
+/**
+ * Estado de um replay partilhado pelas threads
+ */
+typedef struct {
+    char (*files)[PATH_MAX];        // Corpus
+    int nfiles;
+    int total;                      // Imagens a processar (passes * nfiles)
+    int next;                       // Próxima imagem a distribuir
+    long long *latency;             // Latência de cada imagem (ns), NULL no aquecimento
+    int found;                      // Imagens com matricula encontrada
+} LOAD_RUN;
+
+/**
+ * Uma thread do replay
+ */
+typedef struct {
+    LOAD_RUN *run;
+    VC_RECOGNIZER ctx;
+    pthread_t thread;
+} LOAD_WORKER;
+
+static void *load_worker(void *arg) {
+    LOAD_WORKER *w = arg;
+    LOAD_RUN *run = w->run;
+    VC_RESULT result;
+    int i;
+
+    while ((i = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->total) {
+        long long t0 = bench_now();
+        int found = processImage(&w->ctx, run->files[i % run->nfiles], &result);
+        long long t1 = bench_now();
+
+        if (run->latency != NULL) run->latency[i] = t1 - t0;
+        if (found > 0) __atomic_fetch_add(&run->found, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/**
+ * Corre as imagens de run em nworkers threads e espera que acabem
+ * @return tempo total (ns)
+ */
+static long long load_replay(LOAD_WORKER *workers, int nworkers, LOAD_RUN *run) {
+    long long t0 = bench_now();
+    int started = 0;
+
+    for (int t = 0; t < nworkers; t++) {
+        workers[t].run = run;
+        if (pthread_create(&workers[t].thread, NULL, load_worker, &workers[t]) != 0) break;
+        started++;
+    }
+    // Sem threads nenhumas a thread actual faz o trabalho todo
+    if (started == 0) load_worker(&workers[0]);
+    for (int t = 0; t < started; t++) pthread_join(workers[t].thread, NULL);
+    return bench_now() - t0;
+}
+
+/**
+ * Repõe o pico de memória do processo (Linux >= 4.0)
+ * @return 0 se não foi possivel
+ */
+static int load_peak_reset(void) {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    int ok;
+
+    if (f == NULL) return 0;
+    ok = (fputs("5", f) >= 0);
+    return (fclose(f) == 0) && ok;
+}
+
+/**
+ * Pico de memória residente do processo desde a ultima reposição
+ * @return kB ou -1
+ */
+static long load_peak_rss(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+
+    if (f == NULL) return -1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static int compare_latency(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil p (nearest rank) de n latências ordenadas
+static long long load_percentile(const long long *sorted, int n, int p) {
+    int rank = (int)(((long long)p * n + 99) / 100);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Escreve o corpus em tmpdir: cada imagem no tamanho original e redimensionada para cada tamanho pedido
+ * @return numero de ficheiros
+ */
+static int load_corpus(const BENCH_LOAD *o, const char *tmpdir, char (*files)[PATH_MAX], int max) {
+    int n = 0;
+
+    for (int i = 0; o->images[i] != NULL; i++) {
+        IVC *img = vc_read_image(o->images[i]);
+
+        if (img == NULL) {
+            fprintf(stderr, "bench: %s not found\n", o->images[i]);
+            continue;
+        }
+        if (n < max) snprintf(files[n++], PATH_MAX, "%s", o->images[i]);
+
+        for (int s = 0; s < o->nsizes && n < max; s++) {
+            IVC *resized = bench_resize(img, o->widths[s], o->heights[s]);
+
+            if (resized == NULL) continue;
+            snprintf(files[n], PATH_MAX, "%s/load_%d_%dx%d.ppm", tmpdir, i, o->widths[s], o->heights[s]);
+            if (vc_write_image(files[n], resized)) n++;
+            vc_image_free(resized);
+        }
+        vc_image_free(img);
+    }
+    return n;
+}
+
+/**
+ * Teste de carga: replay do corpus (imagens e cópias redimensionadas) por processImage com cada
+ * concorrência pedida, uma linha por concorrência com imagens/s, p50/p90/p99/max e pico de memória
+ * @param o
+ * @param tmpdir directorio onde as cópias redimensionadas são escritas
+ * @return 1 se não foi possivel correr
+ */
+int bench_load(const BENCH_LOAD *o, const char *tmpdir) {
+    int max = 0;
+
+    for (int i = 0; o->images[i] != NULL; i++) max += 1 + o->nsizes;
+
+    char (*files)[PATH_MAX] = malloc((max > 0 ? max : 1) * sizeof(*files));
+    if (files == NULL) return 1;
+
+    int nfiles = load_corpus(o, tmpdir, files, max);
+    if (nfiles == 0) {
+        free(files);
+        return 1;
+    }
+
+    fprintf(stderr, "bench: load, %d images, %d passes, cpu %s\n", nfiles, o->passes, vc_cpu_name(vc_cpu_level()));
+
+    if (o->json) printf("[");
+    else printf("label,concurrency,images,passes,seconds,images_s,p50_us,p90_us,p99_us,max_us,found,peak_rss_kb,allocs_per_image,image_peak_kb\n");
+
+    for (int c = 0; c < o->nconcurrency; c++) {
+        int nworkers = o->concurrency[c];
+        LOAD_WORKER *workers = (LOAD_WORKER *)calloc(nworkers, sizeof(LOAD_WORKER));
+        LOAD_RUN run;
+
+        if (workers == NULL) break;
+        for (int t = 0; t < nworkers; t++) vc_recognizer_init(&workers[t].ctx);
+
+        // Aquecimento: os contextos ficam com os buffers alocados, como num servidor já a correr
+        memset(&run, 0, sizeof(LOAD_RUN));
+        run.files = files;
+        run.nfiles = nfiles;
+        run.total = o->warmup * nfiles;
+        load_replay(workers, nworkers, &run);
+
+        memset(&run, 0, sizeof(LOAD_RUN));
+        run.files = files;
+        run.nfiles = nfiles;
+        run.total = o->passes * nfiles;
+        run.latency = (long long *)calloc(run.total, sizeof(long long));
+        if (run.latency == NULL) {
+            for (int t = 0; t < nworkers; t++) vc_recognizer_free(&workers[t].ctx);
+            free(workers);
+            break;
+        }
+
+        VC_MEMORY before, after;
+
+        if (!load_peak_reset()) fprintf(stderr, "bench: cannot reset the peak RSS, peak_rss_kb includes the corpus preparation\n");
+        vc_memory_reset_peak();
+        vc_memory_get(&before);
+        long long elapsed = load_replay(workers, nworkers, &run);
+        long peak = load_peak_rss();
+        vc_memory_get(&after);
+        double allocs = (double)(after.allocations - before.allocations) / run.total;
+        double image_peak = after.peak / 1024.0;
+
+        qsort(run.latency, run.total, sizeof(long long), compare_latency);
+        double seconds = elapsed / 1e9;
+        double rate = run.total / seconds;
+        double p50 = load_percentile(run.latency, run.total, 50) / 1e3, p90 = load_percentile(run.latency, run.total, 90) / 1e3;
+        double p99 = load_percentile(run.latency, run.total, 99) / 1e3, pmax = run.latency[run.total - 1] / 1e3;
+
+        if (o->json) {
+            printf("%s\n  {\"label\": \"%s\", \"concurrency\": %d, \"images\": %d, \"passes\": %d, \"seconds\": %.3f, "
+                   "\"images_s\": %.2f, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, "
+                   "\"found\": %d, \"peak_rss_kb\": %ld, \"allocs_per_image\": %.2f, \"image_peak_kb\": %.1f}",
+                   c ? "," : "", o->label, nworkers, run.total, o->passes, seconds, rate, p50, p90, p99, pmax, run.found, peak,
+                   allocs, image_peak);
+        } else {
+            printf("%s,%d,%d,%d,%.3f,%.2f,%.1f,%.1f,%.1f,%.1f,%d,%ld,%.2f,%.1f\n",
+                   o->label, nworkers, run.total, o->passes, seconds, rate, p50, p90, p99, pmax, run.found, peak,
+                   allocs, image_peak);
+        }
+        fflush(stdout);
+
+        free(run.latency);
+        for (int t = 0; t < nworkers; t++) vc_recognizer_free(&workers[t].ctx);
+        free(workers);
+    }
+
+    if (o->json) printf("\n]\n");
+
+    // As cópias redimensionadas são apagadas com tmpdir
+    free(files);
+    return 0;
+}
@@ -0,0 +1,710 @@
+/**
+ * Este ficheiro contem as implementações de referência (escalares) dos kernels de vc.c e plate-recognizer.c
+ * @brief Backend de referência: cópia congelada das versões escalares, usada como oráculo pelo teste diferencial
+ * @file reference.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+// Estas funções não devem ser optimizadas: qualquer versão nova de um kernel
+// tem de produzir exactamente os mesmos bytes que a versão daqui
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "reference.h"
+
+// Converter de RGB para Gray
+int vc_ref_rgb_to_gray(IVC *src, IVC *dst) {
+
+    unsigned char *datasrc = (unsigned char *)src->data;
+    int bytesperline_src = src->width * src->channels;
+    int channels_src = src->channels;
+    unsigned char *datadst = (unsigned char *)dst->data;
+    int bytesperline_dst = dst->width * dst->channels;
+    int channels_dst = dst->channels;
+    int width = src->width;
+    int height = src->height;
+    int x, y;
+    long int pos_src, pos_dst;
+    float rf, gf, bf;
+
+    // Verificação de Erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+    if ((src->channels != 3) || (dst->channels != 1)) return 0;
+
+    // Ciclo que vai percorrer todos os pixeis da imagem e converter a imagem
+    for (y = 0; y<height; y++)
+    {
+        for (x = 0; x<width; x++)
+        {
+            pos_src = y * bytesperline_src + x * channels_src;
+            pos_dst = y * bytesperline_dst + x * channels_dst;
+
+            rf = (float)datasrc[pos_src];
+            gf = (float)datasrc[pos_src + 1];
+            bf = (float)datasrc[pos_src + 2];
+
+            datadst[pos_dst] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
+        }
+    }
+    return 1;
+}
+
+// Conversão de imagem cinzenta para binária
+int vc_ref_gray_to_binary(IVC* src,IVC* dst, int threshold) {
+    unsigned char *datasrc = (unsigned char *)src->data;
+    int bytesperline = src->width * src->channels;
+    int channels = src->channels;
+    unsigned char *datadst = (unsigned char *)dst->data;
+    int bytesperline_dst = dst->width * dst->channels;
+    int channels_dst = dst->channels;
+    int width = src->width;
+    int height = src->height;
+    int x, y;
+    long int pos_src, pos_dst;
+
+    // Verificação de Erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+    if ((src->channels != 1) || (dst->channels != 1)) return 0;
+    if (channels != 1) return 0;
+
+    // Ciclo que vai percorrer todos os pixeis da imagem
+    for (y = 0; y<height; y++)
+    {
+        for (x = 0; x<width; x++)
+        {
+            pos_src = y * bytesperline + x * channels;
+            pos_dst = y * bytesperline_dst + x * channels_dst;
+
+            if (datasrc[pos_src] > threshold) datadst[pos_dst] = 255;
+            else if (datasrc[pos_src] <= threshold) datadst[pos_src] = 0;
+        }
+    }
+    return 1;
+}
+
+// Dilatação de uma imagem em binário
+int vc_ref_binary_dilate(IVC * src, IVC * dst, int kernel)
+{
+	unsigned char *datasrc = (unsigned char *)src->data;
+	int bytesperline_src = src->width * src->channels;
+	int channels_src = src->channels;
+	unsigned char *datadst = (unsigned char *)dst->data;
+	int width = src->width;
+	int height = src->height;
+	long int pos;
+	int y, x;
+	int aux;
+
+	int offset = kernel / 2;
+	int ky, kx;
+	long int posk;
+
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+	if (channels_src != 1) return 0;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pos = y * bytesperline_src + x * channels_src;
+			aux = 0;
+
+			// NxM Vizinhos
+			for (ky = -offset; ky <= offset; ky++)
+			{
+				for (kx = -offset; kx <= offset; kx++)
+				{
+					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
+					{
+						posk = (y + ky) * bytesperline_src + (x + kx) * channels_src;
+
+						if (datasrc[posk] == 255) {
+							aux = 255;
+						}
+					}
+				}
+			}
+
+			if (aux == 255) datadst[pos] = 255;
+			else datadst[pos] = 0;
+		}
+	}
+	return 1;
+
+}
+
+// Erosão de uma imagem em binário
+int vc_ref_binary_erode(IVC * src, IVC * dst, int kernel)
+{
+	unsigned char *datasrc = (unsigned char *)src->data;
+	int bytesperline_src = src->width * src->channels;
+	int channels_src = src->channels;
+	unsigned char *datadst = (unsigned char *)dst->data;
+	int width = src->width;
+	int height = src->height;
+	long int pos;
+	int y, x;
+	int nb;
+
+	int offset = kernel / 2;
+	int ky, kx;
+	long int posk;
+
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+	if (channels_src != 1) return 0;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pos = y * bytesperline_src + x * channels_src;
+			nb = 255;
+
+			// NxM Vizinhos
+			for (ky = -offset; ky <= offset; ky++)
+			{
+				for (kx = -offset; kx <= offset; kx++)
+				{
+					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
+					{
+						posk = (y + ky) * bytesperline_src + (x + kx) * channels_src;
+
+						if (datasrc[posk] == 0) {
+							nb = 0;
+						}
+					}
+				}
+			}
+
+			if (nb != 0) datadst[pos] = 255;
+			else datadst[pos] = 0;
+		}
+	}
+	return 1;
+
+}
+
+// Fecho de uma imagem em binário
+int vc_ref_binary_close(IVC *src, IVC *dst, int kernel)
+{
+    int ret = 1;
+
+    IVC *aux = vc_image_new(src->width, src->height, src->channels, src->levels);
+
+    ret &= vc_ref_binary_dilate(src, aux, kernel);
+    ret &= vc_ref_binary_erode(aux, dst, kernel);
+
+    vc_image_free(aux);
+
+    return ret;
+}
+
+// Etiquetagem de blobs
+OVC* vc_ref_binary_blob_labelling(IVC *src, IVC *dst, int *nlabels) {
+
+    unsigned char *datasrc = (unsigned char *)src->data;
+    unsigned char *datadst = (unsigned char *)dst->data;
+    int width = src->width;
+    int height = src->height;
+    int bytesperline = src->bytesperline;
+    int channels = src->channels;
+    int x, y, a, b;
+    long int i, size;
+    long int posX, posA, posB, posC, posD;
+    int labeltable[1024] = { 0 };
+    int label = 1; // Etiqueta inicial.
+    int num, tmplabel;
+    OVC *blobs; // Apontador para array de blobs (objectos) que será retornado desta função.
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return NULL;
+    if (channels != 1) return NULL;
+
+    // Copia dados da imagem binária para imagem grayscale
+    memcpy(datadst, datasrc, bytesperline * height);
+
+    // Todos os pixéis de plano de fundo devem obrigatóriamente ter valor 0
+    // Todos os pixéis de primeiro plano devem obrigatóriamente ter valor 255
+    // Serão atribuídas etiquetas no intervalo [1,254]
+    // Este algoritmo está assim limitado a 255 labels
+    for (i = 0, size = bytesperline * height; i<size; i++)
+        if (datadst[i] != 0) datadst[i] = 255;
+
+    // Limpa os rebordos da imagem binária
+    for (y = 0; y<height; y++) {
+        datadst[y * bytesperline + 0 * channels] = 0;
+        datadst[y * bytesperline + (width - 1) * channels] = 0;
+    }
+
+    for (x = 0; x<width; x++) {
+        datadst[0 * bytesperline + x * channels] = 0;
+        datadst[(height - 1) * bytesperline + x * channels] = 0;
+    }
+
+    // Efectua a etiquetagem
+    for (y = 1; y<height - 1; y++) {
+        for (x = 1; x<width - 1; x++) {
+            // Kernel:
+            // A B C
+            // D X
+
+            posA = (y - 1) * bytesperline + (x - 1) * channels; // A
+            posB = (y - 1) * bytesperline + x * channels; // B
+            posC = (y - 1) * bytesperline + (x + 1) * channels; // C
+            posD = y * bytesperline + (x - 1) * channels; // D
+            posX = y * bytesperline + x * channels; // X
+
+            // Se o pixel foi marcado
+            if (datadst[posX] != 0) {
+                if ((datadst[posA] == 0) && (datadst[posB] == 0) && (datadst[posC] == 0) && (datadst[posD] == 0)) {
+                    // Tabela de etiquetas cheia: a imagem tem demasiados objectos
+                    if (label >= 1024) {
+                        *nlabels = 0;
+                        return NULL;
+                    }
+                    datadst[posX] = label;
+                    labeltable[label] = label;
+                    label++;
+                }
+                else {
+                    num = 255;
+
+                    // Se A está marcado
+                    if (datadst[posA] != 0) num = labeltable[datadst[posA]];
+                    // Se B está marcado, e é menor que a etiqueta "num"
+                    if ((datadst[posB] != 0) && (labeltable[datadst[posB]] < num)) num = labeltable[datadst[posB]];
+                    // Se C está marcado, e é menor que a etiqueta "num"
+                    if ((datadst[posC] != 0) && (labeltable[datadst[posC]] < num)) num = labeltable[datadst[posC]];
+                    // Se D está marcado, e é menor que a etiqueta "num"
+                    if ((datadst[posD] != 0) && (labeltable[datadst[posD]] < num)) num = labeltable[datadst[posD]];
+
+                    // Atribui a etiqueta ao pixel
+                    datadst[posX] = num;
+                    labeltable[num] = num;
+
+                    // Actualiza a tabela de etiquetas
+                    if (datadst[posA] != 0) {
+                        if (labeltable[datadst[posA]] != num) {
+                            for (tmplabel = labeltable[datadst[posA]], a = 1; a<label; a++) {
+                                if (labeltable[a] == tmplabel)
+                                    labeltable[a] = num;
+                            }
+                        }
+                    }
+                    if (datadst[posB] != 0) {
+                        if (labeltable[datadst[posB]] != num) {
+                            for (tmplabel = labeltable[datadst[posB]], a = 1; a<label; a++) {
+                                if (labeltable[a] == tmplabel)
+                                    labeltable[a] = num;
+                            }
+                        }
+                    }
+                    if (datadst[posC] != 0) {
+                        if (labeltable[datadst[posC]] != num) {
+                            for (tmplabel = labeltable[datadst[posC]], a = 1; a<label; a++) {
+                                if (labeltable[a] == tmplabel)
+                                    labeltable[a] = num;
+                            }
+                        }
+                    }
+                    if (datadst[posD] != 0) {
+                        if (labeltable[datadst[posD]] != num) {
+                            for (tmplabel = labeltable[datadst[posC]], a = 1; a<label; a++) {
+                                if (labeltable[a] == tmplabel)
+                                    labeltable[a] = num;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Volta a etiquetar a imagem
+    for (y = 1; y<height - 1; y++) {
+        for (x = 1; x<width - 1; x++) {
+            posX = y * bytesperline + x * channels; // X
+
+            if (datadst[posX] != 0) {
+                datadst[posX] = labeltable[datadst[posX]];
+            }
+        }
+    }
+
+    //printf("\nMax Label = %d\n", label);
+
+    // Contagem do número de blobs
+    // Passo 1: Eliminar, da tabela, etiquetas repetidas
+    for (a = 1; a<label - 1; a++) {
+        for (b = a + 1; b<label; b++)
+            if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
+    }
+    // Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que não hajam valores vazios (zero) entre etiquetas
+    *nlabels = 0;
+    for (a = 1; a<label; a++) {
+        if (labeltable[a] != 0) {
+            labeltable[*nlabels] = labeltable[a]; // Organiza tabela de etiquetas
+            (*nlabels)++; // Conta etiquetas
+        }
+    }
+
+    // Se não há blobs
+    if (*nlabels == 0) return NULL;
+
+    // Cria lista de blobs (objectos) e preenche a etiqueta
+    blobs = (OVC *)calloc((*nlabels), sizeof(OVC));
+
+    if (blobs != NULL)
+        for (a = 0; a<(*nlabels); a++) blobs[a].label = labeltable[a];
+    else return NULL;
+
+    return blobs;
+}
+
+// Extração de informação referente a blobs
+int vc_ref_binary_blob_info(IVC *src, OVC *blobs, int nblobs) {
+
+    unsigned char *data = (unsigned char *)src->data;
+    int width = src->width;
+    int height = src->height;
+    int bytesperline = src->bytesperline;
+    int channels = src->channels;
+    int x, y, i;
+    long int pos;
+    int xmin, ymin, xmax, ymax;
+    long int sumx, sumy;
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if (channels != 1) return 0;
+
+    // Conta área de cada blob
+    for (i = 0; i<nblobs; i++) {
+        xmin = width - 1;
+        ymin = height - 1;
+        xmax = 0;
+        ymax = 0;
+
+        sumx = 0;
+        sumy = 0;
+
+        blobs[i].area = 0;
+
+        for (y = 1; y<height - 1; y++) {
+            for (x = 1; x<width - 1; x++) {
+                pos = y * bytesperline + x * channels;
+
+                if (data[pos] == blobs[i].label) {
+                    // Área
+                    blobs[i].area++;
+
+                    // Centro de Gravidade
+                    sumx += x;
+                    sumy += y;
+
+                    // Bounding Box
+                    if (xmin > x) xmin = x;
+                    if (ymin > y) ymin = y;
+                    if (xmax < x) xmax = x;
+                    if (ymax < y) ymax = y;
+
+                    // Perímetro
+                    // Se pelo menos um dos quatro vizinhos não pertence ao mesmo label, então é um pixel de contorno
+                    if ((data[pos - 1] != blobs[i].label) || (data[pos + 1] != blobs[i].label) || (data[pos - bytesperline] != blobs[i].label) || (data[pos + bytesperline] != blobs[i].label))
+                        blobs[i].perimeter++;
+                }
+            }
+        }
+
+        // Bounding Box
+        blobs[i].x = xmin;
+        blobs[i].y = ymin;
+        blobs[i].width = (xmax - xmin) + 1;
+        blobs[i].height = (ymax - ymin) + 1;
+
+        // Centro de Gravidade
+        //blobs[i].xc = (xmax - xmin) / 2;
+        //blobs[i].yc = (ymax - ymin) / 2;
+        blobs[i].xc = sumx / MAX(blobs[i].area, 1);
+        blobs[i].yc = sumy / MAX(blobs[i].area, 1);
+    }
+
+    return 1;
+}
+
+// Redução 2x por média de blocos 2x2 (1 ou 3 canais)
+static int vc_ref_downscale2(IVC *src, IVC *dst) {
+    int channels = src->channels;
+    int x, y, c;
+
+    for (y = 0; y < dst->height; y++) {
+        unsigned char *row0 = src->data + (2 * y) * src->bytesperline;
+        unsigned char *row1 = row0 + src->bytesperline;
+        unsigned char *out = dst->data + y * dst->bytesperline;
+
+        for (x = 0; x < dst->width; x++) {
+            long int pos = 2 * x * channels;
+            for (c = 0; c < channels; c++) {
+                out[x * channels + c] = (unsigned char)((row0[pos + c] + row0[pos + channels + c] +
+                                                         row1[pos + c] + row1[pos + channels + c] + 2) >> 2);
+            }
+        }
+    }
+    return 1;
+}
+
+// Redução de uma imagem por um factor 2 ou 4 (média de blocos)
+int vc_ref_downscale(IVC *src, IVC *dst, int factor) {
+    int ret;
+
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((factor != 2) && (factor != 4)) return 0;
+    if ((dst->width != src->width / factor) || (dst->height != src->height / factor)) return 0;
+    if ((src->channels != dst->channels) || (dst->width <= 0) || (dst->height <= 0)) return 0;
+
+    if (factor == 2) return vc_ref_downscale2(src, dst);
+
+    IVC *aux = vc_image_new(src->width / 2, src->height / 2, src->channels, src->levels);
+    if (aux == NULL) return 0;
+
+    ret = vc_ref_downscale2(src, aux) && vc_ref_downscale2(aux, dst);
+
+    vc_image_free(aux);
+
+    return ret;
+}
+
+// Clareamento de imagem pela soma (os canais G e B partem do valor de R)
+int vc_ref_brigten(IVC *src, int value) {
+    unsigned char *datasrc = (unsigned char *)src->data;
+    int bytesperline_src = src->width * src->channels;
+    int channels_src = src->channels;
+    int x, y;
+    long int pos_src;
+
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if (!((src->channels == 3) || (src->channels == 1))) return 0;
+
+    for (y = 0; y < src->height; y++) {
+        for (x = 0; x < src->width; x++) {
+            pos_src = y * bytesperline_src + x * channels_src;
+            datasrc[pos_src] = ((datasrc[pos_src] + value) > 255) ? 255 : datasrc[pos_src] + value;
+            if (channels_src == 3) {
+                datasrc[pos_src+1] = ((datasrc[pos_src+1] + value) > 255) ? 255 : datasrc[pos_src] + value;
+                datasrc[pos_src+2] = ((datasrc[pos_src+2] + value) > 255) ? 255 : datasrc[pos_src] + value;
+            }
+        }
+    }
+    return 1;
+}
+
+// Desvio padrão entre r, g e b
+static int vc_ref_desvio(int r, int g, int b) {
+    int soma = 0;
+    float media, SD = 0.0;
+    soma = r + g + b;
+    media = soma / 3;
+    SD = (r - media)*(r - media);
+    SD = SD + (g - media)*(g - media);
+    SD = SD + (b - media)*(b - media);
+    return sqrt(SD / 3);
+}
+
+// Remove cores tendo em conta o desvio padrão
+// Tal como o original, o terceiro canal é lido em pos + 3 (o ultimo pixel lê 1 byte depois da imagem)
+int vc_ref_color_remove(IVC *image, int threshold, int color) {
+    unsigned char *data = (unsigned char *) image->data;
+    int channels = image->channels;
+    int x, y;
+    long int pos;
+
+    if ((image->width <= 0) || (image->height <= 0) || (image->data == NULL)) return 0;
+    if (channels != 3) return 0;
+
+    for (y = 0; y < image->height; y++) {
+        for (x = 0; x < image->width; x++) {
+            pos = y * image->bytesperline + x * channels;
+            if (vc_ref_desvio(data[pos], data[pos+1], data[pos+3]) >= threshold) {
+                data[pos] = color;
+                data[pos + 1] = color;
+                data[pos + 2] = color;
+            }
+        }
+    }
+    return 1;
+}
+
+// Inverte uma imagem binária
+void vc_ref_invert(IVC *src) {
+    int size = src->height * src->width;
+    for (int x = 0; x < size; x++) {
+        src->data[x] = (src->data[x] == 0 ? 255 : 0);
+    }
+}
+
+// Histograma de uma imagem de 1 canal, um pixel de cada vez
+int vc_ref_histogram(IVC *src, VC_HISTOGRAM *h) {
+    memset(h, 0, sizeof(VC_HISTOGRAM));
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (src->channels != 1)) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            h->bins[src->data[y * src->bytesperline + x]]++;
+        }
+    }
+    h->total = (long int)src->width * src->height;
+    return 1;
+}
+
+// Mediana contando os (2 * radius + 1)^2 vizinhos de cada pixel, com as margens repetidas
+int vc_ref_gray_median(IVC *src, IVC *dst, int radius) {
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+    if ((src->channels != 1) || (dst->channels != 1) || (radius < 0)) return 0;
+
+    int half = ((2 * radius + 1) * (2 * radius + 1)) / 2;
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            int count[256] = { 0 };
+            for (int ky = y - radius; ky <= y + radius; ky++) {
+                int yy = MAX(0, MIN(src->height - 1, ky));
+                for (int kx = x - radius; kx <= x + radius; kx++) {
+                    int xx = MAX(0, MIN(src->width - 1, kx));
+                    count[src->data[yy * src->bytesperline + xx]]++;
+                }
+            }
+            int v = 0, sum = count[0];
+            while (sum <= half) sum += count[++v];
+            dst->data[y * dst->bytesperline + x] = (unsigned char)v;
+        }
+    }
+    return 1;
+}
+
+// Média de cada pixel somando as 2 * radius + 1 colunas vizinhas e depois as 2 * radius + 1 linhas
+// vizinhas (margens repetidas), arredondada em cada passagem
+int vc_ref_box_blur(IVC *src, IVC *dst, int radius) {
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (radius < 0)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+
+    int divisor = 2 * radius + 1, channels = src->channels;
+    unsigned char *aux = malloc(src->bytesperline * src->height);
+    if (aux == NULL) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            for (int c = 0; c < channels; c++) {
+                int sum = 0;
+                for (int k = x - radius; k <= x + radius; k++) {
+                    sum += src->data[y * src->bytesperline + MAX(0, MIN(src->width - 1, k)) * channels + c];
+                }
+                aux[y * src->bytesperline + x * channels + c] = (unsigned char)((sum + divisor / 2) / divisor);
+            }
+        }
+    }
+    for (int y = 0; y < src->height; y++) {
+        for (int i = 0; i < src->bytesperline; i++) {
+            int sum = 0;
+            for (int k = y - radius; k <= y + radius; k++) sum += aux[MAX(0, MIN(src->height - 1, k)) * src->bytesperline + i];
+            dst->data[y * dst->bytesperline + i] = (unsigned char)((sum + divisor / 2) / divisor);
+        }
+    }
+    free(aux);
+    return 1;
+}
+
+// Três médias seguidas
+int vc_ref_gaussian_blur(IVC *src, IVC *dst, int radius) {
+    return vc_ref_box_blur(src, dst, radius) && vc_ref_box_blur(dst, dst, radius) && vc_ref_box_blur(dst, dst, radius);
+}
+
+// Só a passagem horizontal da média
+int vc_ref_box_blur_x(IVC *src, IVC *dst, int radius) {
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (radius < 0)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+
+    int divisor = 2 * radius + 1, channels = src->channels;
+    unsigned char *line = malloc(src->bytesperline);
+    if (line == NULL) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        memcpy(line, src->data + y * src->bytesperline, src->bytesperline);
+        for (int x = 0; x < src->width; x++) {
+            for (int c = 0; c < channels; c++) {
+                int sum = 0;
+                for (int k = x - radius; k <= x + radius; k++) sum += line[MAX(0, MIN(src->width - 1, k)) * channels + c];
+                dst->data[y * dst->bytesperline + x * channels + c] = (unsigned char)((sum + divisor / 2) / divisor);
+            }
+        }
+    }
+    free(line);
+    return 1;
+}
+
+// Sobel x com a mascara 3x3 completa, um pixel de cada vez
+int vc_ref_gray_sobel_x(IVC *src, IVC *dst) {
+    static const int mask[3][3] = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (src->channels != 1)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 1)) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        for (int x = 0; x < src->width; x++) {
+            int gx = 0;
+            for (int ky = -1; ky <= 1; ky++) {
+                for (int kx = -1; kx <= 1; kx++) {
+                    int yy = MAX(0, MIN(src->height - 1, y + ky)), xx = MAX(0, MIN(src->width - 1, x + kx));
+                    gx += mask[ky + 1][kx + 1] * src->data[yy * src->bytesperline + xx];
+                }
+            }
+            gx = abs(gx);
+            dst->data[y * dst->bytesperline + x] = (unsigned char)MIN(255, gx);
+        }
+    }
+    return 1;
+}
+
+// Reamostragem bilinear pela definição: para cada pixel a coordenada 16.16, os 4 vizinhos e a interpolação
+// de cada canal em inteiros de 32 bits
+int vc_ref_rgb_deskew(IVC *src, IVC *dst, float cx, float cy, float angle) {
+    double c = cos(angle), s = sin(angle);
+    long dx = lround(c * 65536.0), dy = lround(s * 65536.0);
+    long xmax = ((long)(src->width - 1) << 16) - 1, ymax = ((long)(src->height - 1) << 16) - 1;
+
+    if ((src->width < 2) || (src->height < 2) || (src->data == NULL) || (src->channels != 3)) return 0;
+    if ((dst->width <= 0) || (dst->height <= 0) || (dst->channels != 3)) return 0;
+
+    for (int v = 0; v < dst->height; v++) {
+        double u0 = -(dst->width - 1) / 2.0, v0 = v - (dst->height - 1) / 2.0;
+        long x0 = lround((cx + u0 * c - v0 * s) * 65536.0), y0 = lround((cy + u0 * s + v0 * c) * 65536.0);
+
+        for (int u = 0; u < dst->width; u++) {
+            long x = MAX(0, MIN(xmax, x0 + u * dx)), y = MAX(0, MIN(ymax, y0 + u * dy));
+            long wx = (x % 65536) / 256, wy = (y % 65536) / 256;
+            long xi = x / 65536, yi = y / 65536;
+
+            for (int ch = 0; ch < 3; ch++) {
+                long p00 = src->data[yi * src->bytesperline + xi * 3 + ch];
+                long p01 = src->data[yi * src->bytesperline + (xi + 1) * 3 + ch];
+                long p10 = src->data[(yi + 1) * src->bytesperline + xi * 3 + ch];
+                long p11 = src->data[(yi + 1) * src->bytesperline + (xi + 1) * 3 + ch];
+                long top = (p00 * (256 - wx) + p01 * wx + 128) / 256;
+                long bottom = (p10 * (256 - wx) + p11 * wx + 128) / 256;
+
+                dst->data[v * dst->bytesperline + u * 3 + ch] = (unsigned char)((top * (256 - wy) + bottom * wy + 128) / 256);
+            }
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,36 @@
+/**
+ * Este ficheiro contem as assinaturas das implementações de referência
+ * @brief Backend de referência (escalar) usado pelo teste diferencial do benchmark
+ * @file reference.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_REFERENCE_H
+#define VC_TP1_13871_14383_17442_REFERENCE_H
+
+#include "vc.h"
+#include "histogram.h"
+
+int vc_ref_rgb_to_gray(IVC *src, IVC *dst);
+int vc_ref_gray_to_binary(IVC *src, IVC *dst, int threshold);
+int vc_ref_binary_dilate(IVC *src, IVC *dst, int kernel);
+int vc_ref_binary_erode(IVC *src, IVC *dst, int kernel);
+int vc_ref_binary_close(IVC *src, IVC *dst, int kernel);
+OVC *vc_ref_binary_blob_labelling(IVC *src, IVC *dst, int *nlabels);
+int vc_ref_binary_blob_info(IVC *src, OVC *blobs, int nblobs);
+int vc_ref_downscale(IVC *src, IVC *dst, int factor);
+int vc_ref_brigten(IVC *src, int value);
+int vc_ref_color_remove(IVC *image, int threshold, int color);
+void vc_ref_invert(IVC *src);
+int vc_ref_histogram(IVC *src, VC_HISTOGRAM *h);
+int vc_ref_gray_median(IVC *src, IVC *dst, int radius);
+int vc_ref_box_blur(IVC *src, IVC *dst, int radius);
+int vc_ref_gaussian_blur(IVC *src, IVC *dst, int radius);
+int vc_ref_box_blur_x(IVC *src, IVC *dst, int radius);
+int vc_ref_gray_sobel_x(IVC *src, IVC *dst);
+int vc_ref_rgb_deskew(IVC *src, IVC *dst, float cx, float cy, float angle);
+
+#endif //VC_TP1_13871_14383_17442_REFERENCE_H
@@ -0,0 +1,125 @@
+/**
+ * Este ficheiro contem a escolha dos kernels vectoriais em runtime
+ * @brief Detecção do nivel SIMD do processador (SSE2, AVX2, AVX-512) e tabela de kernels por linha
+ * @file cpu.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // getenv()
+#include <string.h>
+#include <pthread.h> // pthread_once()
+#include "cpu.h"
+
+static const char *cpu_names[VC_CPU_NLEVELS] = { "scalar", "sse2", "avx2", "avx512" };
+
+static const VC_KERNELS *cpu_tables[VC_CPU_NLEVELS] = {
+        &vc_kernels_scalar, &vc_kernels_sse2, &vc_kernels_avx2, &vc_kernels_avx512
+};
+
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+static VC_CPU_LEVEL cpu_detected = VC_CPU_SCALAR;
+static VC_CPU_LEVEL cpu_level = VC_CPU_SCALAR;
+static const VC_KERNELS *cpu_kernels = &vc_kernels_scalar;
+static int cpu_specialised = 1;
+
+static void cpu_init(void) {
+    const char *env = getenv("VC_CPU");
+    const char *generic = getenv("VC_GENERIC");
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) cpu_detected = VC_CPU_SSE2;
+    if (cpu_detected == VC_CPU_SSE2 && __builtin_cpu_supports("avx2")) cpu_detected = VC_CPU_AVX2;
+    if (cpu_detected == VC_CPU_AVX2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        cpu_detected = VC_CPU_AVX512;
+    }
+#endif
+
+    cpu_level = cpu_detected;
+    if (env != NULL && *env != '\0') {
+        int i;
+        for (i = 0; i < VC_CPU_NLEVELS && strcmp(env, cpu_names[i]) != 0; i++);
+
+        if (i == VC_CPU_NLEVELS) fprintf(stderr, "VC_CPU=%s unknown, using %s\n", env, cpu_names[cpu_detected]);
+        else if ((VC_CPU_LEVEL)i > cpu_detected) fprintf(stderr, "VC_CPU=%s not supported, using %s\n", env, cpu_names[cpu_detected]);
+        else cpu_level = (VC_CPU_LEVEL)i;
+    }
+    cpu_kernels = cpu_tables[cpu_level];
+    cpu_specialised = !(generic != NULL && atoi(generic) != 0);
+}
+
+/**
+ * Nivel suportado pelo processador, sem contar com VC_CPU
+ * @return
+ */
+VC_CPU_LEVEL vc_cpu_detected(void) {
+    pthread_once(&cpu_once, cpu_init);
+    return cpu_detected;
+}
+
+/**
+ * Nivel em uso (o detectado ou o pedido em VC_CPU)
+ * @return
+ */
+VC_CPU_LEVEL vc_cpu_level(void) {
+    pthread_once(&cpu_once, cpu_init);
+    return cpu_level;
+}
+
+/**
+ * Muda o nivel em uso. Só deve ser chamada antes de haver outras threads a processar imagens
+ * @param level nivel pedido, reduzido ao detectado se o processador não o suportar
+ * @return nivel em uso
+ */
+VC_CPU_LEVEL vc_cpu_select(VC_CPU_LEVEL level) {
+    pthread_once(&cpu_once, cpu_init);
+    if (level < VC_CPU_SCALAR) level = VC_CPU_SCALAR;
+    if (level > cpu_detected) level = cpu_detected;
+
+    cpu_level = level;
+    cpu_kernels = cpu_tables[level];
+    return cpu_level;
+}
+
+/**
+ * Nome de um nivel, o mesmo aceite em VC_CPU
+ * @param level
+ * @return
+ */
+const char *vc_cpu_name(VC_CPU_LEVEL level) {
+    if (level < VC_CPU_SCALAR || level >= VC_CPU_NLEVELS) return "unknown";
+    return cpu_names[level];
+}
+
+/**
+ * Indica se as versões especializadas (1 ou 3 canais, quadrado 3x3) estão ligadas
+ * @return 0 com VC_GENERIC=1
+ */
+int vc_cpu_specialised(void) {
+    pthread_once(&cpu_once, cpu_init);
+    return cpu_specialised;
+}
+
+/**
+ * Liga ou desliga as versões especializadas. Como vc_cpu_select(), só antes de haver outras threads
+ * @param enable
+ * @return valor anterior
+ */
+int vc_cpu_set_specialised(int enable) {
+    int previous = vc_cpu_specialised();
+    cpu_specialised = (enable != 0);
+    return previous;
+}
+
+/**
+ * Tabela de kernels do nivel em uso
+ * @return
+ */
+const VC_KERNELS *vc_kernels(void) {
+    pthread_once(&cpu_once, cpu_init);
+    return cpu_kernels;
+}
@@ -0,0 +1,94 @@
+/**
+ * Este ficheiro contem as assinaturas da escolha dos kernels vectoriais em runtime
+ * @brief Detecção do nivel SIMD do processador (SSE2, AVX2, AVX-512) e tabela de kernels por linha
+ * @file cpu.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * O nivel é detectado uma vez (cpuid) na primeira utilização. A variável de ambiente
+ * VC_CPU=scalar|sse2|avx2|avx512 força um nivel mais baixo (testes e benchmarks);
+ * um nivel que o processador não suporta é reduzido ao detectado.
+ * VC_GENERIC=1 desliga as versões especializadas (canais e kernel fixos) para as comparar com as genéricas.
+ * Todos os niveis dão exactamente o mesmo resultado que a versão escalar.
+ */
+
+#ifndef VC_TP1_13871_14383_17442_CPU_H
+#define VC_TP1_13871_14383_17442_CPU_H
+
+#include <stdint.h>
+
+// Templates: uma função VC_TEMPLATE é sempre expandida no sitio onde é chamada, por isso uma
+// chamada com argumentos constantes (canais, tamanho do kernel) dá um ciclo desenrolado e sem ramos
+#define VC_TEMPLATE __attribute__((always_inline))
+
+typedef enum {
+    VC_CPU_SCALAR,
+    VC_CPU_SSE2,
+    VC_CPU_AVX2,
+    VC_CPU_AVX512,          // AVX-512F + AVX-512BW
+    VC_CPU_NLEVELS
+} VC_CPU_LEVEL;
+
+/**
+ * Kernels de uma linha. Cada nivel preenche as entradas em que ganha alguma coisa,
+ * as restantes apontam para o nivel anterior
+ */
+typedef struct {
+    // Cinzento = R * 0.299 + G * 0.587 + B * 0.114 (em double, truncado)
+    void (*gray)(const unsigned char *src, unsigned char *dst, int width);
+    // 255 se src > threshold, 0 caso contrário
+    void (*binary)(const unsigned char *src, unsigned char *dst, int width, int threshold);
+    // Pinta de color os pixeis com desvio padrão >= threshold. Lê o byte a seguir ao ultimo pixel
+    void (*color_remove)(unsigned char *data, int width, int threshold, int color);
+    // Passagem vertical da morfologia: dilatação 255 se alguma linha tem 255, erosão 0 se alguma tem 0
+    void (*morph_rows)(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode);
+    // Passagem horizontal sobre uma linha 0/255 com offset pixeis de margem de cada lado (max ou min)
+    void (*morph_cols)(const unsigned char *src, unsigned char *dst, int width, int offset, int erode);
+    // As mesmas duas passagens especializadas para o quadrado 3x3 (3 linhas, offset 1)
+    void (*morph_rows3)(const unsigned char **rows, unsigned char *dst, int width, int erode);
+    void (*morph_cols3)(const unsigned char *src, unsigned char *dst, int width, int erode);
+    // 16 amostras de uma linha (row[xs[i]]) num bit cada, 1 se != 0
+    uint16_t (*pack16)(const unsigned char *row, const int *xs);
+
+    // Layout planar (planar.h): separação e junção dos canais de uma linha
+    void (*deinterleave)(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b, int width);
+    void (*interleave)(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width);
+    // Os mesmos kernels de cor sobre os planos. Como na versão intercalada o azul da remoção de cor
+    // é o vermelho do pixel seguinte (r[x + 1], lê r[width]) e o clareamento usa o vermelho já clareado
+    void (*gray_planar)(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width);
+    void (*color_remove_planar)(unsigned char *r, unsigned char *g, unsigned char *b, int width, int threshold, int color);
+    void (*brigten_planar)(unsigned char *r, unsigned char *g, unsigned char *b, int width, int value);
+
+    // Mediana de uma linha de cinzentos com raio radius a partir dos histogramas das colunas
+    // (coarse: 16 contadores por coluna, fine: 256). Colunas fora da linha repetem a primeira e a ultima
+    void (*median_row)(const uint16_t *coarse, const uint16_t *fine, unsigned char *dst, int width, int radius);
+    // Passagem vertical da média: sum += add - sub em cada byte e dst = (sum + divisor / 2) / divisor (divisor 1 a 255)
+    void (*box_rows)(uint16_t *sum, const unsigned char *add, const unsigned char *sub, unsigned char *dst, int n, int divisor);
+    // Gradiente horizontal de Sobel de uma linha (r0, r1, r2 são as linhas de cima, actual e de baixo):
+    // |(r0 + 2 * r1 + r2)[x + 1] - (r0 + 2 * r1 + r2)[x - 1]| limitado a 255, margens repetidas
+    void (*sobel_x)(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst, int width);
+    // Amostragem bilinear de n pixeis RGB: o pixel i vem de (x + i * dx, y + i * dy) em virgula fixa 16.16,
+    // com as coordenadas limitadas à imagem (width e height >= 2) e pesos de 8 bits arredondados em cada eixo
+    void (*warp_row)(const unsigned char *src, int bytesperline, int width, int height, unsigned char *dst, int n,
+                     int32_t x, int32_t y, int32_t dx, int32_t dy);
+    // Redução 2x: os width pixeis de dst são a média arredondada dos blocos 2x2 das linhas row0 e row1 (1 ou 3 canais)
+    void (*downscale2)(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int width, int channels);
+} VC_KERNELS;
+
+VC_CPU_LEVEL vc_cpu_detected(void);
+VC_CPU_LEVEL vc_cpu_level(void);
+VC_CPU_LEVEL vc_cpu_select(VC_CPU_LEVEL level);
+const char *vc_cpu_name(VC_CPU_LEVEL level);
+int vc_cpu_specialised(void);
+int vc_cpu_set_specialised(int enable);
+const VC_KERNELS *vc_kernels(void);
+
+// Tabelas de cada nivel (kernels.c). As dos niveis que o compilador não suporta são a escalar
+extern const VC_KERNELS vc_kernels_scalar;
+extern const VC_KERNELS vc_kernels_sse2;
+extern const VC_KERNELS vc_kernels_avx2;
+extern const VC_KERNELS vc_kernels_avx512;
+
+#endif //VC_TP1_13871_14383_17442_CPU_H
@@ -0,0 +1,102 @@
+/**
+ * Este ficheiro contem o filtro de frames repetidas
+ * @brief Assinatura de luminância por blocos para saltar frames sem alterações
+ * @file gate.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memcpy()
+#include <stdlib.h> // abs()
+#include "gate.h"
+
+/**
+ * Calcula a luminância média de cada bloco de uma grelha VC_GATE_GRID x VC_GATE_GRID,
+ * amostrando um pixel em cada VC_GATE_STEP nas duas direcções (1/16 dos pixeis).
+ * A luminância é aproximada em inteiros, (77 R + 150 G + 29 B) / 256
+ * @param src imagem RGB ou cinzentos
+ * @param sig VC_GATE_GRID * VC_GATE_GRID valores
+ * @return 1 se calculou a assinatura
+ */
+int vc_gate_signature(IVC *src, unsigned char *sig) {
+    if ((src == NULL) || (src->data == NULL) || (src->width < VC_GATE_GRID) || (src->height < VC_GATE_GRID)) return 0;
+    if ((src->channels != 1) && (src->channels != 3)) return 0;
+
+    for (int cy = 0; cy < VC_GATE_GRID; cy++) {
+        int y0 = cy * src->height / VC_GATE_GRID;
+        int y1 = (cy + 1) * src->height / VC_GATE_GRID;
+
+        for (int cx = 0; cx < VC_GATE_GRID; cx++) {
+            int x0 = cx * src->width / VC_GATE_GRID;
+            int x1 = (cx + 1) * src->width / VC_GATE_GRID;
+            unsigned int sum = 0, count = 0;
+
+            for (int y = y0; y < y1; y += VC_GATE_STEP) {
+                const unsigned char *row = src->data + (long)y * src->bytesperline;
+
+                if (src->channels == 3) {
+                    for (int x = x0; x < x1; x += VC_GATE_STEP) {
+                        const unsigned char *p = row + x * 3;
+                        sum += (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+                    }
+                } else {
+                    for (int x = x0; x < x1; x += VC_GATE_STEP) sum += row[x];
+                }
+                count += (x1 - x0 + VC_GATE_STEP - 1) / VC_GATE_STEP;
+            }
+            sig[cy * VC_GATE_GRID + cx] = (unsigned char)(count > 0 ? sum / count : 0);
+        }
+    }
+    return 1;
+}
+
+/**
+ * Compara a frame com a ultima frame processada. Se nenhum bloco mudou mais do que
+ * gate->threshold a frame pode ser saltada; caso contrário a assinatura passa a ser a desta frame.
+ * A comparação é sempre com a ultima frame processada, por isso uma mudança lenta acaba por ser detectada
+ * @param gate
+ * @param src
+ * @return 1 se a frame é igual à anterior (saltar), 0 se tem de ser processada
+ */
+int vc_gate_check(VC_GATE *gate, IVC *src) {
+    unsigned char sig[VC_GATE_GRID * VC_GATE_GRID];
+    int changed = 0;
+
+    if (gate->threshold <= 0) return 0;
+    gate->frames++;
+
+    if (!vc_gate_signature(src, sig)) {
+        gate->valid = 0;
+        return 0;
+    }
+
+    if (gate->valid && gate->width == src->width && gate->height == src->height && gate->channels == src->channels) {
+        for (int i = 0; i < VC_GATE_GRID * VC_GATE_GRID; i++) {
+            if (abs(sig[i] - gate->sig[i]) > gate->threshold) {
+                changed = 1;
+                break;
+            }
+        }
+        if (!changed) {
+            gate->skipped++;
+            return 1;
+        }
+    }
+
+    memcpy(gate->sig, sig, sizeof(sig));
+    gate->width = src->width;
+    gate->height = src->height;
+    gate->channels = src->channels;
+    gate->valid = 1;
+    return 0;
+}
+
+/**
+ * Esquece a ultima frame (a seguinte é sempre processada). Os contadores mantêm-se
+ * @param gate
+ */
+void vc_gate_reset(VC_GATE *gate) {
+    gate->valid = 0;
+}
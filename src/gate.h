@@ -0,0 +1,38 @@
+/**
+ * Este ficheiro contem as assinaturas do filtro de frames repetidas
+ * @brief Assinatura de luminância por blocos para saltar frames sem alterações
+ * @file gate.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_GATE_H
+#define VC_TP1_13871_14383_17442_GATE_H
+
+#include "vc.h"
+
+// Grelha da assinatura (blocos por lado) e passo da amostragem em pixeis
+#define VC_GATE_GRID 16
+#define VC_GATE_STEP 4
+
+/**
+ * Estado do filtro: assinatura da ultima frame processada e contadores
+ */
+typedef struct {
+    int threshold;          // Diferença máxima de um bloco (niveis de cinzento) para saltar a frame (0 desliga)
+
+    int valid;              // 1 se sig descreve uma frame processada
+    int width, height, channels;
+    unsigned char sig[VC_GATE_GRID * VC_GATE_GRID];
+
+    long int frames;        // Frames vistas pelo filtro
+    long int skipped;       // Frames saltadas
+} VC_GATE;
+
+int vc_gate_signature(IVC *src, unsigned char *sig);
+int vc_gate_check(VC_GATE *gate, IVC *src);
+void vc_gate_reset(VC_GATE *gate);
+
+#endif //VC_TP1_13871_14383_17442_GATE_H
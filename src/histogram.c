@@ -0,0 +1,256 @@
+/**
+ * Este ficheiro contem as funções de histograma e thresholds automáticos
+ * @brief Histogramas de 256 niveis com sub-histogramas e thresholds Otsu / percentil
+ * @file histogram.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memset()
+#include <pthread.h>
+#include "histogram.h"
+#include "cpu.h"
+
+// Numero de sub-histogramas. Pixeis consecutivos com o mesmo valor vão para
+// tabelas diferentes e o incremento não fica à espera do store anterior
+#define VC_SUBHISTOGRAMS 4
+
+/**
+ * Limpa um histograma
+ * @param h
+ */
+void vc_histogram_clear(VC_HISTOGRAM *h) {
+    memset(h, 0, sizeof(VC_HISTOGRAM));
+}
+
+/**
+ * Soma o histograma src ao histograma dst
+ * @param dst
+ * @param src
+ */
+void vc_histogram_merge(VC_HISTOGRAM *dst, const VC_HISTOGRAM *src) {
+    for (int i = 0; i < 256; i++) dst->bins[i] += src->bins[i];
+    dst->total += src->total;
+}
+
+/**
+ * Junta os sub-histogramas ao histograma final
+ */
+static void histogram_reduce(VC_HISTOGRAM *h, unsigned int sub[VC_SUBHISTOGRAMS][256], long int total) {
+    for (int i = 0; i < 256; i++) {
+        h->bins[i] += sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i];
+    }
+    h->total += total;
+}
+
+/**
+ * Acumula no histograma os pixeis de uma região (tile) de uma imagem de 1 canal
+ * @param src
+ * @param x
+ * @param y
+ * @param width
+ * @param height
+ * @param h histograma onde os valores são somados
+ * @return 0 se a região for invalida
+ */
+int vc_histogram_tile(IVC *src, int x, int y, int width, int height, VC_HISTOGRAM *h) {
+    unsigned int sub[VC_SUBHISTOGRAMS][256];
+    int xx, yy;
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if (src->channels != 1) return 0;
+    if ((x < 0) || (y < 0) || (x + width > src->width) || (y + height > src->height)) return 0;
+
+    memset(sub, 0, sizeof(sub));
+
+    for (yy = y; yy < y + height; yy++) {
+        unsigned char *row = src->data + yy * src->bytesperline + x;
+
+        for (xx = 0; xx + VC_SUBHISTOGRAMS <= width; xx += VC_SUBHISTOGRAMS) {
+            sub[0][row[xx]]++;
+            sub[1][row[xx + 1]]++;
+            sub[2][row[xx + 2]]++;
+            sub[3][row[xx + 3]]++;
+        }
+        for (; xx < width; xx++) sub[0][row[xx]]++;
+    }
+
+    histogram_reduce(h, sub, (long int)width * height);
+    return 1;
+}
+
+/**
+ * Calcula o histograma de uma imagem de 1 canal
+ * @param src
+ * @param h
+ * @return
+ */
+int vc_histogram(IVC *src, VC_HISTOGRAM *h) {
+    vc_histogram_clear(h);
+    return vc_histogram_tile(src, 0, 0, src->width, src->height, h);
+}
+
+
+typedef struct {
+    IVC *src;
+    int y, height;
+    VC_HISTOGRAM h;
+} HISTOGRAM_TASK;
+
+static void *histogram_worker(void *arg) {
+    HISTOGRAM_TASK *task = (HISTOGRAM_TASK *)arg;
+    vc_histogram_tile(task->src, 0, task->y, task->src->width, task->height, &task->h);
+    return NULL;
+}
+
+/**
+ * Calcula o histograma dividindo a imagem em faixas horizontais, uma por thread
+ * @param src
+ * @param h
+ * @param nthreads
+ * @return
+ */
+int vc_histogram_parallel(IVC *src, VC_HISTOGRAM *h, int nthreads) {
+    HISTOGRAM_TASK tasks[16];
+    pthread_t threads[16];
+    int started[16];
+
+    if (nthreads > 16) nthreads = 16;
+    if (nthreads > src->height) nthreads = src->height;
+    if (nthreads <= 1) return vc_histogram(src, h);
+
+    vc_histogram_clear(h);
+
+    int band = src->height / nthreads;
+    for (int t = 0; t < nthreads; t++) {
+        tasks[t].src = src;
+        tasks[t].y = t * band;
+        tasks[t].height = (t == nthreads - 1) ? src->height - t * band : band;
+        vc_histogram_clear(&tasks[t].h);
+        started[t] = (pthread_create(&threads[t], NULL, histogram_worker, &tasks[t]) == 0);
+        // Sem thread disponivel faz a faixa na thread actual
+        if (!started[t]) histogram_worker(&tasks[t]);
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) pthread_join(threads[t], NULL);
+        vc_histogram_merge(h, &tasks[t].h);
+    }
+    return h->total == (long int)src->width * src->height;
+}
+
+/**
+ * Converte de RGB para cinzentos e calcula o histograma da imagem resultante
+ * na mesma passagem. O resultado é identico a vc_rgb_to_gray()
+ * @param src
+ * @param dst
+ * @param h
+ * @return
+ */
+int vc_rgb_to_gray_histogram(IVC *src, IVC *dst, VC_HISTOGRAM *h) {
+    unsigned int sub[VC_SUBHISTOGRAMS][256];
+    unsigned char *datasrc = (unsigned char *)src->data;
+    unsigned char *datadst = (unsigned char *)dst->data;
+    int width = src->width;
+    int height = src->height;
+    int x, y;
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+    if ((src->channels != 3) || (dst->channels != 1)) return 0;
+
+    memset(sub, 0, sizeof(sub));
+
+    for (y = 0; y < height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        unsigned char *rowsrc = datasrc + y * src->bytesperline;
+        unsigned char *rowdst = datadst + y * dst->bytesperline;
+
+        // Conversão da linha com o kernel de cpu.h; a contagem lê a linha ainda em cache
+        kernels->gray(rowsrc, rowdst, width);
+        for (x = 0; x < width; x++) {
+            sub[x & (VC_SUBHISTOGRAMS - 1)][rowdst[x]]++;
+        }
+    }
+
+    vc_histogram_clear(h);
+    histogram_reduce(h, sub, (long int)width * height);
+    return 1;
+}
+
+/**
+ * Actualiza o histograma como se a imagem tivesse sido clareada com vc_brigten(value)
+ * (soma saturada a 255), evitando percorrer a imagem outra vez
+ * @param h
+ * @param value
+ */
+void vc_histogram_add(VC_HISTOGRAM *h, int value) {
+    unsigned int bins[256] = { 0 };
+
+    for (int i = 0; i < 256; i++) {
+        int v = i + value;
+        if (v > 255) v = 255;
+        if (v < 0) v = 0;
+        bins[v] += h->bins[i];
+    }
+    memcpy(h->bins, bins, sizeof(bins));
+}
+
+/**
+ * Threshold de Otsu: maximiza a variância entre as duas classes
+ * Os pixeis com valor > threshold são a classe de primeiro plano, como em vc_gray_to_binary()
+ * @param h
+ * @return threshold [0,255]
+ */
+int vc_histogram_otsu(const VC_HISTOGRAM *h) {
+    double sum = 0, sumb = 0, best = -1;
+    long int wb = 0;
+    int threshold = 0;
+
+    if (h->total <= 0) return 0;
+
+    for (int i = 0; i < 256; i++) sum += (double)i * h->bins[i];
+
+    for (int t = 0; t < 256; t++) {
+        wb += h->bins[t];
+        if (wb == 0) continue;
+
+        long int wf = h->total - wb;
+        if (wf == 0) break;
+
+        sumb += (double)t * h->bins[t];
+
+        double mb = sumb / wb;
+        double mf = (sum - sumb) / wf;
+        double between = (double)wb * wf * (mb - mf) * (mb - mf);
+
+        if (between > best) {
+            best = between;
+            threshold = t;
+        }
+    }
+    return threshold;
+}
+
+/**
+ * Threshold por percentil: menor valor t tal que pelo menos percentile% dos pixeis são <= t
+ * @param h
+ * @param percentile [0,100]
+ * @return threshold [0,255]
+ */
+int vc_histogram_percentile(const VC_HISTOGRAM *h, float percentile) {
+    long int acc = 0;
+    double target = h->total * (percentile / 100.0);
+
+    for (int t = 0; t < 256; t++) {
+        acc += h->bins[t];
+        if (acc >= target) return t;
+    }
+    return 255;
+}
@@ -0,0 +1,39 @@
+/**
+ * Este ficheiro contem as assinaturas das funções de histograma e thresholds automáticos
+ * @brief Histogramas de 256 niveis e calculo de thresholds (Otsu / percentil)
+ * @file histogram.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_HISTOGRAM_H
+#define VC_TP1_13871_14383_17442_HISTOGRAM_H
+
+#include "vc.h"
+
+// Modos de calculo do threshold da binarização
+#define VC_THRESHOLD_FIXED 0
+#define VC_THRESHOLD_OTSU 1
+#define VC_THRESHOLD_PERCENTILE 2
+
+/**
+ * Histograma de uma imagem de 1 canal
+ */
+typedef struct {
+    unsigned int bins[256];
+    long int total;
+} VC_HISTOGRAM;
+
+void vc_histogram_clear(VC_HISTOGRAM *h);
+void vc_histogram_merge(VC_HISTOGRAM *dst, const VC_HISTOGRAM *src);
+int vc_histogram_tile(IVC *src, int x, int y, int width, int height, VC_HISTOGRAM *h);
+int vc_histogram(IVC *src, VC_HISTOGRAM *h);
+int vc_histogram_parallel(IVC *src, VC_HISTOGRAM *h, int nthreads);
+int vc_rgb_to_gray_histogram(IVC *src, IVC *dst, VC_HISTOGRAM *h);
+void vc_histogram_add(VC_HISTOGRAM *h, int value);
+int vc_histogram_otsu(const VC_HISTOGRAM *h);
+int vc_histogram_percentile(const VC_HISTOGRAM *h, float percentile);
+
+#endif //VC_TP1_13871_14383_17442_HISTOGRAM_H
@@ -0,0 +1,1350 @@
+/**
+ * Este ficheiro contem os kernels por linha em versão escalar, SSE2, AVX2 e AVX-512
+ * @brief Cinzentos, binarização, remoção de cor, morfologia, mediana, média, Sobel, amostragem bilinear e empacotamento de bits, um conjunto por nivel SIMD
+ * @file kernels.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Cada versão vectorial é compilada com __attribute__((target(...))), por isso o binário
+ * continua a correr em qualquer x86-64; cpu.c só escolhe uma tabela que o processador suporta.
+ * A versão escalar é a referência: as outras têm de dar exactamente os mesmos bytes (bin/bench -D)
+ */
+
+#include <string.h> // memset()
+#include "cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VC_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Limite do desvio padrão: com threshold acima disto nenhum pixel RGB é pintado
+#define COLOR_MAX_THRESHOLD 255
+
+/**
+ * Instâncias da morfologia de um nivel: as genéricas (offset, numero de linhas e operação em runtime)
+ * e as especializadas para o quadrado 3x3 de processImage / processPlate (kernel 2 e 3),
+ * uma por operação
+ */
+#define VC_MORPH_SPECIALISE(isa, target) \
+    target static void morph_rows_##isa(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode) { \
+        morph_rows_##isa##_t(rows, nrows, dst, width, erode); \
+    } \
+    target static void morph_cols_##isa(const unsigned char *src, unsigned char *dst, int width, int offset, int erode) { \
+        morph_cols_##isa##_t(src, dst, width, offset, erode); \
+    } \
+    target static void morph_rows3_##isa(const unsigned char **rows, unsigned char *dst, int width, int erode) { \
+        if (erode) morph_rows_##isa##_t(rows, 3, dst, width, 1); \
+        else morph_rows_##isa##_t(rows, 3, dst, width, 0); \
+    } \
+    target static void morph_cols3_##isa(const unsigned char *src, unsigned char *dst, int width, int erode) { \
+        if (erode) morph_cols_##isa##_t(src, dst, width, 1, 1); \
+        else morph_cols_##isa##_t(src, dst, width, 1, 0); \
+    }
+
+/**
+ * Divisão de um x de 16 bits por uma constante d com uma multiplicação (Granlund e Montgomery):
+ * t = (x * m) >> 16, x / d = (t + ((x - t) >> sh1)) >> sh2. Exacta para todos os x < 65536
+ */
+typedef struct {
+    uint16_t m;
+    int sh1, sh2;
+} DIV16;
+
+static inline DIV16 div16(int d) {
+    DIV16 div;
+    int l = 0;
+
+    while ((1 << l) < d) l++;
+    div.m = (uint16_t)(((uint32_t)65536 * ((1u << l) - d)) / d + 1);
+    div.sh1 = (l < 1) ? l : 1;
+    div.sh2 = (l > 1) ? l - 1 : 0;
+    return div;
+}
+
+// Coluna j limitada à linha (as margens repetem o primeiro e o ultimo pixel)
+#define MEDIAN_CLAMP(j, width) ((j) < 0 ? 0 : ((j) >= (width) ? (width) - 1 : (j)))
+
+/**
+ * Mediana de uma linha a partir dos histogramas das colunas (Perreault): o histograma grosso
+ * (16 classes de 16 niveis) desliza uma coluna por pixel e só a classe que contém a mediana
+ * actualiza o histograma fino, a partir da coluna onde ficou da ultima vez.
+ * O custo por pixel não depende do raio. As somas de 16 contadores são os kernels hist16 de cada nivel
+ */
+#define VC_MEDIAN_ROW(isa, target) \
+    target static void median_row_##isa(const uint16_t *coarse, const uint16_t *fine, unsigned char *dst, int width, int radius) { \
+        uint16_t hc[16], hf[16][16]; \
+        int luc[16]; \
+        int half = ((2 * radius + 1) * (2 * radius + 1)) / 2; \
+        memset(hc, 0, sizeof(hc)); \
+        for (int j = -radius; j <= radius; j++) hist16_add_##isa(hc, coarse + 16 * MEDIAN_CLAMP(j, width)); \
+        for (int k = 0; k < 16; k++) luc[k] = -radius - 1; \
+        for (int x = 0; x < width; x++) { \
+            int sum = 0, k = 0, i = 0; \
+            if (x > 0) hist16_addsub_##isa(hc, coarse + 16 * MEDIAN_CLAMP(x + radius, width), coarse + 16 * MEDIAN_CLAMP(x - radius - 1, width)); \
+            while (sum + hc[k] <= half) sum += hc[k++]; \
+            uint16_t *h = hf[k]; \
+            if (luc[k] <= x - radius) { \
+                memset(h, 0, 16 * sizeof(uint16_t)); \
+                for (int j = x - radius; j <= x + radius; j++) hist16_add_##isa(h, fine + 256 * MEDIAN_CLAMP(j, width) + 16 * k); \
+            } else { \
+                for (int j = luc[k]; j <= x + radius; j++) { \
+                    hist16_addsub_##isa(h, fine + 256 * MEDIAN_CLAMP(j, width) + 16 * k, \
+                                        fine + 256 * MEDIAN_CLAMP(j - 2 * radius - 1, width) + 16 * k); \
+                } \
+            } \
+            luc[k] = x + radius + 1; \
+            while (sum + h[i] <= half) sum += h[i++]; \
+            dst[x] = (unsigned char)(16 * k + i); \
+        } \
+    }
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                       VERSÃO ESCALAR
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+static void gray_scalar(const unsigned char *src, unsigned char *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        float rf = (float)src[3 * x];
+        float gf = (float)src[3 * x + 1];
+        float bf = (float)src[3 * x + 2];
+
+        dst[x] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
+    }
+}
+
+static void binary_scalar(const unsigned char *src, unsigned char *dst, int width, int threshold) {
+    for (int x = 0; x < width; x++) dst[x] = (src[x] > threshold) ? 255 : 0;
+}
+
+/**
+ * Remoção de cor em inteiros. calcula_desvio() faz sqrt(SD / 3) em float, mas SD é sempre
+ * um inteiro (as diferenças para a média truncada são inteiras), logo
+ * (int)sqrt(SD / 3) >= t  <=>  SD >= 3 t^2  para 1 <= t <= 255, e é sempre verdade para t <= 0.
+ * Como em vc_color_remove() o azul é lido em p[3] (o vermelho do pixel seguinte)
+ */
+static void color_remove_scalar(unsigned char *data, int width, int threshold, int color) {
+    int limit;
+
+    if (threshold > COLOR_MAX_THRESHOLD) return;
+    limit = 3 * threshold * threshold;
+
+    for (int x = 0; x < width; x++) {
+        unsigned char *p = data + 3 * x;
+        int r = p[0], g = p[1], b = p[3];
+        int media = (r + g + b) / 3;
+        int sd = (r - media) * (r - media) + (g - media) * (g - media) + (b - media) * (b - media);
+
+        if (threshold <= 0 || sd >= limit) {
+            p[0] = color;
+            p[1] = color;
+            p[2] = color;
+        }
+    }
+}
+
+VC_TEMPLATE
+static inline void morph_rows_scalar_t(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode) {
+    int hit = erode ? 0 : 255;
+
+    for (int x = 0; x < width; x++) {
+        int found = 0;
+        for (int k = 0; k < nrows; k++) found |= (rows[k][x] == hit);
+        dst[x] = (found ^ erode) ? 255 : 0;
+    }
+}
+
+VC_TEMPLATE
+static inline void morph_cols_scalar_t(const unsigned char *src, unsigned char *dst, int width, int offset, int erode) {
+    for (int x = 0; x < width; x++) {
+        unsigned char v = src[x - offset];
+        for (int k = -offset + 1; k <= offset; k++) {
+            if (erode) v = (src[x + k] < v) ? src[x + k] : v;
+            else v = (src[x + k] > v) ? src[x + k] : v;
+        }
+        dst[x] = v;
+    }
+}
+
+VC_MORPH_SPECIALISE(scalar, )
+
+
+static uint16_t pack16_scalar(const unsigned char *row, const int *xs) {
+    uint16_t line = 0;
+
+    for (int i = 0; i < 16; i++) line |= (uint16_t)((row[xs[i]] != 0) << i);
+    return line;
+}
+
+// Os contadores são somados em aritmética modular de 16 bits: o resultado final nunca passa de 65025
+static inline void hist16_add_scalar(uint16_t *h, const uint16_t *a) {
+    for (int i = 0; i < 16; i++) h[i] += a[i];
+}
+
+static inline void hist16_addsub_scalar(uint16_t *h, const uint16_t *a, const uint16_t *s) {
+    for (int i = 0; i < 16; i++) h[i] += a[i] - s[i];
+}
+
+VC_MEDIAN_ROW(scalar, )
+
+// Colunas from a to - 1 do gradiente, com as margens repetidas
+static inline void sobel_x_cols(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst,
+                                int width, int from, int to) {
+    for (int x = from; x < to; x++) {
+        int l = (x > 0) ? x - 1 : 0, r = (x < width - 1) ? x + 1 : width - 1;
+        int gx = (r0[r] + 2 * r1[r] + r2[r]) - (r0[l] + 2 * r1[l] + r2[l]);
+
+        if (gx < 0) gx = -gx;
+        dst[x] = (unsigned char)(gx > 255 ? 255 : gx);
+    }
+}
+
+static void sobel_x_scalar(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst, int width) {
+    sobel_x_cols(r0, r1, r2, dst, width, 0, width);
+}
+
+/**
+ * Coordenada 16.16 limitada a [0, max]: max = ((tamanho - 1) << 16) - 1, para o vizinho seguinte
+ * (x0 + 1, y0 + 1) existir sempre
+ */
+#define WARP_CLAMP(v, max) ((v) < 0 ? 0 : ((v) > (max) ? (max) : (v)))
+
+// Interpolação de um canal com pesos de 8 bits: primeiro as duas linhas, depois entre elas
+#define WARP_LERP(a, b, w) (((a) * (256 - (w)) + (b) * (w) + 128) >> 8)
+
+static inline void warp_pixel(const unsigned char *src, int bytesperline, int32_t xmax, int32_t ymax, unsigned char *dst,
+                              int32_t x, int32_t y) {
+    x = WARP_CLAMP(x, xmax);
+    y = WARP_CLAMP(y, ymax);
+
+    int wx = (x >> 8) & 0xFF, wy = (y >> 8) & 0xFF;
+    const unsigned char *p = src + (y >> 16) * bytesperline + 3 * (x >> 16), *q = p + bytesperline;
+
+    for (int c = 0; c < 3; c++) {
+        int top = WARP_LERP(p[c], p[c + 3], wx);
+        int bottom = WARP_LERP(q[c], q[c + 3], wx);
+        dst[c] = (unsigned char)WARP_LERP(top, bottom, wy);
+    }
+}
+
+// Pixeis from a n - 1
+static inline void warp_pixels(const unsigned char *src, int bytesperline, int width, int height, unsigned char *dst,
+                               int from, int n, int32_t x, int32_t y, int32_t dx, int32_t dy) {
+    int32_t xmax = ((width - 1) << 16) - 1, ymax = ((height - 1) << 16) - 1;
+
+    for (int i = from; i < n; i++) warp_pixel(src, bytesperline, xmax, ymax, dst + 3 * i, x + i * dx, y + i * dy);
+}
+
+static void warp_row_scalar(const unsigned char *src, int bytesperline, int width, int height, unsigned char *dst, int n,
+                            int32_t x, int32_t y, int32_t dx, int32_t dy) {
+    warp_pixels(src, bytesperline, width, height, dst, 0, n, x, y, dx, dy);
+}
+
+static void downscale2_scalar(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int width, int channels) {
+    for (int x = 0; x < width; x++) {
+        int pos = 2 * x * channels;
+
+        for (int c = 0; c < channels; c++) {
+            dst[x * channels + c] = (unsigned char)((row0[pos + c] + row0[pos + channels + c] +
+                                                     row1[pos + c] + row1[pos + channels + c] + 2) >> 2);
+        }
+    }
+}
+
+static void box_rows_scalar(uint16_t *sum, const unsigned char *add, const unsigned char *sub, unsigned char *dst, int n, int divisor) {
+    for (int i = 0; i < n; i++) {
+        sum[i] += add[i] - sub[i];
+        dst[i] = (unsigned char)((sum[i] + divisor / 2) / divisor);
+    }
+}
+
+static void deinterleave_scalar(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    for (int x = 0; x < width; x++) {
+        r[x] = src[3 * x];
+        g[x] = src[3 * x + 1];
+        b[x] = src[3 * x + 2];
+    }
+}
+
+static void interleave_scalar(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[3 * x] = r[x];
+        dst[3 * x + 1] = g[x];
+        dst[3 * x + 2] = b[x];
+    }
+}
+
+static void gray_planar_scalar(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        float rf = (float)r[x];
+        float gf = (float)g[x];
+        float bf = (float)b[x];
+
+        dst[x] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
+    }
+}
+
+static void color_remove_planar_scalar(unsigned char *r, unsigned char *g, unsigned char *b, int width, int threshold, int color) {
+    int limit;
+
+    if (threshold > COLOR_MAX_THRESHOLD) return;
+    limit = 3 * threshold * threshold;
+
+    for (int x = 0; x < width; x++) {
+        int rv = r[x], gv = g[x], bv = r[x + 1];
+        int media = (rv + gv + bv) / 3;
+        int sd = (rv - media) * (rv - media) + (gv - media) * (gv - media) + (bv - media) * (bv - media);
+
+        if (threshold <= 0 || sd >= limit) {
+            r[x] = color;
+            g[x] = color;
+            b[x] = color;
+        }
+    }
+}
+
+// Igual a vc_brigten() com 3 canais: o verde e o azul saturados ficam a 255, os outros recebem o vermelho já clareado + value
+static void brigten_planar_scalar(unsigned char *r, unsigned char *g, unsigned char *b, int width, int value) {
+    for (int x = 0; x < width; x++) {
+        r[x] = ((r[x] + value) > 255) ? 255 : r[x] + value;
+        g[x] = ((g[x] + value) > 255) ? 255 : r[x] + value;
+        b[x] = ((b[x] + value) > 255) ? 255 : r[x] + value;
+    }
+}
+
+const VC_KERNELS vc_kernels_scalar = {
+        gray_scalar, binary_scalar, color_remove_scalar, morph_rows_scalar, morph_cols_scalar,
+        morph_rows3_scalar, morph_cols3_scalar, pack16_scalar,
+        deinterleave_scalar, interleave_scalar, gray_planar_scalar, color_remove_planar_scalar, brigten_planar_scalar,
+        median_row_scalar, box_rows_scalar, sobel_x_scalar, warp_row_scalar, downscale2_scalar
+};
+
+
+#ifdef VC_KERNELS_X86
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          SSE2
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Soma ponderada em double, pela mesma ordem que a versão escalar
+#define GRAY_PD(mul, add, r, g, b, c0, c1, c2) add(add(mul(r, c0), mul(g, c1)), mul(b, c2))
+
+__attribute__((target("sse2")))
+static void gray_sse2(const unsigned char *src, unsigned char *dst, int width) {
+    const __m128d c0 = _mm_set1_pd(0.299), c1 = _mm_set1_pd(0.587), c2 = _mm_set1_pd(0.114);
+    int x = 0;
+
+    // 4 pixeis por iteração, 2 em cada registo de doubles
+    for (; x + 4 <= width; x += 4) {
+        const unsigned char *p = src + 3 * x;
+        __m128i r = _mm_setr_epi32(p[0], p[3], p[6], p[9]);
+        __m128i g = _mm_setr_epi32(p[1], p[4], p[7], p[10]);
+        __m128i b = _mm_setr_epi32(p[2], p[5], p[8], p[11]);
+
+        __m128d lo = GRAY_PD(_mm_mul_pd, _mm_add_pd, _mm_cvtepi32_pd(r), _mm_cvtepi32_pd(g), _mm_cvtepi32_pd(b), c0, c1, c2);
+        __m128d hi = GRAY_PD(_mm_mul_pd, _mm_add_pd, _mm_cvtepi32_pd(_mm_shuffle_epi32(r, 0xEE)),
+                             _mm_cvtepi32_pd(_mm_shuffle_epi32(g, 0xEE)), _mm_cvtepi32_pd(_mm_shuffle_epi32(b, 0xEE)), c0, c1, c2);
+
+        __m128i v = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+        v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+        int out = _mm_cvtsi128_si32(v);
+        memcpy(dst + x, &out, 4);
+    }
+    gray_scalar(src + 3 * x, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+static void binary_sse2(const unsigned char *src, unsigned char *dst, int width, int threshold) {
+    int x = 0;
+
+    // v > t  <=>  max(v, t + 1) == v, em bytes sem sinal
+    if (threshold >= 0 && threshold < 255) {
+        const __m128i t1 = _mm_set1_epi8((char)(threshold + 1));
+
+        for (; x + 16 <= width; x += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + x));
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_cmpeq_epi8(_mm_max_epu8(v, t1), v));
+        }
+    }
+    binary_scalar(src + x, dst + x, width - x, threshold);
+}
+
+__attribute__((target("sse2"))) VC_TEMPLATE
+static inline void morph_rows_sse2_t(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode) {
+    const __m128i hit = _mm_set1_epi8(erode ? 0 : (char)255);
+    const __m128i flip = _mm_set1_epi8(erode ? (char)255 : 0);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i found = _mm_setzero_si128();
+        for (int k = 0; k < nrows; k++) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(rows[k] + x)), hit));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_xor_si128(found, flip));
+    }
+    if (x < width) {
+        const unsigned char *tail[nrows > 0 ? nrows : 1];
+        for (int k = 0; k < nrows; k++) tail[k] = rows[k] + x;
+        morph_rows_scalar(tail, nrows, dst + x, width - x, erode);
+    }
+}
+
+__attribute__((target("sse2"))) VC_TEMPLATE
+static inline void morph_cols_sse2_t(const unsigned char *src, unsigned char *dst, int width, int offset, int erode) {
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + x - offset));
+        for (int k = -offset + 1; k <= offset; k++) {
+            __m128i n = _mm_loadu_si128((const __m128i *)(src + x + k));
+            v = erode ? _mm_min_epu8(v, n) : _mm_max_epu8(v, n);
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), v);
+    }
+    morph_cols_scalar(src + x, dst + x, width - x, offset, erode);
+}
+
+VC_MORPH_SPECIALISE(sse2, __attribute__((target("sse2"))))
+
+
+__attribute__((target("sse2")))
+static inline void hist16_add_sse2(uint16_t *h, const uint16_t *a) {
+    for (int i = 0; i < 16; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(h + i));
+        _mm_storeu_si128((__m128i *)(h + i), _mm_add_epi16(v, _mm_loadu_si128((const __m128i *)(a + i))));
+    }
+}
+
+__attribute__((target("sse2")))
+static inline void hist16_addsub_sse2(uint16_t *h, const uint16_t *a, const uint16_t *s) {
+    for (int i = 0; i < 16; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i d = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(s + i)));
+        _mm_storeu_si128((__m128i *)(h + i), _mm_add_epi16(v, d));
+    }
+}
+
+VC_MEDIAN_ROW(sse2, __attribute__((target("sse2"))))
+
+__attribute__((target("sse2")))
+static inline __m128i div16_sse2(__m128i x, __m128i m, __m128i sh1, __m128i sh2) {
+    __m128i t = _mm_mulhi_epu16(x, m);
+    return _mm_srl_epi16(_mm_add_epi16(t, _mm_srl_epi16(_mm_sub_epi16(x, t), sh1)), sh2);
+}
+
+// Soma vertical r0 + 2 * r1 + r2 de 8 pixeis em 16 bits
+#define SOBEL_COL_SSE2(lo, a, b, c, zero) \
+    _mm_add_epi16(_mm_add_epi16(lo(a, zero), lo(c, zero)), _mm_slli_epi16(lo(b, zero), 1))
+
+/**
+ * Colunas interiores a partir de x, 16 por iteração (as vizinhas x - 1 e x + 16 existem)
+ * @return primeira coluna que ficou por fazer
+ */
+__attribute__((target("sse2")))
+static inline int sobel_x_from_sse2(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst,
+                                    int width, int x) {
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 16 <= width - 1; x += 16) {
+        __m128i l0 = _mm_loadu_si128((const __m128i *)(r0 + x - 1)), h0 = _mm_loadu_si128((const __m128i *)(r0 + x + 1));
+        __m128i l1 = _mm_loadu_si128((const __m128i *)(r1 + x - 1)), h1 = _mm_loadu_si128((const __m128i *)(r1 + x + 1));
+        __m128i l2 = _mm_loadu_si128((const __m128i *)(r2 + x - 1)), h2 = _mm_loadu_si128((const __m128i *)(r2 + x + 1));
+
+        __m128i lo = _mm_sub_epi16(SOBEL_COL_SSE2(_mm_unpacklo_epi8, h0, h1, h2, zero), SOBEL_COL_SSE2(_mm_unpacklo_epi8, l0, l1, l2, zero));
+        __m128i hi = _mm_sub_epi16(SOBEL_COL_SSE2(_mm_unpackhi_epi8, h0, h1, h2, zero), SOBEL_COL_SSE2(_mm_unpackhi_epi8, l0, l1, l2, zero));
+        lo = _mm_max_epi16(lo, _mm_sub_epi16(zero, lo));
+        hi = _mm_max_epi16(hi, _mm_sub_epi16(zero, hi));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    return x;
+}
+
+// A primeira coluna e o resto da linha são escalares
+__attribute__((target("sse2")))
+static void sobel_x_sse2(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst, int width) {
+    sobel_x_cols(r0, r1, r2, dst, width, 0, width > 0 ? 1 : 0);
+    int x = sobel_x_from_sse2(r0, r1, r2, dst, width, 1);
+    sobel_x_cols(r0, r1, r2, dst, width, x, width);
+}
+
+// 16 colunas por iteração, as somas em dois registos de 8 contadores de 16 bits
+__attribute__((target("sse2")))
+static void box_rows_sse2(uint16_t *sum, const unsigned char *add, const unsigned char *sub, unsigned char *dst, int n, int divisor) {
+    DIV16 div = div16(divisor);
+    const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16((short)(divisor / 2)), m = _mm_set1_epi16((short)div.m);
+    const __m128i sh1 = _mm_cvtsi32_si128(div.sh1), sh2 = _mm_cvtsi32_si128(div.sh2);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(add + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(sub + i));
+        __m128i lo = _mm_loadu_si128((const __m128i *)(sum + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(sum + i + 8));
+
+        lo = _mm_sub_epi16(_mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero)), _mm_unpacklo_epi8(b, zero));
+        hi = _mm_sub_epi16(_mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero)), _mm_unpackhi_epi8(b, zero));
+        _mm_storeu_si128((__m128i *)(sum + i), lo);
+        _mm_storeu_si128((__m128i *)(sum + i + 8), hi);
+
+        lo = div16_sse2(_mm_add_epi16(lo, half), m, sh1, sh2);
+        hi = div16_sse2(_mm_add_epi16(hi, half), m, sh1, sh2);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    box_rows_scalar(sum + i, add + i, sub + i, dst + i, n - i, divisor);
+}
+
+// Cinzentos: 32 pixeis de entrada -> 16 de saida por iteração, as somas dos pares horizontais
+// em 16 bits ((v & 0xFF) + (v >> 8)). Sem pshufb o RGB fica escalar
+__attribute__((target("sse2")))
+static void downscale2_sse2(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int width, int channels) {
+    const __m128i mask = _mm_set1_epi16(0x00FF), two = _mm_set1_epi16(2);
+    int x = 0;
+
+    if (channels != 1) {
+        downscale2_scalar(row0, row1, dst, width, channels);
+        return;
+    }
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + 2 * x));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + 2 * x + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + 2 * x + 16));
+        __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b0, mask), _mm_srli_epi16(b0, 8)));
+        __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b1, mask), _mm_srli_epi16(b1, 8)));
+
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(s0, s1));
+    }
+    downscale2_scalar(row0 + 2 * x, row1 + 2 * x, dst + x, width - x, 1);
+}
+
+/**
+ * Interpolação bilinear de 4 pixeis, um por cada lane de 32 bits (RGB nos 3 bytes de baixo).
+ * Os valores e os pesos (até 256) cabem nos 16 bits de baixo, o mullo_epi16 dá o produto exacto
+ */
+__attribute__((target("sse2")))
+static inline __m128i warp_blend_sse2(__m128i p00, __m128i p01, __m128i p10, __m128i p11, __m128i wx, __m128i wy) {
+    const __m128i byte = _mm_set1_epi32(0xFF), w256 = _mm_set1_epi32(256), round = _mm_set1_epi32(128);
+    __m128i ix = _mm_sub_epi32(w256, wx), iy = _mm_sub_epi32(w256, wy);
+    __m128i out = _mm_setzero_si128();
+
+    for (int c = 0; c < 3; c++) {
+        __m128i a = _mm_and_si128(_mm_srli_epi32(p00, 8 * c), byte), b = _mm_and_si128(_mm_srli_epi32(p01, 8 * c), byte);
+        __m128i d = _mm_and_si128(_mm_srli_epi32(p10, 8 * c), byte), e = _mm_and_si128(_mm_srli_epi32(p11, 8 * c), byte);
+        __m128i top = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(a, ix), _mm_mullo_epi16(b, wx)), round), 8);
+        __m128i bottom = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(d, ix), _mm_mullo_epi16(e, wx)), round), 8);
+        __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(top, iy), _mm_mullo_epi16(bottom, wy)), round), 8);
+        out = _mm_or_si128(out, _mm_slli_epi32(v, 8 * c));
+    }
+    return out;
+}
+
+// Limita 4 coordenadas a [0, max] (o SSE2 não tem max/min de 32 bits)
+__attribute__((target("sse2")))
+static inline __m128i warp_clamp_sse2(__m128i v, __m128i max) {
+    __m128i over = _mm_cmpgt_epi32(v, max);
+    v = _mm_and_si128(v, _mm_cmpgt_epi32(v, _mm_set1_epi32(-1)));
+    return _mm_or_si128(_mm_and_si128(over, max), _mm_andnot_si128(over, v));
+}
+
+// 4 bytes a partir de p (sem alinhamento)
+static inline int32_t load32(const unsigned char *p) {
+    int32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/**
+ * 4 pixeis por iteração: coordenadas, limites e pesos em vector, os 4 vizinhos de cada pixel lidos um a um.
+ * Cada vizinho da esquerda é lido com 4 bytes a partir do pixel (o 4º é do vizinho da direita) e o da
+ * direita com 4 bytes a partir do azul da esquerda, para nunca ler depois do ultimo pixel da imagem
+ */
+__attribute__((target("sse2")))
+static void warp_row_sse2(const unsigned char *src, int bytesperline, int width, int height, unsigned char *dst, int n,
+                          int32_t x, int32_t y, int32_t dx, int32_t dy) {
+    const __m128i xmax = _mm_set1_epi32(((width - 1) << 16) - 1), ymax = _mm_set1_epi32(((height - 1) << 16) - 1);
+    const __m128i byte = _mm_set1_epi32(0xFF), rgb = _mm_set1_epi32(0xFFFFFF);
+    int32_t xs[4], ys[4];
+    uint32_t out[4];
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i vx = _mm_add_epi32(_mm_set1_epi32(x + i * dx), _mm_setr_epi32(0, dx, 2 * dx, 3 * dx));
+        __m128i vy = _mm_add_epi32(_mm_set1_epi32(y + i * dy), _mm_setr_epi32(0, dy, 2 * dy, 3 * dy));
+        const unsigned char *p[4];
+
+        vx = warp_clamp_sse2(vx, xmax);
+        vy = warp_clamp_sse2(vy, ymax);
+        _mm_storeu_si128((__m128i *)xs, _mm_srli_epi32(vx, 16));
+        _mm_storeu_si128((__m128i *)ys, _mm_srli_epi32(vy, 16));
+        for (int k = 0; k < 4; k++) p[k] = src + ys[k] * bytesperline + 3 * xs[k];
+
+        __m128i p00 = _mm_and_si128(_mm_setr_epi32(load32(p[0]), load32(p[1]), load32(p[2]), load32(p[3])), rgb);
+        __m128i p01 = _mm_srli_epi32(_mm_setr_epi32(load32(p[0] + 2), load32(p[1] + 2), load32(p[2] + 2), load32(p[3] + 2)), 8);
+        __m128i p10 = _mm_and_si128(_mm_setr_epi32(load32(p[0] + bytesperline), load32(p[1] + bytesperline),
+                                                   load32(p[2] + bytesperline), load32(p[3] + bytesperline)), rgb);
+        __m128i p11 = _mm_srli_epi32(_mm_setr_epi32(load32(p[0] + bytesperline + 2), load32(p[1] + bytesperline + 2),
+                                                    load32(p[2] + bytesperline + 2), load32(p[3] + bytesperline + 2)), 8);
+        __m128i wx = _mm_and_si128(_mm_srli_epi32(vx, 8), byte), wy = _mm_and_si128(_mm_srli_epi32(vy, 8), byte);
+
+        _mm_storeu_si128((__m128i *)out, warp_blend_sse2(p00, p01, p10, p11, wx, wy));
+        for (int k = 0; k < 4; k++) memcpy(dst + 3 * (i + k), &out[k], 3);
+    }
+    warp_pixels(src, bytesperline, width, height, dst, i, n, x, y, dx, dy);
+}
+
+// Junta as 16 amostras num vector e tira um bit por byte != 0
+__attribute__((target("sse2")))
+static uint16_t pack16_sse2(const unsigned char *row, const int *xs) {
+    __m128i v = _mm_setr_epi8(row[xs[0]], row[xs[1]], row[xs[2]], row[xs[3]],
+                              row[xs[4]], row[xs[5]], row[xs[6]], row[xs[7]],
+                              row[xs[8]], row[xs[9]], row[xs[10]], row[xs[11]],
+                              row[xs[12]], row[xs[13]], row[xs[14]], row[xs[15]]);
+    return (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+
+/**
+ * Cinzento de 4 pixeis a partir dos canais em inteiros de 32 bits (mesma soma em double da versão escalar)
+ */
+__attribute__((target("sse2")))
+static inline __m128i gray4_sse2(__m128i r, __m128i g, __m128i b) {
+    const __m128d c0 = _mm_set1_pd(0.299), c1 = _mm_set1_pd(0.587), c2 = _mm_set1_pd(0.114);
+
+    __m128d lo = GRAY_PD(_mm_mul_pd, _mm_add_pd, _mm_cvtepi32_pd(r), _mm_cvtepi32_pd(g), _mm_cvtepi32_pd(b), c0, c1, c2);
+    __m128d hi = GRAY_PD(_mm_mul_pd, _mm_add_pd, _mm_cvtepi32_pd(_mm_shuffle_epi32(r, 0xEE)),
+                         _mm_cvtepi32_pd(_mm_shuffle_epi32(g, 0xEE)), _mm_cvtepi32_pd(_mm_shuffle_epi32(b, 0xEE)), c0, c1, c2);
+    return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+}
+
+__attribute__((target("sse2")))
+static void gray_planar_sse2(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+
+    // Os planos são contiguos: 8 bytes de cada canal, alargados a 16 e 32 bits sem shuffles
+    for (; x + 8 <= width; x += 8) {
+        __m128i r16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r + x)), zero);
+        __m128i g16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(g + x)), zero);
+        __m128i b16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b + x)), zero);
+
+        __m128i lo = gray4_sse2(_mm_unpacklo_epi16(r16, zero), _mm_unpacklo_epi16(g16, zero), _mm_unpacklo_epi16(b16, zero));
+        __m128i hi = gray4_sse2(_mm_unpackhi_epi16(r16, zero), _mm_unpackhi_epi16(g16, zero), _mm_unpackhi_epi16(b16, zero));
+        __m128i v = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v, v));
+    }
+    gray_planar_scalar(r + x, g + x, b + x, dst + x, width - x);
+}
+
+/**
+ * Mascara de SD > limit para 8 pixeis com os canais em 16 bits (SD em 32 bits, mascara em 16).
+ * A divisão por 3 é (soma * 21846) >> 16, exacta para somas até 765
+ */
+__attribute__((target("sse2")))
+static inline __m128i color_mask_sse2(__m128i r, __m128i g, __m128i b, __m128i limit) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i media = _mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(r, g), b), _mm_set1_epi16(21846));
+    __m128i dr = _mm_sub_epi16(r, media), dg = _mm_sub_epi16(g, media), db = _mm_sub_epi16(b, media);
+
+    __m128i rg = _mm_unpacklo_epi16(dr, dg), bz = _mm_unpacklo_epi16(db, zero);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+    rg = _mm_unpackhi_epi16(dr, dg);
+    bz = _mm_unpackhi_epi16(db, zero);
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+
+    return _mm_packs_epi32(_mm_cmpgt_epi32(lo, limit), _mm_cmpgt_epi32(hi, limit));
+}
+
+__attribute__((target("sse2")))
+static void color_remove_planar_sse2(unsigned char *r, unsigned char *g, unsigned char *b, int width, int threshold, int color) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+
+    if (threshold > 0 && threshold <= COLOR_MAX_THRESHOLD) {
+        // SD >= limit  <=>  SD > limit - 1
+        const __m128i limit = _mm_set1_epi32(3 * threshold * threshold - 1);
+        const __m128i fill = _mm_set1_epi8((char)color);
+
+        // O bloco lê r[x + 8], que ainda não foi pintado
+        for (; x + 8 <= width; x += 8) {
+            __m128i r8 = _mm_loadl_epi64((const __m128i *)(r + x));
+            __m128i g8 = _mm_loadl_epi64((const __m128i *)(g + x));
+            __m128i b8 = _mm_loadl_epi64((const __m128i *)(b + x));
+            __m128i m = color_mask_sse2(_mm_unpacklo_epi8(r8, zero), _mm_unpacklo_epi8(g8, zero),
+                                        _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r + x + 1)), zero), limit);
+
+            m = _mm_packs_epi16(m, m);
+            _mm_storel_epi64((__m128i *)(r + x), _mm_or_si128(_mm_and_si128(m, fill), _mm_andnot_si128(m, r8)));
+            _mm_storel_epi64((__m128i *)(g + x), _mm_or_si128(_mm_and_si128(m, fill), _mm_andnot_si128(m, g8)));
+            _mm_storel_epi64((__m128i *)(b + x), _mm_or_si128(_mm_and_si128(m, fill), _mm_andnot_si128(m, b8)));
+        }
+    }
+    color_remove_planar_scalar(r + x, g + x, b + x, width - x, threshold, color);
+}
+
+/**
+ * Com 1 <= value <= 255: r' = r + value saturado; g' = 255 se g + value > 255 (g >= 256 - value),
+ * senão r' + value em 8 bits; o mesmo para o azul. Como 255 é o byte com todos os bits a 1, g' = mascara | (r' + value)
+ */
+__attribute__((target("sse2")))
+static void brigten_planar_sse2(unsigned char *r, unsigned char *g, unsigned char *b, int width, int value) {
+    int x = 0;
+
+    if (value >= 1 && value <= 255) {
+        const __m128i v = _mm_set1_epi8((char)value);
+        const __m128i high = _mm_set1_epi8((char)(256 - value));
+
+        for (; x + 16 <= width; x += 16) {
+            __m128i rv = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(r + x)), v);
+            __m128i gv = _mm_loadu_si128((const __m128i *)(g + x));
+            __m128i bv = _mm_loadu_si128((const __m128i *)(b + x));
+            __m128i t = _mm_add_epi8(rv, v);
+
+            _mm_storeu_si128((__m128i *)(r + x), rv);
+            _mm_storeu_si128((__m128i *)(g + x), _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(gv, high), gv), t));
+            _mm_storeu_si128((__m128i *)(b + x), _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(bv, high), bv), t));
+        }
+    }
+    brigten_planar_scalar(r + x, g + x, b + x, width - x, value);
+}
+
+// Sem pshufb a separação dos canais custa mais que o calculo: a remoção de cor intercalada
+// e a conversão para planar ficam escalares
+const VC_KERNELS vc_kernels_sse2 = {
+        gray_sse2, binary_sse2, color_remove_scalar, morph_rows_sse2, morph_cols_sse2,
+        morph_rows3_sse2, morph_cols3_sse2, pack16_sse2,
+        deinterleave_scalar, interleave_scalar, gray_planar_sse2, color_remove_planar_sse2, brigten_planar_sse2,
+        median_row_sse2, box_rows_sse2, sobel_x_sse2, warp_row_sse2, downscale2_sse2
+};
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          AVX2
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Separação dos canais com pshufb: 4 pixeis (12 bytes) para 4 inteiros de 32 bits por canal.
+// O bloco A começa no pixel 0, o bloco B é lido 8 bytes à frente e tem os pixeis 4 a 7 nos bytes 4 a 15
+#define GRAY_SHUFFLE(c) _mm_setr_epi8((c), -1, -1, -1, (c) + 3, -1, -1, -1, (c) + 6, -1, -1, -1, (c) + 9, -1, -1, -1)
+
+/**
+ * Cinzento de 8 pixeis em dois registos de 4 inteiros. Só lê os 24 bytes dos 8 pixeis
+ */
+__attribute__((target("avx2")))
+static inline void gray8_avx2(const unsigned char *p, __m128i *lo, __m128i *hi) {
+    const __m256d c0 = _mm256_set1_pd(0.299), c1 = _mm256_set1_pd(0.587), c2 = _mm256_set1_pd(0.114);
+    __m128i a = _mm_loadu_si128((const __m128i *)p);
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + 8));
+
+    __m256d ya = GRAY_PD(_mm256_mul_pd, _mm256_add_pd,
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(a, GRAY_SHUFFLE(0))),
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(a, GRAY_SHUFFLE(1))),
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(a, GRAY_SHUFFLE(2))), c0, c1, c2);
+    __m256d yb = GRAY_PD(_mm256_mul_pd, _mm256_add_pd,
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(b, GRAY_SHUFFLE(4))),
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(b, GRAY_SHUFFLE(5))),
+                         _mm256_cvtepi32_pd(_mm_shuffle_epi8(b, GRAY_SHUFFLE(6))), c0, c1, c2);
+
+    *lo = _mm256_cvttpd_epi32(ya);
+    *hi = _mm256_cvttpd_epi32(yb);
+}
+
+__attribute__((target("avx2")))
+static void gray_avx2(const unsigned char *src, unsigned char *dst, int width) {
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo, hi;
+        gray8_avx2(src + 3 * x, &lo, &hi);
+        __m128i v = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v, v));
+    }
+    gray_scalar(src + 3 * x, dst + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void binary_avx2(const unsigned char *src, unsigned char *dst, int width, int threshold) {
+    int x = 0;
+
+    if (threshold >= 0 && threshold < 255) {
+        const __m256i t1 = _mm256_set1_epi8((char)(threshold + 1));
+
+        for (; x + 32 <= width; x += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + x));
+            _mm256_storeu_si256((__m256i *)(dst + x), _mm256_cmpeq_epi8(_mm256_max_epu8(v, t1), v));
+        }
+    }
+    binary_sse2(src + x, dst + x, width - x, threshold);
+}
+
+// Canais de 8 pixeis em 16 bits. A tem os pixeis 0 a 4, B (lido 9 bytes à frente) os pixeis 5 a 7.
+// O azul é o byte 3 do pixel, por isso B vai até ao vermelho do pixel 8
+#define COLOR_SHUFFLE_A(c) _mm_setr_epi8((c), -1, (c) + 3, -1, (c) + 6, -1, (c) + 9, -1, (c) + 12, -1, -1, -1, -1, -1, -1, -1)
+#define COLOR_SHUFFLE_B(c) _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (c) + 6, -1, (c) + 9, -1, (c) + 12, -1)
+
+__attribute__((target("avx2")))
+static inline void color8_avx2(const unsigned char *p, __m128i *r, __m128i *g, __m128i *b) {
+    __m128i va = _mm_loadu_si128((const __m128i *)p);
+    __m128i vb = _mm_loadu_si128((const __m128i *)(p + 9));
+
+    *r = _mm_or_si128(_mm_shuffle_epi8(va, COLOR_SHUFFLE_A(0)), _mm_shuffle_epi8(vb, COLOR_SHUFFLE_B(0)));
+    *g = _mm_or_si128(_mm_shuffle_epi8(va, COLOR_SHUFFLE_A(1)), _mm_shuffle_epi8(vb, COLOR_SHUFFLE_B(1)));
+    *b = _mm_or_si128(_mm_shuffle_epi8(va, COLOR_SHUFFLE_A(3)), _mm_shuffle_epi8(vb, COLOR_SHUFFLE_B(3)));
+}
+
+// Pinta os pixeis marcados numa mascara de movemask com 2 bits por pixel
+static inline void color_paint(unsigned char *p, unsigned int mask, int color) {
+    while (mask != 0) {
+        int i = __builtin_ctz(mask) >> 1;
+        p[3 * i] = color;
+        p[3 * i + 1] = color;
+        p[3 * i + 2] = color;
+        mask &= ~(3u << (2 * i));
+    }
+}
+
+/**
+ * SD de 16 pixeis em 32 bits a partir dos canais em 16 bits.
+ * A divisão por 3 é (soma * 21846) >> 16, exacta para somas até 765; SD >= limit <=> SD > limit - 1
+ */
+__attribute__((target("avx2")))
+static void color_remove_avx2(unsigned char *data, int width, int threshold, int color) {
+    int x = 0;
+
+    if (threshold > 0 && threshold <= COLOR_MAX_THRESHOLD) {
+        const __m256i limit = _mm256_set1_epi32(3 * threshold * threshold - 1);
+        const __m256i third = _mm256_set1_epi16(21846);
+        const __m256i zero = _mm256_setzero_si256();
+
+        // 16 pixeis: metade baixa do registo com os pixeis 0 a 7, metade alta com 8 a 15
+        for (; x + 16 <= width; x += 16) {
+            unsigned char *p = data + 3 * x;
+            __m128i r0, g0, b0, r1, g1, b1;
+            color8_avx2(p, &r0, &g0, &b0);
+            color8_avx2(p + 24, &r1, &g1, &b1);
+
+            __m256i r = _mm256_set_m128i(r1, r0), g = _mm256_set_m128i(g1, g0), b = _mm256_set_m128i(b1, b0);
+            __m256i media = _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_add_epi16(r, g), b), third);
+            __m256i dr = _mm256_sub_epi16(r, media), dg = _mm256_sub_epi16(g, media), db = _mm256_sub_epi16(b, media);
+
+            __m256i rg = _mm256_unpacklo_epi16(dr, dg), bz = _mm256_unpacklo_epi16(db, zero);
+            __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+            rg = _mm256_unpackhi_epi16(dr, dg);
+            bz = _mm256_unpackhi_epi16(db, zero);
+            __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+
+            // Os unpack e o pack são por metades de 128 bits, a ordem dos pixeis mantém-se
+            __m256i mask = _mm256_packs_epi32(_mm256_cmpgt_epi32(lo, limit), _mm256_cmpgt_epi32(hi, limit));
+            color_paint(p, (unsigned int)_mm256_movemask_epi8(mask), color);
+        }
+    }
+    color_remove_scalar(data + 3 * x, width - x, threshold, color);
+}
+
+__attribute__((target("avx2"))) VC_TEMPLATE
+static inline void morph_rows_avx2_t(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode) {
+    const __m256i hit = _mm256_set1_epi8(erode ? 0 : (char)255);
+    const __m256i flip = _mm256_set1_epi8(erode ? (char)255 : 0);
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32) {
+        __m256i found = _mm256_setzero_si256();
+        for (int k = 0; k < nrows; k++) {
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(rows[k] + x)), hit));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_xor_si256(found, flip));
+    }
+    if (x < width) {
+        const unsigned char *tail[nrows > 0 ? nrows : 1];
+        for (int k = 0; k < nrows; k++) tail[k] = rows[k] + x;
+        morph_rows_sse2(tail, nrows, dst + x, width - x, erode);
+    }
+}
+
+__attribute__((target("avx2"))) VC_TEMPLATE
+static inline void morph_cols_avx2_t(const unsigned char *src, unsigned char *dst, int width, int offset, int erode) {
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + x - offset));
+        for (int k = -offset + 1; k <= offset; k++) {
+            __m256i n = _mm256_loadu_si256((const __m256i *)(src + x + k));
+            v = erode ? _mm256_min_epu8(v, n) : _mm256_max_epu8(v, n);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), v);
+    }
+    morph_cols_sse2(src + x, dst + x, width - x, offset, erode);
+}
+
+VC_MORPH_SPECIALISE(avx2, __attribute__((target("avx2"))))
+
+// Um histograma de 16 contadores é um registo
+__attribute__((target("avx2")))
+static inline void hist16_add_avx2(uint16_t *h, const uint16_t *a) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)h);
+    _mm256_storeu_si256((__m256i *)h, _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i *)a)));
+}
+
+__attribute__((target("avx2")))
+static inline void hist16_addsub_avx2(uint16_t *h, const uint16_t *a, const uint16_t *s) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)h);
+    __m256i d = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)a), _mm256_loadu_si256((const __m256i *)s));
+    _mm256_storeu_si256((__m256i *)h, _mm256_add_epi16(v, d));
+}
+
+VC_MEDIAN_ROW(avx2, __attribute__((target("avx2"))))
+
+__attribute__((target("avx2")))
+static inline __m256i sobel_col_avx2(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2) {
+    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)r0));
+    __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)r1));
+    __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)r2));
+    return _mm256_add_epi16(_mm256_add_epi16(a, c), _mm256_slli_epi16(b, 1));
+}
+
+// 32 pixeis por iteração, o resto com 16 e as margens escalares
+__attribute__((target("avx2")))
+static void sobel_x_avx2(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, unsigned char *dst, int width) {
+    int x = 1;
+
+    sobel_x_cols(r0, r1, r2, dst, width, 0, width > 0 ? 1 : 0);
+    for (; x + 32 <= width - 1; x += 32) {
+        __m256i g[2];
+
+        for (int h = 0; h < 2; h++) {
+            int o = x + 16 * h;
+            g[h] = _mm256_abs_epi16(_mm256_sub_epi16(sobel_col_avx2(r0 + o + 1, r1 + o + 1, r2 + o + 1),
+                                                     sobel_col_avx2(r0 + o - 1, r1 + o - 1, r2 + o - 1)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(g[0], g[1]), 0xD8));
+    }
+    x = sobel_x_from_sse2(r0, r1, r2, dst, width, x);
+    sobel_x_cols(r0, r1, r2, dst, width, x, width);
+}
+
+/**
+ * 8 pixeis por iteração, os vizinhos lidos com gathers (mesmos endereços que a versão SSE2).
+ * A interpolação é a de warp_blend_sse2 com registos de 256 bits
+ */
+__attribute__((target("avx2")))
+static void warp_row_avx2(const unsigned char *src, int bytesperline, int width, int height, unsigned char *dst, int n,
+                          int32_t x, int32_t y, int32_t dx, int32_t dy) {
+    const __m256i xmax = _mm256_set1_epi32(((width - 1) << 16) - 1), ymax = _mm256_set1_epi32(((height - 1) << 16) - 1);
+    const __m256i zero = _mm256_setzero_si256(), byte = _mm256_set1_epi32(0xFF), rgb = _mm256_set1_epi32(0xFFFFFF);
+    const __m256i w256 = _mm256_set1_epi32(256), round = _mm256_set1_epi32(128), bpl = _mm256_set1_epi32(bytesperline);
+    const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    // RGB dos 4 pixeis de cada metade nos 12 primeiros bytes
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const int *base = (const int *)src;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i vx = _mm256_add_epi32(_mm256_set1_epi32(x + i * dx), _mm256_mullo_epi32(steps, _mm256_set1_epi32(dx)));
+        __m256i vy = _mm256_add_epi32(_mm256_set1_epi32(y + i * dy), _mm256_mullo_epi32(steps, _mm256_set1_epi32(dy)));
+
+        vx = _mm256_min_epi32(_mm256_max_epi32(vx, zero), xmax);
+        vy = _mm256_min_epi32(_mm256_max_epi32(vy, zero), ymax);
+
+        __m256i x0 = _mm256_srli_epi32(vx, 16);
+        __m256i off = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(vy, 16), bpl), _mm256_add_epi32(x0, _mm256_slli_epi32(x0, 1)));
+        __m256i off1 = _mm256_add_epi32(off, bpl);
+        __m256i p00 = _mm256_and_si256(_mm256_i32gather_epi32(base, off, 1), rgb);
+        __m256i p01 = _mm256_srli_epi32(_mm256_i32gather_epi32((const int *)(src + 2), off, 1), 8);
+        __m256i p10 = _mm256_and_si256(_mm256_i32gather_epi32(base, off1, 1), rgb);
+        __m256i p11 = _mm256_srli_epi32(_mm256_i32gather_epi32((const int *)(src + 2), off1, 1), 8);
+        __m256i wx = _mm256_and_si256(_mm256_srli_epi32(vx, 8), byte), wy = _mm256_and_si256(_mm256_srli_epi32(vy, 8), byte);
+        __m256i ix = _mm256_sub_epi32(w256, wx), iy = _mm256_sub_epi32(w256, wy);
+        __m256i out = zero;
+
+        for (int c = 0; c < 3; c++) {
+            __m256i a = _mm256_and_si256(_mm256_srli_epi32(p00, 8 * c), byte), b = _mm256_and_si256(_mm256_srli_epi32(p01, 8 * c), byte);
+            __m256i d = _mm256_and_si256(_mm256_srli_epi32(p10, 8 * c), byte), e = _mm256_and_si256(_mm256_srli_epi32(p11, 8 * c), byte);
+            __m256i top = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(a, ix), _mm256_mullo_epi16(b, wx)), round), 8);
+            __m256i bottom = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(d, ix), _mm256_mullo_epi16(e, wx)), round), 8);
+            __m256i v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(top, iy), _mm256_mullo_epi16(bottom, wy)), round), 8);
+            out = _mm256_or_si256(out, _mm256_slli_epi32(v, 8 * c));
+        }
+
+        // 24 bytes exactos: 8 + 4 de cada metade
+        out = _mm256_shuffle_epi8(out, pack);
+        __m128i lo = _mm256_castsi256_si128(out), hi = _mm256_extracti128_si256(out, 1);
+        unsigned char *o = dst + 3 * i;
+        int32_t t;
+
+        _mm_storel_epi64((__m128i *)o, lo);
+        t = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+        memcpy(o + 8, &t, 4);
+        _mm_storel_epi64((__m128i *)(o + 12), hi);
+        t = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+        memcpy(o + 20, &t, 4);
+    }
+    warp_pixels(src, bytesperline, width, height, dst, i, n, x, y, dx, dy);
+}
+
+// 32 colunas por iteração; o packus trabalha por metades de 128 bits, a permutação repõe a ordem
+__attribute__((target("avx2")))
+static void box_rows_avx2(uint16_t *sum, const unsigned char *add, const unsigned char *sub, unsigned char *dst, int n, int divisor) {
+    DIV16 div = div16(divisor);
+    const __m256i half = _mm256_set1_epi16((short)(divisor / 2)), m = _mm256_set1_epi16((short)div.m);
+    const __m128i sh1 = _mm_cvtsi32_si128(div.sh1), sh2 = _mm_cvtsi32_si128(div.sh2);
+    int i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i s[2];
+
+        for (int h = 0; h < 2; h++) {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(add + i + 16 * h)));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(sub + i + 16 * h)));
+            __m256i v = _mm256_loadu_si256((const __m256i *)(sum + i + 16 * h));
+
+            v = _mm256_sub_epi16(_mm256_add_epi16(v, a), b);
+            _mm256_storeu_si256((__m256i *)(sum + i + 16 * h), v);
+
+            v = _mm256_add_epi16(v, half);
+            __m256i t = _mm256_mulhi_epu16(v, m);
+            s[h] = _mm256_srl_epi16(_mm256_add_epi16(t, _mm256_srl_epi16(_mm256_sub_epi16(v, t), sh1)), sh2);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(s[0], s[1]), 0xD8));
+    }
+    box_rows_sse2(sum + i, add + i, sub + i, dst + i, n - i, divisor);
+}
+
+
+// Separação de 16 pixeis RGB (3 blocos de 16 bytes) em 16 bytes por canal: mascaras pshufb por canal e bloco
+static const signed char deinterleave_masks[3][3][16] = {
+        { { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 } },
+        { { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 } },
+        { { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+          { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 } },
+};
+
+// Junção: bloco de saida, canal de origem
+static const signed char interleave_masks[3][3][16] = {
+        { { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+          { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+          { -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 } },
+        { { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+          { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+          { -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 } },
+        { { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+          { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+          { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 } },
+};
+
+#define SHUFFLE_MASK(m) _mm_loadu_si128((const __m128i *)(m))
+
+__attribute__((target("avx2")))
+static void deinterleave_avx2(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b, int width) {
+    unsigned char *out[3] = { r, g, b };
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + 3 * x + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(src + 3 * x + 32));
+
+        for (int c = 0; c < 3; c++) {
+            __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, SHUFFLE_MASK(deinterleave_masks[c][0])),
+                                                  _mm_shuffle_epi8(v1, SHUFFLE_MASK(deinterleave_masks[c][1]))),
+                                     _mm_shuffle_epi8(v2, SHUFFLE_MASK(deinterleave_masks[c][2])));
+            _mm_storeu_si128((__m128i *)(out[c] + x), v);
+        }
+    }
+    deinterleave_scalar(src + 3 * x, r + x, g + x, b + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void interleave_avx2(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width) {
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i vr = _mm_loadu_si128((const __m128i *)(r + x));
+        __m128i vg = _mm_loadu_si128((const __m128i *)(g + x));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+
+        for (int k = 0; k < 3; k++) {
+            __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, SHUFFLE_MASK(interleave_masks[k][0])),
+                                                  _mm_shuffle_epi8(vg, SHUFFLE_MASK(interleave_masks[k][1]))),
+                                     _mm_shuffle_epi8(vb, SHUFFLE_MASK(interleave_masks[k][2])));
+            _mm_storeu_si128((__m128i *)(dst + 3 * x + 16 * k), v);
+        }
+    }
+    interleave_scalar(r + x, g + x, b + x, dst + 3 * x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void gray_planar_avx2(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, int width) {
+    const __m256d c0 = _mm256_set1_pd(0.299), c1 = _mm256_set1_pd(0.587), c2 = _mm256_set1_pd(0.114);
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i r8 = _mm_loadl_epi64((const __m128i *)(r + x));
+        __m128i g8 = _mm_loadl_epi64((const __m128i *)(g + x));
+        __m128i b8 = _mm_loadl_epi64((const __m128i *)(b + x));
+
+        __m256d lo = GRAY_PD(_mm256_mul_pd, _mm256_add_pd, _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(r8)),
+                             _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(g8)), _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(b8)), c0, c1, c2);
+        __m256d hi = GRAY_PD(_mm256_mul_pd, _mm256_add_pd, _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(r8, 4))),
+                             _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(g8, 4))),
+                             _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(b8, 4))), c0, c1, c2);
+
+        __m128i v = _mm_packs_epi32(_mm256_cvttpd_epi32(lo), _mm256_cvttpd_epi32(hi));
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v, v));
+    }
+    gray_planar_sse2(r + x, g + x, b + x, dst + x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void color_remove_planar_avx2(unsigned char *r, unsigned char *g, unsigned char *b, int width, int threshold, int color) {
+    int x = 0;
+
+    if (threshold > 0 && threshold <= COLOR_MAX_THRESHOLD) {
+        const __m256i limit = _mm256_set1_epi32(3 * threshold * threshold - 1);
+        const __m256i third = _mm256_set1_epi16(21846);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m128i fill = _mm_set1_epi8((char)color);
+
+        // 16 pixeis por iteração, lê r[x + 16] que ainda não foi pintado
+        for (; x + 16 <= width; x += 16) {
+            __m128i r8 = _mm_loadu_si128((const __m128i *)(r + x));
+            __m128i g8 = _mm_loadu_si128((const __m128i *)(g + x));
+            __m128i b8 = _mm_loadu_si128((const __m128i *)(b + x));
+            __m256i rv = _mm256_cvtepu8_epi16(r8), gv = _mm256_cvtepu8_epi16(g8);
+            __m256i bv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r + x + 1)));
+
+            __m256i media = _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_add_epi16(rv, gv), bv), third);
+            __m256i dr = _mm256_sub_epi16(rv, media), dg = _mm256_sub_epi16(gv, media), db = _mm256_sub_epi16(bv, media);
+
+            __m256i rg = _mm256_unpacklo_epi16(dr, dg), bz = _mm256_unpacklo_epi16(db, zero);
+            __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+            rg = _mm256_unpackhi_epi16(dr, dg);
+            bz = _mm256_unpackhi_epi16(db, zero);
+            __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+
+            __m256i m16 = _mm256_packs_epi32(_mm256_cmpgt_epi32(lo, limit), _mm256_cmpgt_epi32(hi, limit));
+            __m128i m = _mm_packs_epi16(_mm256_castsi256_si128(m16), _mm256_extracti128_si256(m16, 1));
+
+            _mm_storeu_si128((__m128i *)(r + x), _mm_blendv_epi8(r8, fill, m));
+            _mm_storeu_si128((__m128i *)(g + x), _mm_blendv_epi8(g8, fill, m));
+            _mm_storeu_si128((__m128i *)(b + x), _mm_blendv_epi8(b8, fill, m));
+        }
+    }
+    color_remove_planar_sse2(r + x, g + x, b + x, width - x, threshold, color);
+}
+
+__attribute__((target("avx2")))
+static void brigten_planar_avx2(unsigned char *r, unsigned char *g, unsigned char *b, int width, int value) {
+    int x = 0;
+
+    if (value >= 1 && value <= 255) {
+        const __m256i v = _mm256_set1_epi8((char)value);
+        const __m256i high = _mm256_set1_epi8((char)(256 - value));
+
+        for (; x + 32 <= width; x += 32) {
+            __m256i rv = _mm256_adds_epu8(_mm256_loadu_si256((const __m256i *)(r + x)), v);
+            __m256i gv = _mm256_loadu_si256((const __m256i *)(g + x));
+            __m256i bv = _mm256_loadu_si256((const __m256i *)(b + x));
+            __m256i t = _mm256_add_epi8(rv, v);
+
+            _mm256_storeu_si256((__m256i *)(r + x), rv);
+            _mm256_storeu_si256((__m256i *)(g + x), _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(gv, high), gv), t));
+            _mm256_storeu_si256((__m256i *)(b + x), _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(bv, high), bv), t));
+        }
+    }
+    brigten_planar_sse2(r + x, g + x, b + x, width - x, value);
+}
+
+// Pares de bytes do mesmo canal de dois pixeis vizinhos, lado a lado para o maddubs. A lê a partir do
+// pixel 0 (pares dos pixeis de saida 0 e 1), B a partir do byte 8 (pares dos pixeis 2 e 3 nos bytes 4 a 15)
+#define DOWNSCALE_PAIRS_A _mm256_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1, \
+                                           0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1)
+#define DOWNSCALE_PAIRS_B _mm256_setr_epi8(4, 7, 5, 8, 6, 9, 10, 13, 11, 14, 12, 15, -1, -1, -1, -1, \
+                                           4, 7, 5, 8, 6, 9, 10, 13, 11, 14, 12, 15, -1, -1, -1, -1)
+
+/**
+ * Somas 2x1 de 4 pixeis RGB de saida por metade (24 bytes de entrada em cada lane de 128 bits)
+ * em dois registos de 6 contadores de 16 bits por lane
+ */
+__attribute__((target("avx2")))
+static inline void downscale2_pairs_avx2(const unsigned char *p, __m256i *a, __m256i *b) {
+    const __m256i ones = _mm256_set1_epi8(1);
+    __m256i va = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)(p + 24)), _mm_loadu_si128((const __m128i *)p));
+    __m256i vb = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)(p + 32)), _mm_loadu_si128((const __m128i *)(p + 8)));
+
+    *a = _mm256_maddubs_epi16(_mm256_shuffle_epi8(va, DOWNSCALE_PAIRS_A), ones);
+    *b = _mm256_maddubs_epi16(_mm256_shuffle_epi8(vb, DOWNSCALE_PAIRS_B), ones);
+}
+
+// RGB: 8 pixeis de saida (48 bytes de cada linha de entrada) por iteração, os cinzentos ficam na versão SSE2
+__attribute__((target("avx2")))
+static void downscale2_avx2(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int width, int channels) {
+    const __m256i two = _mm256_set1_epi16(2);
+    // Os 6 bytes de A e de B de cada metade nos 12 primeiros bytes
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+                                          0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+    int x = 0;
+
+    if (channels != 3) {
+        downscale2_sse2(row0, row1, dst, width, channels);
+        return;
+    }
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i a0, b0, a1, b1;
+
+        downscale2_pairs_avx2(row0 + 6 * x, &a0, &b0);
+        downscale2_pairs_avx2(row1 + 6 * x, &a1, &b1);
+
+        __m256i a = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(a0, a1), two), 2);
+        __m256i b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(b0, b1), two), 2);
+        __m256i out = _mm256_shuffle_epi8(_mm256_packus_epi16(a, b), pack);
+
+        // 24 bytes exactos: 8 + 4 de cada metade
+        __m128i lo = _mm256_castsi256_si128(out), hi = _mm256_extracti128_si256(out, 1);
+        unsigned char *o = dst + 3 * x;
+        int32_t t;
+
+        _mm_storel_epi64((__m128i *)o, lo);
+        t = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+        memcpy(o + 8, &t, 4);
+        _mm_storel_epi64((__m128i *)(o + 12), hi);
+        t = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+        memcpy(o + 20, &t, 4);
+    }
+    downscale2_scalar(row0 + 6 * x, row1 + 6 * x, dst + 3 * x, width - x, 3);
+}
+
+// O empacotamento é de 16 amostras espalhadas, um registo de 128 bits chega
+const VC_KERNELS vc_kernels_avx2 = {
+        gray_avx2, binary_avx2, color_remove_avx2, morph_rows_avx2, morph_cols_avx2,
+        morph_rows3_avx2, morph_cols3_avx2, pack16_sse2,
+        deinterleave_avx2, interleave_avx2, gray_planar_avx2, color_remove_planar_avx2, brigten_planar_avx2,
+        median_row_avx2, box_rows_avx2, sobel_x_avx2, warp_row_avx2, downscale2_avx2
+};
+
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                    AVX-512 (F + BW)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// As operações _round não são fundidas em FMA pelo compilador (AVX-512F inclui FMA),
+// assim a soma tem os mesmos arredondamentos que a versão escalar
+#define MUL512(a, b) _mm512_mul_round_pd((a), (b), _MM_FROUND_CUR_DIRECTION)
+#define ADD512(a, b) _mm512_add_round_pd((a), (b), _MM_FROUND_CUR_DIRECTION)
+
+__attribute__((target("avx512f,avx512bw")))
+static void gray_avx512(const unsigned char *src, unsigned char *dst, int width) {
+    const __m512d c0 = _mm512_set1_pd(0.299), c1 = _mm512_set1_pd(0.587), c2 = _mm512_set1_pd(0.114);
+    int x = 0;
+
+    // 16 pixeis: dois grupos de 8, cada um com os blocos A e B da versão AVX2
+    for (; x + 16 <= width; x += 16) {
+        const unsigned char *p = src + 3 * x;
+        __m256i out[2];
+
+        for (int h = 0; h < 2; h++) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(p + 24 * h));
+            __m128i b = _mm_loadu_si128((const __m128i *)(p + 24 * h + 8));
+            __m256i r = _mm256_set_m128i(_mm_shuffle_epi8(b, GRAY_SHUFFLE(4)), _mm_shuffle_epi8(a, GRAY_SHUFFLE(0)));
+            __m256i g = _mm256_set_m128i(_mm_shuffle_epi8(b, GRAY_SHUFFLE(5)), _mm_shuffle_epi8(a, GRAY_SHUFFLE(1)));
+            __m256i bl = _mm256_set_m128i(_mm_shuffle_epi8(b, GRAY_SHUFFLE(6)), _mm_shuffle_epi8(a, GRAY_SHUFFLE(2)));
+
+            __m512d y = GRAY_PD(MUL512, ADD512, _mm512_cvtepi32_pd(r), _mm512_cvtepi32_pd(g), _mm512_cvtepi32_pd(bl), c0, c1, c2);
+            out[h] = _mm512_cvttpd_epi32(y);
+        }
+
+        __m512i v = _mm512_inserti64x4(_mm512_castsi256_si512(out[0]), out[1], 1);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm512_cvtepi32_epi8(v));
+    }
+    gray_avx2(src + 3 * x, dst + x, width - x);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void binary_avx512(const unsigned char *src, unsigned char *dst, int width, int threshold) {
+    if (threshold < 0 || threshold >= 255) {
+        binary_scalar(src, dst, width, threshold);
+        return;
+    }
+
+    const __m512i t = _mm512_set1_epi8((char)threshold);
+
+    // O fim da linha é feito com loads e stores mascarados
+    for (int x = 0; x < width; x += 64) {
+        __mmask64 m = (width - x >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (width - x)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(m, src + x);
+        _mm512_mask_storeu_epi8(dst + x, m, _mm512_movm_epi8(_mm512_cmpgt_epu8_mask(v, t)));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) VC_TEMPLATE
+static inline void morph_rows_avx512_t(const unsigned char **rows, int nrows, unsigned char *dst, int width, int erode) {
+    const __m512i hit = _mm512_set1_epi8(erode ? 0 : (char)255);
+
+    for (int x = 0; x < width; x += 64) {
+        __mmask64 m = (width - x >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (width - x)) - 1);
+        __mmask64 found = 0;
+
+        for (int k = 0; k < nrows; k++) found |= _mm512_cmpeq_epi8_mask(_mm512_maskz_loadu_epi8(m, rows[k] + x), hit);
+        _mm512_mask_storeu_epi8(dst + x, m, _mm512_movm_epi8(erode ? ~found : found));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) VC_TEMPLATE
+static inline void morph_cols_avx512_t(const unsigned char *src, unsigned char *dst, int width, int offset, int erode) {
+    for (int x = 0; x < width; x += 64) {
+        __mmask64 m = (width - x >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (width - x)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(m, src + x - offset);
+
+        for (int k = -offset + 1; k <= offset; k++) {
+            __m512i n = _mm512_maskz_loadu_epi8(m, src + x + k);
+            v = erode ? _mm512_min_epu8(v, n) : _mm512_max_epu8(v, n);
+        }
+        _mm512_mask_storeu_epi8(dst + x, m, v);
+    }
+}
+
+VC_MORPH_SPECIALISE(avx512, __attribute__((target("avx512f,avx512bw"))))
+
+
+// A remoção de cor e a redução 2x já estão limitadas pela separação dos canais e os kernels planares pela memória,
+// ficam as versões AVX2. Os histogramas da mediana já cabem num registo AVX2, a média é limitada pela memória
+// e a amostragem bilinear pelos gathers
+const VC_KERNELS vc_kernels_avx512 = {
+        gray_avx512, binary_avx512, color_remove_avx2, morph_rows_avx512, morph_cols_avx512,
+        morph_rows3_avx512, morph_cols3_avx512, pack16_sse2,
+        deinterleave_avx2, interleave_avx2, gray_planar_avx2, color_remove_planar_avx2, brigten_planar_avx2,
+        median_row_avx2, box_rows_avx2, sobel_x_avx2, warp_row_avx2, downscale2_avx2
+};
+
+#else
+
+const VC_KERNELS vc_kernels_sse2 = {
+        gray_scalar, binary_scalar, color_remove_scalar, morph_rows_scalar, morph_cols_scalar,
+        morph_rows3_scalar, morph_cols3_scalar, pack16_scalar,
+        deinterleave_scalar, interleave_scalar, gray_planar_scalar, color_remove_planar_scalar, brigten_planar_scalar,
+        median_row_scalar, box_rows_scalar, sobel_x_scalar, warp_row_scalar, downscale2_scalar
+};
+const VC_KERNELS vc_kernels_avx2 = {
+        gray_scalar, binary_scalar, color_remove_scalar, morph_rows_scalar, morph_cols_scalar,
+        morph_rows3_scalar, morph_cols3_scalar, pack16_scalar,
+        deinterleave_scalar, interleave_scalar, gray_planar_scalar, color_remove_planar_scalar, brigten_planar_scalar,
+        median_row_scalar, box_rows_scalar, sobel_x_scalar, warp_row_scalar, downscale2_scalar
+};
+const VC_KERNELS vc_kernels_avx512 = {
+        gray_scalar, binary_scalar, color_remove_scalar, morph_rows_scalar, morph_cols_scalar,
+        morph_rows3_scalar, morph_cols3_scalar, pack16_scalar,
+        deinterleave_scalar, interleave_scalar, gray_planar_scalar, color_remove_planar_scalar, brigten_planar_scalar,
+        median_row_scalar, box_rows_scalar, sobel_x_scalar, warp_row_scalar, downscale2_scalar
+};
+
+#endif
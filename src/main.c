@@ -15,7 +15,12 @@
 #include <sys/types.h>
 #include <stdio.h> // puts() printf
 #include <limits.h> // PATH_MAX
+#include <unistd.h> // getopt()
 #include "plate-recognizer.h"
+#include "stats.h"
+#include "memory.h"
+#include "server.h"
+#include "threadpool.h"
 
 
 /**
@@ -28,27 +33,211 @@ int main(int argc, char** argv) {
 
     char directorio[PATH_MAX];
     char ficheiro[PATH_MAX];
+    char texto[9] = "";
+    int opt, found;
+    char *server_socket = NULL, *client_socket = NULL;
+    int workers = 4, send_inline = 0, results_only = 0, memory_report = 0;
+    VC_RECOGNIZER ctx;
+    VC_RESULT result;
 
-    if (argc == 3) {
-        //
-        strcpy(ficheiro,argv[1]);
-        strcpy(directorio,argv[2]);
+    vc_recognizer_init(&ctx);
+
+    // Opções
+    while ((opt = getopt(argc, argv, "p:ert:M:sHm:w:b:k:g:d:j:c:iJP:")) != -1) {
+        switch (opt) {
+            case 'p':
+                // Niveis da piramide para a procura de candidatos
+                ctx.pyramid_levels = atoi(optarg);
+                if (ctx.pyramid_levels < 0 || ctx.pyramid_levels > 2) ctx.pyramid_levels = 0;
+                break;
+            case 'e':
+                // Candidatos pela densidade de contornos verticais
+                ctx.edge_candidates = 1;
+                break;
+            case 'r':
+                // Endireita os candidatos inclinados
+                ctx.deskew = 1;
+                break;
+            case 't':
+                // Threshold automático: "otsu" ou percentil inteiro [0,100]
+                if (strcmp(optarg, "otsu") == 0) {
+                    ctx.threshold_mode = VC_THRESHOLD_OTSU;
+                } else {
+                    char *end;
+                    long percentile = strtol(optarg, &end, 10);
+
+                    // Texto que não é só um numero ou fora de [0,100]: mostra a utilização
+                    if (end == optarg || *end != 0 || percentile < 0 || percentile > 100) {
+                        argc = 0;
+                        break;
+                    }
+                    ctx.threshold_mode = VC_THRESHOLD_PERCENTILE;
+                    ctx.threshold_percentile = (float)percentile;
+                }
+                break;
+            case 'M':
+                // Mediana dos cinzentos antes da binarização
+                ctx.median_radius = atoi(optarg);
+                if (ctx.median_radius < 0) ctx.median_radius = 0;
+                if (ctx.median_radius > VC_MEDIAN_MAX_RADIUS) ctx.median_radius = VC_MEDIAN_MAX_RADIUS;
+                break;
+            case 's':
+                // Tempos por estágio e contadores, uma linha JSON em stderr (e a memória das imagens no fim)
+                vc_stats.enabled = 1;
+                memory_report = 1;
+                break;
+            case 'H':
+                // Contadores de hardware (perf_event_open) nos tempos de -s e -J
+                vc_stats_hw = 1;
+                break;
+            case 'm':
+                // Maximo de candidatos verificados por imagem
+                ctx.max_verifications = atoi(optarg);
+                if (ctx.max_verifications < 0) ctx.max_verifications = 0;
+                break;
+            case 'w':
+                // Threads da verificação dos candidatos
+                ctx.verify_threads = atoi(optarg);
+                if (ctx.verify_threads < 0) ctx.verify_threads = 0;
+                if (ctx.verify_threads > VC_THREADPOOL_MAX + 1) ctx.verify_threads = VC_THREADPOOL_MAX + 1;
+                break;
+            case 'b':
+                // Orçamento por imagem em milisegundos
+                ctx.budget = (long long)(atof(optarg) * 1000000);
+                if (ctx.budget < 0) ctx.budget = 0;
+                break;
+            case 'k':
+                // Seguimento da matricula entre frames: falhas até voltar à imagem completa
+                ctx.track_misses = atoi(optarg);
+                if (ctx.track_misses < 0) ctx.track_misses = 0;
+                break;
+            case 'g':
+                // Salta frames iguais à anterior (diferença máxima por bloco)
+                ctx.gate.threshold = atoi(optarg);
+                break;
+            case 'd':
+                // Modo servidor no socket Unix indicado
+                server_socket = optarg;
+                break;
+            case 'j':
+                // Numero de workers do servidor
+                workers = atoi(optarg);
+                break;
+            case 'c':
+                // Modo cliente: envia as imagens ao servidor
+                client_socket = optarg;
+                break;
+            case 'i':
+                // Cliente envia o conteudo das imagens em vez do caminho
+                send_inline = 1;
+                break;
+            case 'J':
+                // Só resultados: um registo JSON por imagem em stdout, sem imagens intermédias
+                results_only = 1;
+                break;
+            case 'P':
+                // Grava só o recorte da matricula
+                ctx.crop_dir = optarg;
+                break;
+            default:
+                argc = 0;
+        }
+    }
 
+    if (argc > 0 && server_socket != NULL && argc == optind) {
+        found = vc_server_run(server_socket, workers, &ctx);
+        vc_recognizer_free(&ctx);
+        if (memory_report) vc_memory_print(stderr);
+        return found ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (argc > 0 && client_socket != NULL && argc > optind) {
+        char reply[VC_SERVER_LINE];
+        int fd = vc_client_connect(client_socket);
+
+        vc_recognizer_free(&ctx);
+        if (fd < 0) {
+            printf("Cannot connect to %s!\n", client_socket);
+            return(EXIT_FAILURE);
+        }
+        // Todos os pedidos na mesma ligação, uma linha de resposta por imagem
+        for (int i = optind; i < argc; i++) {
+            if (!vc_client_request(fd, argv[i], send_inline, reply, sizeof(reply))) {
+                printf("%s: request failed\n", argv[i]);
+                close(fd);
+                return(EXIT_FAILURE);
+            }
+            printf("%s: %s\n", argv[i], reply);
+        }
+        close(fd);
+        return(EXIT_SUCCESS);
+    } else if (argc > 0 && results_only && argc > optind) {
+        int errors = 0;
+
+        // Os tempos fazem parte do registo
+        vc_stats.enabled = 1;
+        for (int i = optind; i < argc; i++) {
+            found = processImage(&ctx, argv[i], &result);
+            if (found < 0) errors++;
+            vc_result_print(stdout, argv[i], found, &result);
+            fflush(stdout);
+        }
+        vc_recognizer_free(&ctx);
+        if (memory_report) vc_memory_print(stderr);
+        return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (argc - optind == 2) {
+        //
+        strcpy(ficheiro,argv[optind]);
+        strcpy(directorio,argv[optind + 1]);
+        ctx.output_dir = directorio;
 
         printf("\nStarting processing %s....\n",ficheiro);
 
-        if (processImage(ficheiro, directorio)) {
+        found = processImage(&ctx, ficheiro, &result);
+        vc_recognizer_free(&ctx);
+        if (found < 0) return(EXIT_FAILURE);
+
+        if (found) sprintf(texto, "%.2s-%.2s-%.2s", result.text, result.text + 2, result.text + 4);
+        if (vc_stats.enabled) vc_stats_print(stderr, ficheiro, found, texto);
+        if (memory_report) vc_memory_print(stderr);
+
+        if (found) {
             printf("\nValid Plate FOUND! ¯\\\\_(ツ)_/¯\n");
+            printf("Plate: %s\n", texto);
         } else {
             printf("\nPlate not FOUND! :( \n");
         }
+        if (result.deadline_exceeded) {
+            printf("Deadline exceeded, best candidate at %d,%d %dx%d with %d characters\n",
+                   result.plate.x, result.plate.y, result.plate.width, result.plate.height, result.nchars);
+        }
 
         printf("\nProcessing of %s finished.\n",ficheiro);
         return(EXIT_SUCCESS);
     } else {
         printf("Invalid arguments!\n\n");
         printf("USage: \n"
-               "\t%s [FILENAME] [OUTPUT DIR]",argv[0]);
+               "\t%s [-p LEVELS] [-e] [-r] [-t otsu|PERCENTILE] [-M RADIUS] [-s] [-H] [-m MAX] [-w THREADS] [-b MS] [FILENAME] [OUTPUT DIR]\n"
+               "\t%s -J [-P DIR] [-s] [-H] [-p LEVELS] [-e] [-r] [-t otsu|PERCENTILE] [-M RADIUS] [-m MAX] [-w THREADS] [-b MS] FILENAME...\n"
+               "\t%s [-p LEVELS] [-e] [-r] [-t otsu|PERCENTILE] [-M RADIUS] [-s] [-H] [-m MAX] [-w THREADS] [-b MS] [-k MISSES] [-g THRESHOLD] -d SOCKET [-j WORKERS]\n"
+               "\t%s -c SOCKET [-i] FILENAME...\n"
+               "\t-p LEVELS\tsearch plate candidates on a 1/2 (1) or 1/4 (2) pyramid level\n"
+               "\t-e\t\tsearch plate candidates by vertical edge density (Sobel) instead of the color preamble\n"
+               "\t-r\t\tstraighten tilted plate candidates that fail the character checks and verify them again\n"
+               "\t-t MODE\t\tautomatic binary thresholds from the gray histogram (otsu or a percentile 0 to 100)\n"
+               "\t-M RADIUS\tmedian filter the gray image before thresholding (salt-and-pepper noise)\n"
+               "\t-s\t\tprint stage timings, candidate counters and image memory as one JSON line on stderr,\n"
+               "\t\t\tand the image memory totals at exit\n"
+               "\t-H\t\tadd cycles, instructions, LLC misses and branch misses to each stage and operation time\n"
+               "\t-m MAX\t\tverify at most MAX plate-shaped candidates per image, best scored first (default all)\n"
+               "\t-w THREADS\tverify the plate candidates on THREADS threads (the best scored plate wins; with -J or -d)\n"
+               "\t-b MS\t\tstop after MS milliseconds per image and report the best partial result\n"
+               "\t-k MISSES\ttrack the plate across the frames of a connection, full search after MISSES misses\n"
+               "\t-g THRESHOLD\treuse the previous result when no 16x16 luma block changed more than THRESHOLD levels\n"
+               "\t-d SOCKET\tserve requests on a Unix socket until SIGINT/SIGTERM\n"
+               "\t-j WORKERS\tnumber of server workers (default 4)\n"
+               "\t-c SOCKET\tsend the images to a running server and print the replies\n"
+               "\t-i\t\tsend the image bytes instead of the path\n"
+               "\t-J\t\tresults only: no images written, one JSON line per image on stdout (plate, boxes, timings)\n"
+               "\t-P DIR\t\twrite only the plate crop of each image found to DIR/<image>_plate.ppm\n",argv[0],argv[0],argv[0],argv[0]);
         return(EXIT_FAILURE);
     }
 
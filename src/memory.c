@@ -0,0 +1,151 @@
+/**
+ * Este ficheiro contem a contabilidade da memória das imagens
+ * @brief Bytes em uso, pico e numero de alocações de vc_image_new / vc_image_free, por processo, por imagem e por sitio
+ * @file memory.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // strcmp()
+#include <pthread.h>
+#include "memory.h"
+#include "stats.h"
+
+// Totais do processo, actualizados com operações atómicas
+static VC_MEMORY totals;
+
+// Sitios de vc_image_new (só com VC_MEMORY_SITES)
+typedef struct {
+    const char *file;
+    int line;
+    VC_MEMORY memory;
+} VC_MEMORY_SITE;
+
+static VC_MEMORY_SITE sites[VC_MEMORY_MAX_SITES];
+static int nsites;
+static pthread_mutex_t sites_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Soma bytes (negativo numa libertação) a live e actualiza o pico. Sem sincronização
+ * @param memory
+ * @param bytes
+ */
+static void memory_add(VC_MEMORY *memory, long long bytes) {
+    memory->live += bytes;
+    if (memory->live > memory->peak) memory->peak = memory->live;
+    if (bytes > 0) {
+        memory->bytes += bytes;
+        memory->allocations++;
+    } else {
+        memory->frees++;
+    }
+}
+
+/**
+ * Entrada de um sitio, criada na primeira alocação. Chamada com sites_lock
+ * @return indice ou -1 se a tabela está cheia
+ */
+static int memory_site(const char *file, int line) {
+    for (int i = 0; i < nsites; i++) {
+        if (sites[i].line == line && strcmp(sites[i].file, file) == 0) return i;
+    }
+    if (nsites == VC_MEMORY_MAX_SITES) return -1;
+    sites[nsites].file = file;
+    sites[nsites].line = line;
+    return nsites++;
+}
+
+/**
+ * Conta uma imagem nova
+ * @param bytes tamanho da imagem (estrutura e dados)
+ * @param file ficheiro de onde vc_image_new foi chamada (NULL sem contagem por sitio)
+ * @param line
+ * @return indice do sitio, a guardar na imagem para a libertação, ou -1
+ */
+int vc_memory_alloc(long long bytes, const char *file, int line) {
+    long long live = __atomic_add_fetch(&totals.live, bytes, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&totals.peak, __ATOMIC_RELAXED);
+    int site = -1;
+
+    while (live > peak && !__atomic_compare_exchange_n(&totals.peak, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&totals.bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals.allocations, 1, __ATOMIC_RELAXED);
+
+    if (vc_stats.enabled) memory_add(&vc_stats.memory, bytes);
+
+    if (file != NULL) {
+        pthread_mutex_lock(&sites_lock);
+        site = memory_site(file, line);
+        if (site >= 0) memory_add(&sites[site].memory, bytes);
+        pthread_mutex_unlock(&sites_lock);
+    }
+    return site;
+}
+
+/**
+ * Conta a libertação de uma imagem criada por vc_image_new
+ * @param bytes o tamanho contado em vc_memory_alloc
+ * @param site o indice devolvido por vc_memory_alloc
+ */
+void vc_memory_free(long long bytes, int site) {
+    __atomic_sub_fetch(&totals.live, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals.frees, 1, __ATOMIC_RELAXED);
+
+    if (vc_stats.enabled) memory_add(&vc_stats.memory, -bytes);
+
+    if (site >= 0) {
+        pthread_mutex_lock(&sites_lock);
+        memory_add(&sites[site].memory, -bytes);
+        pthread_mutex_unlock(&sites_lock);
+    }
+}
+
+/**
+ * Totais do processo
+ * @param memory
+ */
+void vc_memory_get(VC_MEMORY *memory) {
+    memory->live = __atomic_load_n(&totals.live, __ATOMIC_RELAXED);
+    memory->peak = __atomic_load_n(&totals.peak, __ATOMIC_RELAXED);
+    memory->bytes = __atomic_load_n(&totals.bytes, __ATOMIC_RELAXED);
+    memory->allocations = __atomic_load_n(&totals.allocations, __ATOMIC_RELAXED);
+    memory->frees = __atomic_load_n(&totals.frees, __ATOMIC_RELAXED);
+}
+
+/**
+ * Repõe o pico do processo nos bytes em uso (ex: para medir só uma parte do trabalho)
+ */
+void vc_memory_reset_peak(void) {
+    __atomic_store_n(&totals.peak, __atomic_load_n(&totals.live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+static void memory_print_fields(FILE *f, const VC_MEMORY *memory) {
+    fprintf(f, "\"live\":%lld,\"peak\":%lld,\"bytes\":%lld,\"allocations\":%lld,\"frees\":%lld",
+            memory->live, memory->peak, memory->bytes, memory->allocations, memory->frees);
+}
+
+/**
+ * Relatório final numa linha JSON: os totais do processo (live > 0 são imagens que ficaram por libertar)
+ * e, com VC_MEMORY_SITES, um registo por sitio de vc_image_new
+ * @param f
+ */
+void vc_memory_print(FILE *f) {
+    VC_MEMORY memory;
+
+    vc_memory_get(&memory);
+    fprintf(f, "{\"memory\":{");
+    memory_print_fields(f, &memory);
+    fprintf(f, "},\"sites\":[");
+
+    pthread_mutex_lock(&sites_lock);
+    for (int i = 0; i < nsites; i++) {
+        fprintf(f, "%s{\"site\":", i ? "," : "");
+        fprintf(f, "\"%s:%d\",", sites[i].file, sites[i].line);
+        memory_print_fields(f, &sites[i].memory);
+        fprintf(f, "}");
+    }
+    pthread_mutex_unlock(&sites_lock);
+    fprintf(f, "]}\n");
+}
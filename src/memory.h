@@ -0,0 +1,42 @@
+/**
+ * Este ficheiro contem as assinaturas da contabilidade da memória das imagens
+ * @brief Bytes em uso, pico e numero de alocações de vc_image_new / vc_image_free, por processo, por imagem e por sitio
+ * @file memory.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Os totais do processo são sempre contados (operações atómicas). Os da imagem em curso ficam em
+ * vc_stats.memory e só são contados com a instrumentação ligada. Com VC_MEMORY_SITES definido
+ * (vc.h ou make CFLAGS="-O2 -DVC_MEMORY_SITES") cada vc_image_new guarda o ficheiro e a linha
+ * de onde foi chamado e o relatório final tem uma entrada por sitio.
+ */
+
+#ifndef VC_TP1_13871_14383_17442_MEMORY_H
+#define VC_TP1_13871_14383_17442_MEMORY_H
+
+#include <stdio.h>
+
+// Numero maximo de sitios distintos; os restantes só contam nos totais
+#define VC_MEMORY_MAX_SITES 128
+
+/**
+ * Contadores de memória. Em vc_stats.memory live é a diferença desde o inicio da imagem
+ * (negativo se a imagem libertou buffers de outra) e peak o maximo dessa diferença
+ */
+typedef struct {
+    long long live;             // Bytes das imagens ainda não libertadas
+    long long peak;             // Maximo de live
+    long long bytes;            // Bytes alocados (total)
+    long long allocations;      // Imagens criadas
+    long long frees;            // Imagens libertadas
+} VC_MEMORY;
+
+int vc_memory_alloc(long long bytes, const char *file, int line);
+void vc_memory_free(long long bytes, int site);
+void vc_memory_get(VC_MEMORY *memory);
+void vc_memory_reset_peak(void);
+void vc_memory_print(FILE *f);
+
+#endif //VC_TP1_13871_14383_17442_MEMORY_H
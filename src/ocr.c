@@ -0,0 +1,275 @@
+/**
+ * Este ficheiro contem as funções de reconhecimento de caracteres da matricula
+ * @brief Normaliza cada caracter para uma grelha de bits e compara com templates A-Z/0-9
+ * @file ocr.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memset()
+#include <limits.h> // INT_MAX
+#include <pthread.h> // pthread_once()
+#include "ocr.h"
+#include "cpu.h"
+
+// Expande uma linha de 5 bits de um glifo 5x7 para 16 bits (colunas com 3,3,4,3,3 bits)
+// Na grelha o bit 0 é a coluna da esquerda (igual à ordem do _mm_movemask_epi8)
+#define OCR_ROW(b) ((uint16_t)( \
+        (((b) >> 4 & 1) * 0x0007) | (((b) >> 3 & 1) * 0x0038) | (((b) >> 2 & 1) * 0x03C0) | \
+        (((b) >> 1 & 1) * 0x1C00) | (((b) & 1) * 0xE000)))
+
+// Expande as 7 linhas de um glifo para as 16 linhas da grelha (linhas com 2,2,2,3,2,2,3 bits)
+#define OCR_GLYPH(r0, r1, r2, r3, r4, r5, r6) { { \
+        OCR_ROW(r0), OCR_ROW(r0), OCR_ROW(r1), OCR_ROW(r1), OCR_ROW(r2), OCR_ROW(r2), \
+        OCR_ROW(r3), OCR_ROW(r3), OCR_ROW(r3), OCR_ROW(r4), OCR_ROW(r4), OCR_ROW(r5), \
+        OCR_ROW(r5), OCR_ROW(r6), OCR_ROW(r6), OCR_ROW(r6) } }
+
+typedef struct {
+    char symbol;
+    int classes;
+    VC_OCR_BITS bits;
+} OCR_TEMPLATE;
+
+// Templates dos caracteres reais de Imagem01 e Imagem03 (caracteres_N.ppm de
+// examples_output/01 e 03 normalizados por vc_ocr_pack) e, para todos os simbolos,
+// glifos 5x7 com os digitos desenhados à maneira da fonte das matriculas (4 aberto,
+// 1 sem base). Imagem02 e Imagem04 não entram nos templates: são as imagens com
+// que bench -D / -G verifica o reconhecimento
+static const OCR_TEMPLATE templates[] = {
+        { '4', VC_OCR_DIGITS,  { { 0x1F00, 0x1F00, 0x0F80, 0x07C0, 0x03E0, 0x01F0, 0x00F8, 0x00F8,
+                                   0x1C78, 0x1C3C, 0x1C1F, 0xFFFF, 0xFFFF, 0xFFFF, 0x3C00, 0x3C00 } } }, // Imagem01
+        { '4', VC_OCR_DIGITS,  { { 0x0F80, 0x0FC0, 0x07C0, 0x03E0, 0x01F0, 0x01F0, 0x00F0, 0x0078,
+                                   0x003C, 0x1C3E, 0x1C1F, 0xFFFF, 0xFFFF, 0xFFFF, 0x3C00, 0x1C00 } } }, // Imagem03
+        { '6', VC_OCR_DIGITS,  { { 0x0FF0, 0x1FFE, 0xFFFE, 0xF81F, 0xF00F, 0x000F, 0x1FFF, 0x7FFF,
+                                   0xFE7F, 0xF81F, 0xF00F, 0xF00F, 0xF01F, 0xFC7F, 0x7FFE, 0x1FF8 } } }, // Imagem03
+        { '8', VC_OCR_DIGITS,  { { 0x1FF8, 0x3FFC, 0x7FFE, 0x781E, 0xF00F, 0xF01E, 0xFC3E, 0x7FFC,
+                                   0x3FFC, 0x7E7E, 0xF81F, 0xF00F, 0xF81E, 0x7FFE, 0x7FF8, 0x1FF0 } } }, // Imagem01
+        { '8', VC_OCR_DIGITS,  { { 0x0FE0, 0x7FFC, 0x7EFC, 0xF01E, 0xF00F, 0xF01E, 0xF01E, 0x7FFC,
+                                   0x7FFC, 0x7E7C, 0xF01E, 0xF00E, 0xF01E, 0x7C7C, 0x7FFC, 0x1FF0 } } }, // Imagem03
+        { '9', VC_OCR_DIGITS,  { { 0x0FF0, 0x3FF8, 0x7FFE, 0xFC3E, 0xF01F, 0xF01F, 0xFC7E, 0xFFFC,
+                                   0xFFF8, 0xFFC0, 0xF000, 0xF00E, 0xF81E, 0xFFFE, 0x3FFC, 0x1FF0 } } }, // Imagem01
+        { 'F', VC_OCR_LETTERS, { { 0xFFFF, 0xFFFF, 0xFFFF, 0x0007, 0x0007, 0x0007, 0x000F, 0x1FFF,
+                                   0x1FFF, 0x000F, 0x0007, 0x0007, 0x0007, 0x0007, 0x0007, 0x0007 } } }, // Imagem01
+        { 'N', VC_OCR_LETTERS, { { 0xF00F, 0xF00F, 0xE01F, 0xE03F, 0xE07F, 0xE0FF, 0xE1F7, 0xE1E7,
+                                   0xE3C7, 0xFF87, 0xFF07, 0xFE07, 0xFE07, 0xFC07, 0xF807, 0xF007 } } }, // Imagem03
+        { 'Q', VC_OCR_LETTERS, { { 0x0FF0, 0x3FFC, 0x7FFE, 0x780E, 0xF00F, 0xF007, 0xE007, 0xE007,
+                                   0xE007, 0xFC07, 0xFE07, 0xFC0F, 0x780F, 0x7E7E, 0xFFFC, 0xFFF0 } } }, // Imagem03
+        { 'S', VC_OCR_LETTERS, { { 0x0FF8, 0x3FFE, 0x7FFE, 0x780F, 0x7007, 0x000F, 0x003F, 0x1FFE,
+                                   0x7FFF, 0x7FE3, 0x7800, 0xF007, 0xF80F, 0x7FFE, 0x7FFE, 0x1FF8 } } }, // Imagem01
+        { '0', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E) },
+        { '1', VC_OCR_DIGITS,  OCR_GLYPH(0x06, 0x0E, 0x06, 0x06, 0x06, 0x06, 0x06) },
+        { '2', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F) },
+        { '3', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x01, 0x06, 0x01, 0x11, 0x0E) },
+        { '4', VC_OCR_DIGITS,  OCR_GLYPH(0x06, 0x04, 0x0C, 0x1A, 0x12, 0x1F, 0x02) },
+        { '5', VC_OCR_DIGITS,  OCR_GLYPH(0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E) },
+        { '6', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x10, 0x1E, 0x11, 0x11, 0x0E) },
+        { '7', VC_OCR_DIGITS,  OCR_GLYPH(0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08) },
+        { '8', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E) },
+        { '9', VC_OCR_DIGITS,  OCR_GLYPH(0x0E, 0x11, 0x11, 0x0F, 0x01, 0x11, 0x0E) },
+        { 'A', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11) },
+        { 'B', VC_OCR_LETTERS, OCR_GLYPH(0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E) },
+        { 'C', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E) },
+        { 'D', VC_OCR_LETTERS, OCR_GLYPH(0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C) },
+        { 'E', VC_OCR_LETTERS, OCR_GLYPH(0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F) },
+        { 'F', VC_OCR_LETTERS, OCR_GLYPH(0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10) },
+        { 'G', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x10, 0x13, 0x11, 0x11, 0x0E) },
+        { 'H', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11) },
+        { 'I', VC_OCR_LETTERS, OCR_GLYPH(0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04) },
+        { 'J', VC_OCR_LETTERS, OCR_GLYPH(0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C) },
+        { 'K', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11) },
+        { 'L', VC_OCR_LETTERS, OCR_GLYPH(0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F) },
+        { 'M', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11) },
+        { 'N', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11) },
+        { 'O', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E) },
+        { 'P', VC_OCR_LETTERS, OCR_GLYPH(0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10) },
+        { 'Q', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D) },
+        { 'R', VC_OCR_LETTERS, OCR_GLYPH(0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11) },
+        { 'S', VC_OCR_LETTERS, OCR_GLYPH(0x0E, 0x11, 0x10, 0x0E, 0x01, 0x11, 0x0E) },
+        { 'T', VC_OCR_LETTERS, OCR_GLYPH(0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04) },
+        { 'U', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E) },
+        { 'V', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04) },
+        { 'W', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A) },
+        { 'X', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11) },
+        { 'Y', VC_OCR_LETTERS, OCR_GLYPH(0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04) },
+        { 'Z', VC_OCR_LETTERS, OCR_GLYPH(0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F) },
+};
+
+#define OCR_NTEMPLATES ((int)(sizeof(templates) / sizeof(OCR_TEMPLATE)))
+
+/**
+ * Normaliza um caracter para a grelha de bits. Cada celula amostra o pixel do
+ * centro da região correspondente do blob. Caracteres estreitos (ex: 1) são
+ * centrados numa caixa com largura minima de 45% da altura para não serem esticados
+ * @param src imagem binária de 1 canal (caracter != 0)
+ * @param blob bounding box do caracter em src
+ * @param bits
+ * @return 0 em caso de erro
+ */
+int vc_ocr_pack(IVC *src, OVC blob, VC_OCR_BITS *bits) {
+    int box_width, box_x;
+    int xs[VC_OCR_GRID];
+    uint16_t valid = 0;
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if (src->channels != 1) return 0;
+    if ((blob.width <= 0) || (blob.height <= 0)) return 0;
+
+    box_width = blob.width;
+    if (box_width * 100 < blob.height * 45) box_width = (blob.height * 45) / 100;
+    box_x = blob.x - (box_width - blob.width) / 2;
+
+    // Colunas amostradas, iguais para todas as linhas. As que caem fora do
+    // blob ficam a 0 na mascara (e apontam para blob.x para não haver saltos)
+    for (int gx = 0; gx < VC_OCR_GRID; gx++) {
+        int x = box_x + ((2 * gx + 1) * box_width) / (2 * VC_OCR_GRID);
+        int inside = (x >= blob.x && x < blob.x + blob.width && x < src->width);
+        xs[gx] = inside ? x : blob.x;
+        valid |= (uint16_t)(inside << gx);
+    }
+
+    memset(bits, 0, sizeof(VC_OCR_BITS));
+
+    for (int gy = 0; gy < VC_OCR_GRID; gy++) {
+        int y = blob.y + ((2 * gy + 1) * blob.height) / (2 * VC_OCR_GRID);
+
+        if (y < 0 || y >= src->height) continue;
+
+        // Um bit por amostra != 0 (kernel SSE2 ou escalar, conforme o processador)
+        bits->rows[gy] = kernels->pack16(src->data + y * src->bytesperline, xs) & valid;
+    }
+    return 1;
+}
+
+/**
+ * Contagem de bits a 1 (SWAR), sem depender da instrução popcnt
+ */
+static inline int ocr_popcount64(uint64_t v) {
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+}
+
+/**
+ * Distância de Hamming entre dois caracteres normalizados
+ * @param a
+ * @param b
+ * @return numero de bits diferentes
+ */
+int vc_ocr_distance(const VC_OCR_BITS *a, const VC_OCR_BITS *b) {
+    return ocr_popcount64(a->words[0] ^ b->words[0]) +
+           ocr_popcount64(a->words[1] ^ b->words[1]) +
+           ocr_popcount64(a->words[2] ^ b->words[2]) +
+           ocr_popcount64(a->words[3] ^ b->words[3]);
+}
+
+/**
+ * Procura o template mais próximo (distância de Hamming: XOR + popcount)
+ */
+#define OCR_BEST_TEMPLATE(popcount) \
+    int best = INT_MAX, best_t = -1; \
+    for (int t = 0; t < OCR_NTEMPLATES; t++) { \
+        const VC_OCR_BITS *b = &templates[t].bits; \
+        int d = 0; \
+        if (!(templates[t].classes & classes)) continue; \
+        for (int w = 0; w < VC_OCR_GRID / 4; w++) d += popcount(a->words[w] ^ b->words[w]); \
+        if (d < best) { \
+            best = d; \
+            best_t = t; \
+        } \
+    } \
+    *distance = best; \
+    return best_t;
+
+static int ocr_best_template(const VC_OCR_BITS *a, int classes, int *distance) {
+    OCR_BEST_TEMPLATE(ocr_popcount64)
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Mesma procura compilada com a instrução popcnt, escolhida em runtime
+__attribute__((target("popcnt")))
+static int ocr_best_template_popcnt(const VC_OCR_BITS *a, int classes, int *distance) {
+    OCR_BEST_TEMPLATE(__builtin_popcountll)
+}
+#endif
+
+static int (*ocr_best_fn)(const VC_OCR_BITS *, int, int *) = ocr_best_template;
+static pthread_once_t templates_once = PTHREAD_ONCE_INIT;
+
+static void ocr_init_templates(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt")) ocr_best_fn = ocr_best_template_popcnt;
+#endif
+}
+
+/**
+ * Procura o template mais próximo de um caracter
+ * @param bits
+ * @param classes VC_OCR_DIGITS, VC_OCR_LETTERS ou VC_OCR_ANY
+ * @param distance distância ao template escolhido (pode ser NULL)
+ * @return simbolo reconhecido ou '?'
+ */
+char vc_ocr_match(const VC_OCR_BITS *bits, int classes, int *distance) {
+    int best, t;
+
+    pthread_once(&templates_once, ocr_init_templates);
+    t = ocr_best_fn(bits, classes, &best);
+
+    if (distance != NULL) *distance = best;
+    return (t < 0) ? '?' : templates[t].symbol;
+}
+
+/**
+ * Reconhece os caracteres de uma matricula. Os caracteres são ordenados da
+ * esquerda para a direita e agrupados aos pares (formato AA-00-00, 00-AA-00 ou
+ * 00-00-AA): cada par é lido todo como letras ou todo como digitos, conforme a
+ * soma das distâncias for menor
+ * @param src imagem binária de 1 canal onde estão os caracteres
+ * @param chars bounding boxes dos caracteres
+ * @param nchars numero de caracteres
+ * @param text texto reconhecido (nchars + 1 posições)
+ * @return 0 em caso de erro
+ */
+int vc_ocr_plate(IVC *src, OVC *chars, int nchars, char *text) {
+    OVC sorted[16];
+    VC_OCR_BITS bits[16];
+
+    if (nchars <= 0 || nchars > 16) return 0;
+
+    // Ordena por x (insertion sort, poucos elementos)
+    for (int i = 0; i < nchars; i++) {
+        OVC c = chars[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j].x > c.x) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = c;
+    }
+
+    for (int i = 0; i < nchars; i++) {
+        if (!vc_ocr_pack(src, sorted[i], &bits[i])) return 0;
+    }
+
+    for (int i = 0; i < nchars; i += 2) {
+        int n = (i + 1 < nchars) ? 2 : 1;
+        int dd = 0, dl = 0, d;
+        char digits[2], letters[2];
+
+        for (int k = 0; k < n; k++) {
+            digits[k] = vc_ocr_match(&bits[i + k], VC_OCR_DIGITS, &d);
+            dd += d;
+            letters[k] = vc_ocr_match(&bits[i + k], VC_OCR_LETTERS, &d);
+            dl += d;
+        }
+        for (int k = 0; k < n; k++) text[i + k] = (dd <= dl) ? digits[k] : letters[k];
+    }
+    text[nchars] = 0;
+
+    return 1;
+}
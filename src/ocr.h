@@ -0,0 +1,38 @@
+/**
+ * Este ficheiro contem as assinaturas das funções de reconhecimento de caracteres
+ * @brief Reconhecimento de caracteres por comparação de templates binários (XOR + popcount)
+ * @file ocr.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_OCR_H
+#define VC_TP1_13871_14383_17442_OCR_H
+
+#include <stdint.h>
+#include "vc.h"
+
+// Grelha normalizada de cada caracter (16x16 bits)
+#define VC_OCR_GRID 16
+
+// Classes de caracteres
+#define VC_OCR_DIGITS 1
+#define VC_OCR_LETTERS 2
+#define VC_OCR_ANY (VC_OCR_DIGITS | VC_OCR_LETTERS)
+
+/**
+ * Caracter normalizado: uma linha da grelha por cada uint16, lido em blocos de 64 bits
+ */
+typedef union {
+    uint16_t rows[VC_OCR_GRID];
+    uint64_t words[VC_OCR_GRID / 4];
+} VC_OCR_BITS;
+
+int vc_ocr_pack(IVC *src, OVC blob, VC_OCR_BITS *bits);
+int vc_ocr_distance(const VC_OCR_BITS *a, const VC_OCR_BITS *b);
+char vc_ocr_match(const VC_OCR_BITS *bits, int classes, int *distance);
+int vc_ocr_plate(IVC *src, OVC *chars, int nchars, char *text);
+
+#endif //VC_TP1_13871_14383_17442_OCR_H
@@ -0,0 +1,266 @@
+/**
+ * Este ficheiro contem o executor do pipeline declarativo de processamento
+ * @brief Executor de estágios com cálculo de liveness e reciclagem de buffers
+ * @file pipeline.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memcpy()
+#include <stdlib.h> // free()
+#include "pipeline.h"
+#include "plate-recognizer.h"
+#include "stats.h"
+
+/**
+ * Inicializa um pipeline a partir de uma lista de estágios
+ * @param p
+ * @param stages
+ * @param nstages
+ */
+void vc_pipeline_init(VC_PIPELINE *p, const VC_STAGE *stages, int nstages) {
+    memset(p, 0, sizeof(VC_PIPELINE));
+    p->stages = stages;
+    p->nstages = nstages;
+    p->hist_ref = -1;
+    for (int r = 0; r < VC_PIPELINE_MAX_REFS; r++) p->map[r] = -1;
+}
+
+/**
+ * Marca uma ref para sobreviver ao fim do run (para ser lida com vc_pipeline_buffer)
+ * @param p
+ * @param ref
+ */
+void vc_pipeline_keep(VC_PIPELINE *p, int ref) {
+    if (ref > 0 && ref < VC_PIPELINE_MAX_REFS) p->keep[ref] = 1;
+}
+
+/**
+ * Devolve o buffer associado a uma ref
+ * @param p
+ * @param ref
+ * @return NULL se a ref não estiver viva
+ */
+IVC *vc_pipeline_buffer(VC_PIPELINE *p, int ref) {
+    if (ref == VC_PIPELINE_INPUT) return p->input;
+    if (ref < 0 || ref >= VC_PIPELINE_MAX_REFS || p->map[ref] < 0) return NULL;
+    return p->pool[p->map[ref]];
+}
+
+/**
+ * Vai buscar ao pool um buffer livre com as dimensões pedidas ou aloca um novo
+ * @return indice no pool ou -1
+ */
+static int pipeline_acquire(VC_PIPELINE *p, int width, int height, int channels, int levels) {
+    for (int b = 0; b < p->npool; b++) {
+        IVC *buf = p->pool[b];
+        if (!p->pool_busy[b] && buf->width == width && buf->height == height &&
+            buf->channels == channels) {
+            buf->levels = levels;
+            p->pool_busy[b] = 1;
+            return b;
+        }
+    }
+
+    IVC *buf = vc_image_new(width, height, channels, levels);
+    if (buf == NULL) return -1;
+
+    // Pool cheio: substitui um buffer livre com outras dimensões
+    if (p->npool >= VC_PIPELINE_MAX_BUFFERS) {
+        for (int b = 0; b < p->npool; b++) {
+            if (!p->pool_busy[b]) {
+                vc_image_free(p->pool[b]);
+                p->pool[b] = buf;
+                p->pool_busy[b] = 1;
+                return b;
+            }
+        }
+        vc_image_free(buf);
+        return -1;
+    }
+
+    p->pool[p->npool] = buf;
+    p->pool_busy[p->npool] = 1;
+    return p->npool++;
+}
+
+/**
+ * Threshold a usar num estágio de binarização
+ */
+static int pipeline_threshold(VC_PIPELINE *p, const VC_STAGE *s, IVC *src) {
+    if (p->threshold_mode == VC_THRESHOLD_FIXED) return s->param;
+
+    // Só percorre a imagem se o histograma não corresponder já ao buffer
+    if (p->hist_ref != s->src) {
+        if (!vc_histogram(src, &p->hist)) return s->param;
+        p->hist_ref = s->src;
+    }
+
+    if (p->threshold_mode == VC_THRESHOLD_PERCENTILE) return vc_histogram_percentile(&p->hist, p->threshold_percentile);
+    return vc_histogram_otsu(&p->hist);
+}
+
+/**
+ * Raio de um estágio de mediana (0 copia ou, in-place, não faz nada)
+ */
+static int pipeline_median_radius(VC_PIPELINE *p, const VC_STAGE *s) {
+    if (s->param > 0) return s->param;
+    return (p->median_radius > 0) ? p->median_radius : 0;
+}
+
+/**
+ * Executa um estágio sobre os buffers já resolvidos
+ * @return 0 em caso de erro
+ */
+static int pipeline_exec(VC_PIPELINE *p, const VC_STAGE *s, IVC *src, IVC *dst) {
+    switch (s->op) {
+        case VC_OP_DUMP:
+            return 1;
+        case VC_OP_COPY:
+            memcpy(dst->data, src->data, src->bytesperline * src->height);
+            return 1;
+        case VC_OP_COLOR_REMOVE:
+            return vc_color_remove(dst, s->param, s->param2);
+        case VC_OP_RGB_TO_GRAY:
+            if (p->threshold_mode == VC_THRESHOLD_FIXED) return vc_rgb_to_gray(src, dst);
+            p->hist_ref = s->dst;
+            return vc_rgb_to_gray_histogram(src, dst, &p->hist);
+        case VC_OP_BRIGTEN:
+            if (p->hist_ref == s->dst) vc_histogram_add(&p->hist, s->param);
+            return vc_brigten(dst, s->param);
+        case VC_OP_GRAY_TO_BINARY:
+            p->last_threshold = pipeline_threshold(p, s, src);
+            return vc_gray_to_binary(src, dst, p->last_threshold);
+        case VC_OP_BINARY_DILATE:
+            return vc_binary_dilate(src, dst, s->param);
+        case VC_OP_BINARY_ERODE:
+            return vc_binary_erode(src, dst, s->param);
+        case VC_OP_BINARY_CLOSE:
+            return vc_binary_close(src, dst, s->param);
+        case VC_OP_INVERT:
+            invertImageBinary(dst);
+            return 1;
+        case VC_OP_MEDIAN:
+            return vc_gray_median(src, dst, pipeline_median_radius(p, s));
+        case VC_OP_BOX_BLUR:
+            return vc_box_blur(src, dst, s->param);
+        case VC_OP_GAUSSIAN_BLUR:
+            return vc_gaussian_blur(src, dst, s->param);
+        case VC_OP_SOBEL_X:
+            return vc_gray_sobel_x(src, dst);
+        case VC_OP_BOX_BLUR_X:
+            return vc_box_blur_x(src, dst, s->param);
+        case VC_OP_BLOB_LABELLING:
+            free(p->blobs);
+            p->nblobs = 0;
+            p->blobs = vc_binary_blob_labelling(src, dst, &p->nblobs);
+            // Só falha se o prazo (vc_deadline) passar a meio
+            if (!vc_binary_blob_info(dst, p->blobs, p->nblobs)) {
+                p->nblobs = 0;
+                return 0;
+            }
+            return 1;
+        case VC_OP_COUNT:
+        default:
+            // Operação inválida: o pipeline falha em vez de saltar o estágio
+            return 0;
+    }
+}
+
+/**
+ * Executa todos os estágios do pipeline sobre a imagem de entrada.
+ * Antes de executar calcula o ultimo estágio que usa cada ref; depois desse
+ * estágio o buffer fisico volta ao pool e pode ser reutilizado pelo seguinte
+ * @param p
+ * @param input imagem de entrada (ref VC_PIPELINE_INPUT)
+ * @return 1 se todos os estágios correram (0 em erro ou se o prazo vc_deadline passou)
+ */
+int vc_pipeline_run(VC_PIPELINE *p, IVC *input) {
+    int lastuse[VC_PIPELINE_MAX_REFS];
+
+    // Verificação de erros
+    if ((input == NULL) || (input->width <= 0) || (input->height <= 0) || (input->data == NULL)) return 0;
+
+    // Liveness: ultimo estágio onde cada ref é lida ou escrita
+    for (int r = 0; r < VC_PIPELINE_MAX_REFS; r++) {
+        lastuse[r] = p->keep[r] ? p->nstages : -1;
+        p->map[r] = -1;
+    }
+    for (int i = 0; i < p->nstages; i++) {
+        const VC_STAGE *s = &p->stages[i];
+        if (s->src < 0 || s->src >= VC_PIPELINE_MAX_REFS || s->dst < 0 || s->dst >= VC_PIPELINE_MAX_REFS) return 0;
+        if (lastuse[s->src] < i) lastuse[s->src] = i;
+        if (lastuse[s->dst] < i) lastuse[s->dst] = i;
+    }
+    for (int b = 0; b < p->npool; b++) p->pool_busy[b] = 0;
+
+    p->input = input;
+    p->live_buffers = 0;
+    p->hist_ref = -1;
+
+    for (int i = 0; i < p->nstages; i++) {
+        const VC_STAGE *s = &p->stages[i];
+        IVC *src = vc_pipeline_buffer(p, s->src);
+
+        if (src == NULL) return 0;
+
+        // Prazo da thread ultrapassado: os estágios seguintes não correm
+        if (vc_deadline_expired()) return 0;
+
+        // Resolve o buffer de saida
+        if (s->dst != VC_PIPELINE_INPUT && p->map[s->dst] < 0) {
+            int keep_channels = (s->op == VC_OP_COPY) || (s->op == VC_OP_BOX_BLUR) || (s->op == VC_OP_GAUSSIAN_BLUR) ||
+                                (s->op == VC_OP_BOX_BLUR_X);
+            int channels = keep_channels ? src->channels : 1;
+            int b = pipeline_acquire(p, input->width, input->height, channels, input->levels);
+            if (b < 0) return 0;
+            p->map[s->dst] = b;
+            p->live_buffers++;
+            if (p->live_buffers > p->peak_buffers) p->peak_buffers = p->live_buffers;
+        }
+        IVC *dst = vc_pipeline_buffer(p, s->dst);
+
+        // Qualquer outra escrita no buffer invalida o histograma. Uma mediana in-place de raio 0
+        // não escreve nem conta nas medições
+        int median_noop = (s->op == VC_OP_MEDIAN) && (s->src == s->dst) && (pipeline_median_radius(p, s) <= 0);
+        if (s->dst == p->hist_ref && s->op != VC_OP_RGB_TO_GRAY && s->op != VC_OP_BRIGTEN && s->op != VC_OP_DUMP && !median_noop) {
+            p->hist_ref = -1;
+        }
+
+        if (!median_noop) {
+            VC_STATS_START(t);
+            if (!pipeline_exec(p, s, src, dst)) return 0;
+            VC_STATS_STOP_OP(s->op, t);
+        }
+
+        if (s->dump != NULL && p->dump_dir != NULL) debugSave(p->dump_dir, (char *)s->dump, s->dump_id, s->op == VC_OP_DUMP ? src : dst);
+
+        // Liberta os buffers que morreram neste estágio
+        for (int r = 1; r < VC_PIPELINE_MAX_REFS; r++) {
+            if (lastuse[r] == i && p->map[r] >= 0) {
+                p->pool_busy[p->map[r]] = 0;
+                p->map[r] = -1;
+                p->live_buffers--;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Liberta todos os buffers do pool e os blobs
+ * @param p
+ */
+void vc_pipeline_free(VC_PIPELINE *p) {
+    for (int b = 0; b < p->npool; b++) {
+        vc_image_free(p->pool[b]);
+        p->pool[b] = NULL;
+    }
+    p->npool = 0;
+    free(p->blobs);
+    p->blobs = NULL;
+    p->nblobs = 0;
+    for (int r = 0; r < VC_PIPELINE_MAX_REFS; r++) p->map[r] = -1;
+}
@@ -0,0 +1,99 @@
+/**
+ * Este ficheiro contem a definição do pipeline declarativo de processamento
+ * @brief Pipeline de estágios com gestão automática do tempo de vida dos buffers
+ * @file pipeline.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_PIPELINE_H
+#define VC_TP1_13871_14383_17442_PIPELINE_H
+
+#include "vc.h"
+#include "histogram.h"
+
+// Numero maximo de buffers virtuais (refs) e fisicos de um pipeline
+#define VC_PIPELINE_MAX_REFS 16
+#define VC_PIPELINE_MAX_BUFFERS 16
+
+// Referencia reservada para a imagem de entrada do pipeline
+#define VC_PIPELINE_INPUT 0
+
+/**
+ * Operações suportadas por um estágio
+ */
+typedef enum {
+    VC_OP_DUMP,             // Apenas grava o buffer src
+    VC_OP_COPY,             // Copia src para dst
+    VC_OP_COLOR_REMOVE,     // In-place: param = threshold, param2 = cor
+    VC_OP_RGB_TO_GRAY,      // src (3 canais) -> dst (1 canal)
+    VC_OP_BRIGTEN,          // In-place: param = valor
+    VC_OP_GRAY_TO_BINARY,   // param = threshold (ignorado com threshold automático)
+    VC_OP_BINARY_DILATE,    // param = kernel
+    VC_OP_BINARY_ERODE,     // param = kernel
+    VC_OP_BINARY_CLOSE,     // param = kernel
+    VC_OP_INVERT,           // In-place
+    VC_OP_BLOB_LABELLING,   // dst = imagem de labels, preenche blobs/nblobs
+    VC_OP_MEDIAN,           // Cinzentos: param = raio (0 usa median_radius do pipeline; raio 0 não faz nada)
+    VC_OP_BOX_BLUR,         // 1 ou 3 canais: param = raio
+    VC_OP_GAUSSIAN_BLUR,    // 1 ou 3 canais: param = raio de cada uma das três médias
+    VC_OP_SOBEL_X,          // Cinzentos: gradiente horizontal |Gx| (src e dst diferentes)
+    VC_OP_BOX_BLUR_X,       // 1 ou 3 canais: média horizontal, param = raio
+    VC_OP_COUNT             // Numero de operações
+} VC_OP;
+
+/**
+ * Descritor de um estágio: operação, parametros e refs de entrada/saída.
+ * Se dump != NULL o buffer de saída é gravado com debugSave(dump_dir, dump, dump_id)
+ */
+typedef struct {
+    VC_OP op;
+    int src, dst;
+    int param, param2;
+    const char *dump;
+    int dump_id;
+} VC_STAGE;
+
+/**
+ * Estado do executor. Os buffers fisicos ficam no pool entre execuções
+ * e são reciclados assim que o buffer virtual que os ocupa deixa de ser usado
+ */
+typedef struct {
+    const VC_STAGE *stages;
+    int nstages;
+
+    IVC *pool[VC_PIPELINE_MAX_BUFFERS];
+    int pool_busy[VC_PIPELINE_MAX_BUFFERS];
+    int npool;
+
+    int map[VC_PIPELINE_MAX_REFS];      // ref -> indice no pool (-1 se não mapeado)
+    int keep[VC_PIPELINE_MAX_REFS];     // refs que sobrevivem ao fim do run
+    IVC *input;
+
+    OVC *blobs;
+    int nblobs;
+
+    const char *dump_dir;               // Directorio dos dumps dos estágios (NULL não grava)
+
+    // Threshold automático: o histograma é calculado na conversão para cinzentos
+    // e acompanha os clareamentos seguintes sem voltar a ler a imagem
+    int threshold_mode;                 // VC_THRESHOLD_FIXED, _OTSU ou _PERCENTILE
+    float threshold_percentile;
+    VC_HISTOGRAM hist;
+    int hist_ref;                       // ref cujo conteudo o histograma descreve (-1 nenhuma)
+    int last_threshold;
+
+    int median_radius;                  // Raio dos estágios de mediana com param 0 (0 desliga)
+
+    int live_buffers, peak_buffers;
+} VC_PIPELINE;
+
+void vc_pipeline_init(VC_PIPELINE *p, const VC_STAGE *stages, int nstages);
+void vc_pipeline_keep(VC_PIPELINE *p, int ref);
+int vc_pipeline_run(VC_PIPELINE *p, IVC *input);
+IVC *vc_pipeline_buffer(VC_PIPELINE *p, int ref);
+void vc_pipeline_free(VC_PIPELINE *p);
+
+#endif //VC_TP1_13871_14383_17442_PIPELINE_H
@@ -0,0 +1,181 @@
+/**
+ * Este ficheiro contem o layout planar (SoA) das imagens RGB
+ * @brief Três planos R, G, B alinhados a 64 bytes, conversão de/para IVC intercalado e kernels de cor
+ * @file planar.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Os kernels dão exactamente o mesmo resultado que vc_color_remove(), vc_rgb_to_gray() e vc_brigten()
+ * sobre a imagem intercalada, incluindo as particularidades dessas funções
+ */
+
+#include <stdlib.h> // aligned_alloc()
+#include <string.h>
+#include "planar.h"
+#include "cpu.h"
+
+/**
+ * Aloca uma imagem planar (conteudo a 0)
+ * @param width
+ * @param height
+ * @return NULL em caso de erro
+ */
+VC_PLANAR *vc_planar_new(int width, int height) {
+    VC_PLANAR *image;
+    size_t size;
+
+    if ((width <= 0) || (height <= 0)) return NULL;
+
+    image = (VC_PLANAR *)malloc(sizeof(VC_PLANAR));
+    if (image == NULL) return NULL;
+
+    image->width = width;
+    image->height = height;
+    // + 1: a remoção de cor lê o byte depois do ultimo pixel da linha
+    image->stride = ((width + 1 + VC_PLANAR_ALIGN - 1) / VC_PLANAR_ALIGN) * VC_PLANAR_ALIGN;
+
+    size = (size_t)image->stride * height;
+    image->data = (unsigned char *)aligned_alloc(VC_PLANAR_ALIGN, 3 * size);
+    if (image->data == NULL) return vc_planar_free(image);
+    memset(image->data, 0, 3 * size);
+
+    for (int c = 0; c < 3; c++) image->plane[c] = image->data + c * size;
+
+    return image;
+}
+
+/**
+ * Liberta uma imagem planar
+ * @param image
+ * @return NULL
+ */
+VC_PLANAR *vc_planar_free(VC_PLANAR *image) {
+    if (image != NULL) {
+        free(image->data);
+        free(image);
+    }
+    return NULL;
+}
+
+/**
+ * Separa uma imagem RGB intercalada nos três planos
+ * @param src imagem de 3 canais
+ * @param dst imagem planar do mesmo tamanho
+ * @return 0 em caso de erro
+ */
+int vc_planar_from_interleaved(IVC *src, VC_PLANAR *dst) {
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 3)) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        long int off = (long int)y * dst->stride;
+        kernels->deinterleave(src->data + y * src->bytesperline,
+                              dst->plane[0] + off, dst->plane[1] + off, dst->plane[2] + off, src->width);
+    }
+    return 1;
+}
+
+/**
+ * Junta os três planos numa imagem RGB intercalada
+ * @param src imagem planar
+ * @param dst imagem de 3 canais do mesmo tamanho
+ * @return 0 em caso de erro
+ */
+int vc_planar_to_interleaved(VC_PLANAR *src, IVC *dst) {
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((dst->width <= 0) || (dst->height <= 0) || (dst->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 3)) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        long int off = (long int)y * src->stride;
+        kernels->interleave(src->plane[0] + off, src->plane[1] + off, src->plane[2] + off,
+                            dst->data + y * dst->bytesperline, src->width);
+    }
+    return 1;
+}
+
+/**
+ * Remoção de cor como vc_color_remove(): o azul de cada pixel é o vermelho do pixel seguinte.
+ * No fim de cada linha esse é o primeiro vermelho da linha seguinte, copiado antes para a margem
+ * do plano R; depois do ultimo pixel da imagem vale 0
+ * @param image
+ * @param threshold
+ * @param color
+ * @return 0 em caso de erro
+ */
+int vc_planar_color_remove(VC_PLANAR *image, int threshold, int color) {
+    const VC_KERNELS *kernels = vc_kernels();
+    unsigned char *r = image->plane[0];
+    int width = image->width;
+    int stride = image->stride;
+
+    // Verificação de erros
+    if ((image->width <= 0) || (image->height <= 0) || (image->data == NULL)) return 0;
+
+    for (int y = 0; y < image->height; y++) {
+        r[(long int)y * stride + width] = (y + 1 < image->height) ? r[(long int)(y + 1) * stride] : 0;
+    }
+
+    for (int y = 0; y < image->height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        long int off = (long int)y * stride;
+        kernels->color_remove_planar(r + off, image->plane[1] + off, image->plane[2] + off, width, threshold, color);
+    }
+    return 1;
+}
+
+/**
+ * Conversão para cinzentos, igual a vc_rgb_to_gray()
+ * @param src imagem planar
+ * @param dst imagem de 1 canal do mesmo tamanho
+ * @return 0 em caso de erro
+ */
+int vc_planar_to_gray(VC_PLANAR *src, IVC *dst) {
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((dst->width <= 0) || (dst->height <= 0) || (dst->data == NULL)) return 0;
+    if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 1)) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        long int off = (long int)y * src->stride;
+        kernels->gray_planar(src->plane[0] + off, src->plane[1] + off, src->plane[2] + off,
+                             dst->data + y * dst->bytesperline, src->width);
+    }
+    return 1;
+}
+
+/**
+ * Clareamento como vc_brigten() numa imagem de 3 canais
+ * @param image
+ * @param value
+ * @return 0 em caso de erro
+ */
+int vc_planar_brigten(VC_PLANAR *image, int value) {
+    const VC_KERNELS *kernels = vc_kernels();
+
+    // Verificação de erros
+    if ((image->width <= 0) || (image->height <= 0) || (image->data == NULL)) return 0;
+
+    for (int y = 0; y < image->height; y++) {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
+        long int off = (long int)y * image->stride;
+        kernels->brigten_planar(image->plane[0] + off, image->plane[1] + off, image->plane[2] + off, image->width, value);
+    }
+    return 1;
+}
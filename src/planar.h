@@ -0,0 +1,40 @@
+/**
+ * Este ficheiro contem as assinaturas do layout planar (SoA) das imagens RGB
+ * @brief Três planos R, G, B alinhados a 64 bytes, conversão de/para IVC intercalado e kernels de cor
+ * @file planar.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#ifndef VC_TP1_13871_14383_17442_PLANAR_H
+#define VC_TP1_13871_14383_17442_PLANAR_H
+
+#include "vc.h"
+
+// Alinhamento dos planos e das linhas (uma linha de cache, um registo AVX-512)
+#define VC_PLANAR_ALIGN 64
+
+/**
+ * Imagem RGB com um plano por canal. Cada linha tem stride bytes (multiplo de VC_PLANAR_ALIGN
+ * e maior que width), por isso todas as linhas começam alinhadas e há pelo menos um byte de margem
+ */
+typedef struct {
+    int width, height;
+    int stride;                     // Bytes por linha de cada plano
+    unsigned char *plane[3];        // R, G, B
+    unsigned char *data;            // Bloco único com os três planos
+} VC_PLANAR;
+
+VC_PLANAR *vc_planar_new(int width, int height);
+VC_PLANAR *vc_planar_free(VC_PLANAR *image);
+
+int vc_planar_from_interleaved(IVC *src, VC_PLANAR *dst);
+int vc_planar_to_interleaved(VC_PLANAR *src, IVC *dst);
+
+int vc_planar_color_remove(VC_PLANAR *image, int threshold, int color);
+int vc_planar_to_gray(VC_PLANAR *src, IVC *dst);
+int vc_planar_brigten(VC_PLANAR *image, int value);
+
+#endif //VC_TP1_13871_14383_17442_PLANAR_H
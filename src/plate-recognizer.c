@@ -17,13 +17,97 @@
 #include <stdio.h> // puts() printf
 #include <math.h>
 #include "plate-recognizer.h"
+#include "pipeline.h"
+#include "cpu.h"
+#include "ocr.h"
+#include "stats.h"
+#include "threadpool.h"
 
-char output_dir[PATH_MAX] = "";
+/**
+ * Pipeline de procura de potenciais matriculas na imagem completa
+ * Refs: 0 original, 1 copia sem cores, 2 cinzentos, 3 binária, 4 fecho, 5 dilatação, 6 labels.
+ * A mediana só corre com median_radius > 0 (ruído sal e pimenta das imagens nocturnas)
+ */
+static const VC_STAGE main_stages[] = {
+        { VC_OP_COPY,           0, 1, 0,   0,   "original",          1 },
+        { VC_OP_COLOR_REMOVE,   1, 1, 12,  250, "main_color_remove", 2 },
+        { VC_OP_RGB_TO_GRAY,    1, 2, 0,   0,   "main_rgb_to_gray",  3 },
+        { VC_OP_BRIGTEN,        2, 2, 100, 0,   "main_brigten",      4 },
+        { VC_OP_MEDIAN,         2, 2, 0,   0,   NULL,                0 },
+        { VC_OP_GRAY_TO_BINARY, 2, 3, 254, 0,   "main_binary",       5 },
+        { VC_OP_BINARY_CLOSE,   3, 4, 2,   0,   "main_close",        6 },
+        { VC_OP_BINARY_DILATE,  4, 5, 3,   0,   "main_dilate",       7 },
+        { VC_OP_BLOB_LABELLING, 5, 6, 0,   0,   "main_blobs",        8 },
+};
+
+/**
+ * Pipeline de procura de candidatos num nivel reduzido da piramide.
+ * A redução já funde os pixeis vizinhos, por isso não há fecho nem dilatação
+ */
+static const VC_STAGE coarse_stages[] = {
+        { VC_OP_COPY,           0, 1, 0,   0,   NULL, 0 },
+        { VC_OP_COLOR_REMOVE,   1, 1, 12,  250, NULL, 0 },
+        { VC_OP_RGB_TO_GRAY,    1, 2, 0,   0,   NULL, 0 },
+        { VC_OP_BRIGTEN,        2, 2, 100, 0,   NULL, 0 },
+        { VC_OP_MEDIAN,         2, 2, 0,   0,   NULL, 0 },
+        { VC_OP_GRAY_TO_BINARY, 2, 3, 254, 0,   NULL, 0 },
+        { VC_OP_BLOB_LABELLING, 3, 4, 0,   0,   NULL, 0 },
+};
+
+/**
+ * Pipeline de procura de candidatos pela densidade de contornos verticais (a 1/2 ou 1/4 da resolução).
+ * Os caracteres dão uma faixa de gradiente forte em qualquer cor de matricula; a média de 25 pixeis
+ * e o fecho juntam os caracteres e os grupos de caracteres numa só faixa
+ * Refs: 0 imagem reduzida, 1 cinzentos, 2 gradiente, 3 binária, 4 fecho, 5 labels
+ */
+static const VC_STAGE edge_stages[] = {
+        { VC_OP_RGB_TO_GRAY,    0, 1, 0,   0,   NULL,           0 },
+        { VC_OP_SOBEL_X,        1, 2, 0,   0,   NULL,           0 },
+        { VC_OP_BOX_BLUR_X,     2, 2, 12,  0,   NULL,           0 },
+        { VC_OP_GRAY_TO_BINARY, 2, 3, 60,  0,   "edge_binary",  9 },
+        { VC_OP_BINARY_CLOSE,   3, 4, 5,   0,   "edge_close",   10 },
+        { VC_OP_BLOB_LABELLING, 4, 5, 0,   0,   NULL,           0 },
+};
+
+// Forma de uma faixa de caracteres no mapa de contornos
+#define EDGE_MIN_RATIO 2.0f
+#define EDGE_MAX_RATIO 8.0f
+#define EDGE_MIN_HEIGHT 0.03f
+
+// Largura máxima do mapa de contornos: imagens com mais do dobro são reduzidas a 1/4 em vez de 1/2,
+// para a média e o fecho (em pixeis) cobrirem o mesmo espaço entre caracteres
+#define EDGE_MAX_WIDTH 640
+
+/**
+ * Pipeline de verificação de uma potencial matricula (caracteres)
+ * Refs: 0 matricula extraida, 1 cinzentos, 2 binária, 3 erode invertido, 4 labels.
+ * Sem mediana: apagaria os traços finos dos caracteres
+ */
+static const VC_STAGE plate_stages[] = {
+        { VC_OP_DUMP,           0, 0, 0,   0,   "plate_original",      0 },
+        { VC_OP_COLOR_REMOVE,   0, 0, 12,  250, "plate_colorremove",   1 },
+        { VC_OP_RGB_TO_GRAY,    0, 1, 0,   0,   "plate_gray",          2 },
+        { VC_OP_BRIGTEN,        1, 1, 100, 0,   "plate_brigten",       3 },
+        { VC_OP_GRAY_TO_BINARY, 1, 2, 180, 0,   NULL,                  0 },
+        { VC_OP_BINARY_ERODE,   2, 3, 3,   0,   "plate_binary_erode",  4 },
+        { VC_OP_INVERT,         3, 3, 0,   0,   "plate_binary_invert", 5 },
+        { VC_OP_BLOB_LABELLING, 3, 4, 0,   0,   NULL,                  0 },
+};
 
-void debugSave(char *filen,int id, IVC *src) {
+/**
+ * Grava uma imagem intermédia em dir/filen_id.ppm
+ * @param dir directorio de output (NULL não grava)
+ * @param filen
+ * @param id
+ * @param src
+ */
+void debugSave(const char *dir, char *filen, int id, IVC *src) {
     char fileimagename[PATH_MAX];
-    sprintf(fileimagename,"%s/%s_%d.ppm",output_dir,filen,id);
+    if (dir == NULL) return;
+    VC_STATS_START(t);
+    snprintf(fileimagename,PATH_MAX,"%s/%s_%d.ppm",dir,filen,id);
     vc_write_image(fileimagename, src);
+    VC_STATS_STOP(VC_STATS_DUMP, t);
 }
 
 
@@ -34,7 +118,7 @@ void debugSave(char *filen,int id, IVC *src) {
  */
 int directory_exists(const char *path) {
     struct stat filestats;
-    stat(path, &filestats);
+    if (stat(path, &filestats) != 0) return 0;
     return S_ISDIR(filestats.st_mode);
 }
 
@@ -45,7 +129,7 @@ int directory_exists(const char *path) {
  */
 int file_exists(const char *path) {
     struct stat filestats;
-    stat(path, &filestats);
+    if (stat(path, &filestats) != 0) return 0;
     return S_ISREG(filestats.st_mode);
 }
 
@@ -79,37 +163,50 @@ void invertImageBinary(IVC *src) {
  * @param value
  */
 void fillImage(IVC *src, unsigned char value) {
-    long int maxpixels = src->width * src->height * 3;
-    for (int xy = 0; xy < maxpixels; xy++) {
-        src->data[xy] = value;
-        src->data[xy+1] = value;
-        src->data[xy+2] = value;
-    }
+    memset(src->data, value, src->width * src->height * src->channels);
 }
 
 /**
- * Extract blog from picture and return white ratio with threshold
+ * Copia uma região de uma imagem para uma nova imagem
  * @param src
- * @param dst
- * @param blob
- * @return
+ * @param x
+ * @param y
+ * @param width
+ * @param height
+ * @return nova imagem ou NULL se a região sair da imagem
  */
-float extractBlob(IVC *src, IVC *dst, OVC blob) {
+IVC *cropImage(IVC *src, int x, int y, int width, int height) {
+    if ((x < 0) || (y < 0) || (width <= 0) || (height <= 0)) return NULL;
+    if ((x + width > src->width) || (y + height > src->height)) return NULL;
+
+    IVC *dst = vc_image_new(width, height, src->channels, src->levels);
+    if (dst == NULL) return NULL;
+
+    for (int yy = 0; yy < height; yy++) {
+        memcpy(dst->data + yy * dst->bytesperline,
+               src->data + (y + yy) * src->bytesperline + x * src->channels,
+               dst->bytesperline);
+    }
+    return dst;
+}
+
+/**
+ * Copia o blob e conta os pixeis brancos (template, channels é constante nas instâncias)
+ */
+VC_TEMPLATE
+static inline int extract_blob_rows(IVC *src, IVC *dst, OVC blob, int channels) {
 
     // To count pixels from this threshold as potential plate
     int threshold = 200;
 
     int total_white = 0;
-    int bytesperline_src = src->width * src->channels;
-
-    // Mete a imagem a branco
-    fillImage(dst,255);
+    int bytesperline_src = src->width * channels;
 
     // Percorre a altura do blob para extrair o blob
     for (int yy = blob.y; yy <= blob.y + blob.height;yy++) {
         // Percorre a largura do blog
         for (int xx = blob.x; xx <= blob.x + blob.width;xx++) {
-            int pos = yy * bytesperline_src + xx * src->channels;
+            int pos = yy * bytesperline_src + xx * channels;
             dst->data[pos] = (unsigned char)src->data[pos] ;
             dst->data[pos+1] = (unsigned char)src->data[pos+1];
             dst->data[pos+2] = (unsigned char)src->data[pos+2];
@@ -121,6 +218,26 @@ float extractBlob(IVC *src, IVC *dst, OVC blob) {
             total_white = total_white + (grey > threshold ? 1 : 0);
         }
     }
+    return total_white;
+}
+
+/**
+ * Extract blog from picture and return white ratio with threshold
+ * @param src
+ * @param dst
+ * @param blob
+ * @return
+ */
+float extractBlob(IVC *src, IVC *dst, OVC blob) {
+    int total_white;
+
+    // Mete a imagem a branco
+    fillImage(dst,255);
+
+    // Imagens RGB (o caso do pipeline) com os canais fixos, as restantes na versão genérica
+    if (src->channels == 3 && vc_cpu_specialised()) total_white = extract_blob_rows(src, dst, blob, 3);
+    else total_white = extract_blob_rows(src, dst, blob, src->channels);
+
     return ((float)total_white / blob.area);
 }
 
@@ -165,59 +282,34 @@ float extractBlobBinary(IVC *src, IVC *dst, OVC blob) {
 }
 
 /**
- * Processes a probable plate to find if it has 6 numbers or digits
- * devolve os blobs encontrados na matricula
- * @param src
- * @return
+ * processPlate com o pipeline da matricula indicado (cada thread da verificação tem o seu)
+ * @param ctx
+ * @param pipeline pipeline com os estágios plate_stages
+ * @param src imagem com a potencial matricula extraida
+ * @param blob bounding box da potencial matricula
+ * @param result
+ * @return numero de caracteres encontrados
  */
-int processPlate(IVC *src, OVC* blobs_caracteres, int *numero_blobs, OVC blob, OVC found_plate[0], OVC blobs_matricula[6]) {
-    char fileimagename[PATH_MAX];
-
-    OVC *blobs_plate;
-    IVC *image = vc_image_new(src->width, src->height, 1, src->levels);
-    IVC *image2 = vc_image_new(src->width, src->height, 1, src->levels);
-    IVC *image3 = vc_image_new(src->width, src->height, 1, src->levels);
-    int numero2=0;
-
-    debugSave("plate_original",0,src);
-
-    // Remove cores
-    vc_color_remove(src,12,250);
-    debugSave("plate_colorremove",1,src);
-
-    // Transforma em grayscale
-    vc_rgb_to_gray(src, image2);
-    debugSave("plate_gray",2,image2);
-
-    // Clareia a imagem
-    vc_brigten(image2,100);
-    debugSave("plate_brigten",3,image2);
-
-    // Coloca a imagem em binário e faz um erode
-    vc_gray_to_binary(image2, image3, 180);
-    vc_binary_erode(image3, image2, 3);
-    debugSave("plate_binary_erode",4,image2);
-
-    // Inverte a imagem
-    invertImageBinary(image2);
-    debugSave("plate_binary_invert",5,image2);
-
-    *numero_blobs = 0;
-
-    // Cria imagem de blobs
-    blobs_caracteres =  vc_binary_blob_labelling(image2, image, numero_blobs);
-
-    // Vai buscar a info dos blobs
-    vc_binary_blob_info(image,blobs_caracteres, *numero_blobs);
-
+static int processPlatePipeline(VC_RECOGNIZER *ctx, VC_PIPELINE *pipeline, IVC *src, OVC blob, VC_RESULT *result) {
+    OVC *blobs_caracteres;
+    IVC *image2;
+    VC_STATS_START(t);
+
+    if (!vc_pipeline_run(pipeline, src)) {
+        VC_STATS_STOP(VC_STATS_PLATE, t);
+        return 0;
+    }
+    // A imagem binária invertida é usada no fim para extrair os caracteres
+    image2 = vc_pipeline_buffer(pipeline, 3);
+    blobs_caracteres = pipeline->blobs;
 
     // Apenas blobs com mais de metade da altura que a matricula
-    int min_height = blob.height * (float)0.4;
-    float max_racio = 0.8;
+    int min_height = blob.height * ctx->char_min_height;
+    float max_racio = ctx->char_max_ratio;
 
     int encontrados=0;
 
-    for (int e = 0; e < *numero_blobs; e++) {
+    for (int e = 0; e < pipeline->nblobs; e++) {
         int height_condition = 0;
         int racio_condition = 0;
         int inside_condition = 0;
@@ -237,47 +329,65 @@ int processPlate(IVC *src, OVC* blobs_caracteres, int *numero_blobs, OVC blob, O
 
         if (height_condition && racio_condition && inside_condition) {
             // Encontrou um numero ou letra
-            /*printf("\n\nE: %d\n",e);
-            printf("Area: %d\n", blobs_caracteres[e].area);
-            printf("Width: %d\n", blobs_caracteres[e].width);
-            printf("Height: %d\n", blobs_caracteres[e].height);
-            printf("X: %d\n", blobs_caracteres[e].x);
-            printf("Y: %d\n", blobs_caracteres[e].y);
-            printf("Racio: %.2f\n", wh_racio);*/
             encontrados++;
-            if (encontrados > 6) return 0;
-            blobs_matricula[encontrados-1] = blobs_caracteres[e];
-            found_plate[0] = blob;
-            // Testing
+            VC_STATS_COUNT(VC_STATS_CHARS, 1);
+            if (encontrados > 6) {
+                VC_STATS_STOP(VC_STATS_PLATE, t);
+                return 0;
+            }
+            result->chars[encontrados-1] = blobs_caracteres[e];
             // Desenha os potenciais blobs
             desenha_bounding_box(src, &blobs_caracteres[e], 1);
 
             // To save digits
-            IVC *temp_save = vc_image_new(blobs_caracteres[e].width, blobs_caracteres[e].height, 1, src->levels);
-            extractBlobBinary(image2,temp_save,blobs_caracteres[e]);
+            if (ctx->output_dir != NULL) {
+                IVC *temp_save = vc_image_new(blobs_caracteres[e].width, blobs_caracteres[e].height, 1, src->levels);
+                extractBlobBinary(image2,temp_save,blobs_caracteres[e]);
 
-            debugSave("caracteres",encontrados,temp_save);
+                debugSave(ctx->output_dir,"caracteres",encontrados,temp_save);
+                vc_image_free(temp_save);
+            }
         }
 
     }
 
+    // Reconhece os caracteres directamente da imagem binária
+    if (encontrados == 6) {
+        VC_STATS_START(t_ocr);
+        vc_ocr_plate(image2, result->chars, encontrados, result->text);
+        VC_STATS_STOP(VC_STATS_OCR, t_ocr);
+    }
+
+    VC_STATS_STOP(VC_STATS_PLATE, t);
     return encontrados;
 }
 
-
 /**
- *
- * @param src
- * @param blobs
- * @param numeroBlobs
- * @param blob_matricula
- * @param found_blobs_caracteres
- * @return
+ * Processes a probable plate to find if it has 6 numbers or digits
+ * Os caracteres encontrados e o texto reconhecido ficam em result
+ * @param ctx
+ * @param src imagem com a potencial matricula extraida
+ * @param blob bounding box da potencial matricula
+ * @param result
+ * @return numero de caracteres encontrados
  */
-int potentialBlobs(IVC *src,OVC* blobs,int numeroBlobs, OVC blob_matricula[1], OVC found_blobs_caracteres[6]) {
+int processPlate(VC_RECOGNIZER *ctx, IVC *src, OVC blob, VC_RESULT *result) {
+    return processPlatePipeline(ctx, &ctx->plate, src, blob, result);
+}
 
-    // 4% of pixels
-    int ideal_area = src->width * src->height * 0.03;
+
+/**
+ * Verifica se a forma de um blob é compativel com uma matricula:
+ * racio largura/altura entre 3 e 4.5 e área superior a 3% da imagem
+ * @param blob
+ * @param width largura da imagem onde o blob foi encontrado
+ * @param height altura da imagem onde o blob foi encontrado
+ * @param slack folga relativa nos limites (0 = limites exactos)
+ * @return 1 se for candidato
+ */
+int isPlateCandidate(OVC blob, int width, int height, float slack) {
+    // 3% of pixels
+    int ideal_area = width * height * 0.03;
 
     // width / height racio potential
     // Pode-se mexer
@@ -285,182 +395,1182 @@ int potentialBlobs(IVC *src,OVC* blobs,int numeroBlobs, OVC blob_matricula[1], O
 
     float area_inf=ideal_area;// - 5000, area_sup=ideal_area + 5000;
 
-    // Percentagem de branco a partir da qual é considerado matricula
-    // Pode-se mexer
-    float white_ideal = 0.3;
+    int wh_potential = 0, area_potential = 0;
+    float wh_racio = 0;
+
+    if (blob.height <= 0) return 0;
+
+    wh_racio = (float)blob.width / blob.height;
+
+    // Potencial wh_racio
+    wh_potential = (wh_racio > wh_inf / (1 + slack)) && (wh_racio < wh_sup * (1 + slack));
+    area_potential = (blob.area > area_inf / ((1 + slack) * (1 + slack)));// && (blob.area < area_sup);
+
+    return wh_potential && area_potential;
+}
+
+
+// Inclinação (radianos) a partir da qual um candidato que falhou é endireitado (~1.7 graus)
+// e máxima estimada pelos momentos (~29 graus, acima disso a caixa já não tem forma de matricula)
+#define DESKEW_MIN_ANGLE 0.03f
+#define DESKEW_MAX_ANGLE 0.5f
+
+/**
+ * Rectangulo rodado de um candidato
+ */
+typedef struct {
+    float angle;                    // Angulo do eixo maior em radianos (y para baixo)
+    float cx, cy;                   // Centro
+    float width, height;            // Lados
+} PLATE_SKEW;
+
+/**
+ * Inclinação de um candidato pelos momentos de segunda ordem dos pixeis claros da sua caixa
+ * (o fundo da matricula é o objecto claro mais comprido). Num rectangulo uniforme os valores proprios
+ * da covariância são largura^2 / 12 e altura^2 / 12, o que dá também os lados sem as margens da caixa.
+ * Custo proporcional à área do candidato
+ * @param src imagem RGB
+ * @param blob
+ * @param skew
+ * @return 0 se não há pixeis claros
+ */
+static int plateSkew(IVC *src, OVC blob, PLATE_SKEW *skew) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+    int x1 = MIN(blob.x + blob.width, src->width), y1 = MIN(blob.y + blob.height, src->height);
+
+    for (int y = MAX(blob.y, 0); y < y1; y++) {
+        for (int x = MAX(blob.x, 0); x < x1; x++) {
+            const unsigned char *p = src->data + y * src->bytesperline + x * 3;
+
+            if (rgb_to_gray(p[0], p[1], p[2]) <= 150) continue;
+            n++;
+            sx += x;
+            sy += y;
+            sxx += (double)x * x;
+            syy += (double)y * y;
+            sxy += (double)x * y;
+        }
+    }
+    if (n == 0) return 0;
+
+    double mx = sx / n, my = sy / n;
+    double mu20 = sxx / n - mx * mx, mu02 = syy / n - my * my, mu11 = sxy / n - mx * my;
+    double delta = sqrt((mu20 - mu02) * (mu20 - mu02) / 4 + mu11 * mu11);
+
+    skew->angle = (float)(0.5 * atan2(2 * mu11, mu20 - mu02));
+    skew->cx = (float)mx;
+    skew->cy = (float)my;
+    skew->width = (float)sqrt(12 * ((mu20 + mu02) / 2 + delta));
+    skew->height = (float)sqrt(12 * MAX((mu20 + mu02) / 2 - delta, 0));
+    return 1;
+}
+
+/**
+ * Verifica outra vez um candidato inclinado: só o rectangulo da matricula é reamostrado (vc_rgb_deskew) para uma
+ * imagem do seu tamanho, onde a caixa da matricula é a imagem toda.
+ * Os caracteres ficam em coordenadas de src, com o centro rodado de volta e o tamanho da imagem endireitada
+ * @param ctx
+ * @param pipeline pipeline da matricula
+ * @param src imagem RGB onde está o candidato
+ * @param blob candidato em coordenadas de src
+ * @param result caracteres encontrados
+ * @return numero de caracteres encontrados (0 se o candidato não está inclinado)
+ */
+static int verifyDeskewed(VC_RECOGNIZER *ctx, VC_PIPELINE *pipeline, IVC *src, OVC blob, VC_RESULT *result) {
+    VC_STATS_START(t);
+    PLATE_SKEW skew;
+
+    if (!plateSkew(src, blob, &skew) || (fabsf(skew.angle) < DESKEW_MIN_ANGLE) || (fabsf(skew.angle) > DESKEW_MAX_ANGLE)) {
+        VC_STATS_STOP(VC_STATS_DESKEW, t);
+        return 0;
+    }
+
+    float c = cosf(skew.angle), s = sinf(skew.angle);
+    int width = (int)lroundf(skew.width), height = (int)lroundf(skew.height);
+    IVC *upright = NULL;
+
+    if ((width >= 8) && (height >= 8)) upright = vc_image_new(width, height, 3, src->levels);
+    if ((upright == NULL) || !vc_rgb_deskew(src, upright, skew.cx, skew.cy, skew.angle)) {
+        vc_image_free(upright);
+        VC_STATS_STOP(VC_STATS_DESKEW, t);
+        return 0;
+    }
+    VC_STATS_COUNT(VC_STATS_DESKEWED, 1);
+    VC_STATS_STOP(VC_STATS_DESKEW, t);
+
+    OVC box;
+    memset(&box, 0, sizeof(OVC));
+    box.width = width;
+    box.height = height;
+    box.area = width * height;
+    box.xc = width / 2;
+    box.yc = height / 2;
+
+    int encontrados = processPlatePipeline(ctx, pipeline, upright, box, result);
+    for (int i = 0; i < encontrados; i++) {
+        OVC *ch = &result->chars[i];
+        float u = ch->x + (ch->width - 1) / 2.0f - (width - 1) / 2.0f;
+        float v = ch->y + (ch->height - 1) / 2.0f - (height - 1) / 2.0f;
+        float x = skew.cx + u * c - v * s, y = skew.cy + u * s + v * c;
+
+        ch->x = (int)lroundf(x - (ch->width - 1) / 2.0f);
+        ch->y = (int)lroundf(y - (ch->height - 1) / 2.0f);
+        ch->xc = (int)lroundf(x);
+        ch->yc = (int)lroundf(y);
+    }
+
+    vc_image_free(upright);
+    return encontrados;
+}
+
+/**
+ * Verifica um candidato com forma de matricula: racio de branco e 6 caracteres
+ * @param ctx
+ * @param pipeline pipeline da matricula
+ * @param src imagem onde está o candidato
+ * @param extract imagem de extração, realocada se as dimensões não forem as de src
+ * @param blob candidato em coordenadas de src
+ * @param result matricula e caracteres encontrados
+ * @return 1 se é uma matricula, 0 se não é, -1 se não foi possivel alocar a extração
+ */
+static int verifyCandidate(VC_RECOGNIZER *ctx, VC_PIPELINE *pipeline, IVC *src, IVC **extract, OVC blob, VC_RESULT *result) {
+    // A imagem de extração é reutilizada enquanto as dimensões não mudarem
+    if (*extract == NULL || (*extract)->width != src->width || (*extract)->height != src->height) {
+        vc_image_free(*extract);
+        *extract = vc_image_new(src->width, src->height, 3, src->levels);
+        if (*extract == NULL) return -1;
+    }
+    IVC *plate = *extract;
+    plate->levels = src->levels;
+
+    // Potential plate extract
+    VC_STATS_START(t_extract);
+    float white_ratio = extractBlob(src,plate, blob);
+    VC_STATS_STOP(VC_STATS_EXTRACT, t_extract);
+
+    if (white_ratio > ctx->white_ratio) {
+        VC_STATS_COUNT(VC_STATS_WHITE, 1);
+        // FOUND THE PLATE ?!?!?
+        // Verifica se agora há 6 blobs lá dentro todos catitas com um ratio:D
+        int encontrados = processPlatePipeline(ctx, pipeline, plate, blob, result);
+
+        // Matricula inclinada: os caracteres não cabem na caixa alinhada com os eixos (altura, inside_condition),
+        // verifica outra vez a região endireitada
+        if ((encontrados != 6) && ctx->deskew && (src->channels == 3)) {
+            VC_RESULT upright;
+            memset(&upright, 0, sizeof(VC_RESULT));
+            int endireitados = verifyDeskewed(ctx, pipeline, src, blob, &upright);
+            if (endireitados > encontrados) {
+                memcpy(result->chars, upright.chars, sizeof(result->chars));
+                memcpy(result->text, upright.text, sizeof(result->text));
+                encontrados = endireitados;
+            }
+        }
+        if (encontrados == 6) {
+            // ENCONTREI UMA MATRICULA têm 6 digitos lá dentro
+            result->plate = blob;
+            result->nchars = 6;
+            result->found = 1;
+            return 1;
+        }
+        // Caracteres encontrados, para o resultado parcial quando o prazo passa
+        result->plate = blob;
+        result->nchars = encontrados;
+        return 0;
+    }
+    result->nchars = 0;
+    return 0;
+}
+
+/**
+ * Pontuação de um candidato com forma de matricula, só com medidas já calculadas na etiquetagem:
+ * proximidade do racio largura/altura a 4, preenchimento da bounding box, densidade de contornos
+ * (os buracos dos caracteres aumentam o perimetro) e posição na imagem (centro, metade de baixo)
+ * @param blob
+ * @param width largura da imagem
+ * @param height altura da imagem
+ * @return pontuação entre 0 e 1 (maior é melhor)
+ */
+float plateScore(OVC blob, int width, int height) {
+    if ((blob.width <= 0) || (blob.height <= 0) || (width <= 0) || (height <= 0)) return 0;
+
+    float racio = (float)blob.width / blob.height;
+    float aspect = 1 - fabsf(racio - 4) / 2;
+    float fill = (float)blob.area / (blob.width * blob.height);
+    float edges = ((float)blob.perimeter / (2 * (blob.width + blob.height)) - 1) / 1.5f;
+    float position = 1 - fabsf((float)blob.xc / width - 0.5f) - fabsf((float)blob.yc / height - 0.6f);
+
+    if (aspect < 0) aspect = 0;
+    if (fill > 1) fill = 1;
+    if (edges < 0) edges = 0;
+    if (edges > 1) edges = 1;
+    if (position < 0) position = 0;
+
+    return 0.3f * aspect + 0.2f * fill + 0.3f * edges + 0.2f * position;
+}
+
+/**
+ * Candidato ordenado pela pontuação
+ */
+typedef struct {
+    float score;
+    int index;
+} RANKED_BLOB;
+
+/**
+ * Ordem decrescente de pontuação; empates pela ordem das etiquetas
+ */
+static int rankedCompare(const void *a, const void *b) {
+    const RANKED_BLOB *ra = a, *rb = b;
+    if (ra->score != rb->score) return ra->score < rb->score ? 1 : -1;
+    return ra->index - rb->index;
+}
+
+/**
+ * Buffers de uma thread da verificação em paralelo (a thread 0 usa os do contexto)
+ */
+typedef struct {
+    VC_PIPELINE plate;
+    IVC *extract;
+    VC_STATS stats;                 // Medições da thread na ultima verificação
+} VC_VERIFY_SCRATCH;
+
+/**
+ * Pool da verificação em paralelo, criado no primeiro uso e mantido entre imagens
+ */
+typedef struct VC_VERIFY_WORKERS {
+    VC_THREADPOOL pool;
+    int threads;                    // ctx->verify_threads quando o pool foi criado
+    VC_VERIFY_SCRATCH *scratch;     // Uma entrada por thread do pool (a 0 não é usada)
+} VC_VERIFY_WORKERS;
+
+// Estado de um candidato que não chegou a ser verificado (prazo ou cancelado)
+#define VERIFY_PENDING (-2)
+
+/**
+ * Verificação em paralelo dos candidatos de uma imagem
+ */
+typedef struct {
+    VC_RECOGNIZER *ctx;
+    IVC *src;
+    IVC **extract;                  // Extração da thread 0
+    OVC *blobs;
+    RANKED_BLOB *ranked;
+    int nranked;
+    VC_RESULT *results;             // Resultado de cada candidato, pela ordem da pontuação
+    int *status;                    // Retorno de verifyCandidate ou VERIFY_PENDING
+
+    pthread_mutex_t lock;
+    int next;                       // Próximo candidato a distribuir
+    int limit;                      // Primeiro candidato encontrado (ou com erro): os seguintes já não contam
+    int expired;                    // O prazo passou com candidatos por distribuir
+    long long deadline;             // Prazo da thread que chamou
+    int stats_enabled;
+    int current[VC_THREADPOOL_MAX + 1];             // Candidato em verificação em cada thread (-1 nenhum)
+    long long *deadlines[VC_THREADPOOL_MAX + 1];    // vc_deadline de cada thread
+} VERIFY_BATCH;
+
+/**
+ * Liberta o pool e os buffers da verificação em paralelo
+ * @param workers
+ */
+static void verifyWorkersFree(VC_VERIFY_WORKERS *workers) {
+    if (workers == NULL) return;
+
+    vc_threadpool_free(&workers->pool);
+    for (int i = 1; i < workers->threads; i++) {
+        vc_pipeline_free(&workers->scratch[i].plate);
+        vc_image_free(workers->scratch[i].extract);
+    }
+    free(workers->scratch);
+    free(workers);
+}
+
+/**
+ * Pool da verificação em paralelo com ctx->verify_threads threads, criado se ainda não existe
+ * @param ctx
+ * @return NULL se não foi possivel criar
+ */
+static VC_VERIFY_WORKERS *verifyWorkers(VC_RECOGNIZER *ctx) {
+    VC_VERIFY_WORKERS *workers = ctx->verify;
+
+    if (workers != NULL && workers->threads == ctx->verify_threads) return workers;
+    verifyWorkersFree(workers);
+
+    ctx->verify = workers = (VC_VERIFY_WORKERS *)calloc(1, sizeof(VC_VERIFY_WORKERS));
+    if (workers == NULL) return NULL;
+    workers->threads = ctx->verify_threads;
+    workers->scratch = (VC_VERIFY_SCRATCH *)calloc(ctx->verify_threads, sizeof(VC_VERIFY_SCRATCH));
+    if (workers->scratch == NULL) {
+        free(workers);
+        return ctx->verify = NULL;
+    }
+    for (int i = 1; i < ctx->verify_threads; i++) {
+        vc_pipeline_init(&workers->scratch[i].plate, plate_stages, sizeof(plate_stages) / sizeof(VC_STAGE));
+        vc_pipeline_keep(&workers->scratch[i].plate, 3);
+    }
+    vc_threadpool_init(&workers->pool, ctx->verify_threads);
+    return workers;
+}
+
+/**
+ * Thread da verificação em paralelo: tira candidatos pela ordem da pontuação até não haver mais,
+ * até ao primeiro encontrado ou até o prazo passar
+ * @param arg VERIFY_BATCH
+ * @param worker
+ */
+static void verifyWorker(void *arg, int worker) {
+    VERIFY_BATCH *b = arg;
+    VC_RECOGNIZER *ctx = b->ctx;
+    VC_PIPELINE *pipeline = &ctx->plate;
+    IVC **extract = b->extract;
+    long long deadline = vc_deadline;
+
+    if (worker > 0) {
+        VC_VERIFY_SCRATCH *scratch = &ctx->verify->scratch[worker];
+        pipeline = &scratch->plate;
+        pipeline->threshold_mode = ctx->plate.threshold_mode;
+        pipeline->threshold_percentile = ctx->plate.threshold_percentile;
+        extract = &scratch->extract;
+        vc_stats.enabled = b->stats_enabled;
+        vc_stats_reset();
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->deadlines[worker] = &vc_deadline;
+    for (;;) {
+        // Um cancelamento pode ter posto o prazo desta thread no passado durante a verificação anterior
+        vc_deadline = b->deadline;
+        if (b->next >= b->limit) break;
+        if (vc_deadline_expired()) {
+            b->expired = 1;
+            break;
+        }
+        int i = b->next++;
+        b->current[worker] = i;
+        pthread_mutex_unlock(&b->lock);
+
+        VC_STATS_COUNT(VC_STATS_VERIFIED, 1);
+        int verified = verifyCandidate(ctx, pipeline, b->src, extract, b->blobs[b->ranked[i].index], &b->results[i]);
+
+        pthread_mutex_lock(&b->lock);
+        b->current[worker] = -1;
+        b->status[i] = verified;
+        if (verified != 0 && i < b->limit) {
+            // Os candidatos com pior pontuação deixam de contar. As threads que ainda os verificam
+            // ficam com o prazo no passado e param no próximo teste (entre estágios e por linhas)
+            b->limit = i;
+            for (int w = 0; w < ctx->verify->pool.nworkers; w++) {
+                if (b->current[w] > i) __atomic_store_n(b->deadlines[w], 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    vc_deadline = deadline;
+    if (worker > 0) ctx->verify->scratch[worker].stats = vc_stats;
+}
+
+/**
+ * Verifica os candidatos já ordenados no pool de ctx->verify_threads threads, com buffers por thread.
+ * O resultado é o mesmo da verificação sequencial: ganha o encontrado com melhor pontuação,
+ * e os candidatos com pior pontuação que ainda estão a ser verificados são cancelados
+ * @param ctx
+ * @param src imagem onde estão os blobs
+ * @param extract imagem de extração para src (usada pela thread 0)
+ * @param blobs
+ * @param ranked candidatos pela ordem da pontuação
+ * @param nranked
+ * @param result matricula encontrada
+ * @param partial melhor resultado parcial se nenhum for encontrado
+ * @return 1 se encontrou uma matricula, 0 se não, -1 se não foi possivel verificar em paralelo
+ */
+static int parallelVerify(VC_RECOGNIZER *ctx, IVC *src, IVC **extract, OVC *blobs, RANKED_BLOB *ranked, int nranked,
+                          VC_RESULT *result, VC_RESULT *partial) {
+    VC_VERIFY_WORKERS *workers = verifyWorkers(ctx);
+    VERIFY_BATCH b;
+    int found = 0;
+
+    if (workers == NULL) return -1;
+
+    memset(&b, 0, sizeof(VERIFY_BATCH));
+    b.results = (VC_RESULT *)calloc(nranked, sizeof(VC_RESULT));
+    b.status = (int *)malloc(nranked * sizeof(int));
+    if (b.results == NULL || b.status == NULL) {
+        free(b.results);
+        free(b.status);
+        return -1;
+    }
+    b.ctx = ctx;
+    b.src = src;
+    b.extract = extract;
+    b.blobs = blobs;
+    b.ranked = ranked;
+    b.nranked = nranked;
+    b.limit = nranked;
+    b.deadline = vc_deadline;
+    b.stats_enabled = vc_stats.enabled;
+    for (int i = 0; i < nranked; i++) b.status[i] = VERIFY_PENDING;
+    for (int w = 0; w <= VC_THREADPOOL_MAX; w++) b.current[w] = -1;
+    pthread_mutex_init(&b.lock, NULL);
+
+    vc_threadpool_run(&workers->pool, verifyWorker, &b);
+    pthread_mutex_destroy(&b.lock);
+
+    // Tempos e contadores das outras threads (os tempos somam o trabalho de todas)
+    for (int w = 1; vc_stats.enabled && w < workers->pool.nworkers; w++) vc_stats_merge(&workers->scratch[w].stats);
+
+    // Pela ordem da pontuação, como na verificação sequencial
+    for (int i = 0; i < nranked; i++) {
+        if (b.status[i] == VERIFY_PENDING) continue;
+        if (b.status[i] < 0) break;
+        if (b.status[i] == 1) {
+            *result = b.results[i];
+            found = 1;
+            break;
+        }
+        if (b.results[i].nchars > partial->nchars) {
+            partial->plate = b.results[i].plate;
+            partial->nchars = b.results[i].nchars;
+            memcpy(partial->chars, b.results[i].chars, sizeof(partial->chars));
+        }
+    }
+    if (b.expired) partial->deadline_exceeded = 1;
+
+    free(b.results);
+    free(b.status);
+    return found;
+}
+
+/**
+ * Verifica os candidatos com forma de matricula pela ordem da pontuação,
+ * no máximo ctx->max_verifications (0 = todos)
+ * @param ctx
+ * @param src imagem onde estão os blobs
+ * @param extract imagem de extração para src
+ * @param blobs blobs em coordenadas de src
+ * @param numeroBlobs
+ * @param dx deslocamento de src na imagem completa
+ * @param dy
+ * @param width dimensões da imagem completa (forma e posição são relativas a ela)
+ * @param height
+ * @param result matricula e caracteres em coordenadas de src
+ * @return 1 se encontrou uma matricula
+ */
+static int rankedVerify(VC_RECOGNIZER *ctx, IVC *src, IVC **extract, OVC *blobs, int numeroBlobs,
+                        int dx, int dy, int width, int height, VC_RESULT *result) {
+    RANKED_BLOB *ranked;
+    int nranked = 0, found = 0;
+
+    if (numeroBlobs <= 0) return 0;
+    ranked = (RANKED_BLOB *)malloc(numeroBlobs * sizeof(RANKED_BLOB));
+    if (ranked == NULL) return 0;
+
+    for (int i = 0; i < numeroBlobs; i++) {
+        OVC full = blobs[i];
+        full.x += dx;
+        full.y += dy;
+        full.xc += dx;
+        full.yc += dy;
+
+        if(isPlateCandidate(full, width, height, 0)) {
+            VC_STATS_COUNT(VC_STATS_SHAPE, 1);
+            ranked[nranked].score = plateScore(full, width, height);
+            ranked[nranked].index = i;
+            nranked++;
+        }
+    }
+    qsort(ranked, nranked, sizeof(RANKED_BLOB), rankedCompare);
+
+    if (ctx->max_verifications > 0 && nranked > ctx->max_verifications) nranked = ctx->max_verifications;
+
+    // Melhor resultado parcial: o candidato com mais caracteres (ou o de maior pontuação)
+    VC_RESULT partial;
+    memset(&partial, 0, sizeof(VC_RESULT));
+    if (nranked > 0) partial.plate = blobs[ranked[0].index];
+
+    // Com varias threads os candidatos são verificados em paralelo. Os dumps precisam da ordem sequencial
+    int parallel = -1;
+    if (nranked > 1 && ctx->verify_threads > 1 && ctx->output_dir == NULL) {
+        parallel = parallelVerify(ctx, src, extract, blobs, ranked, nranked, result, &partial);
+    }
+    if (parallel >= 0) found = parallel;
+
+    for (int i = 0; parallel < 0 && i < nranked && !found; i++) {
+        // O prazo é verificado entre candidatos
+        if (vc_deadline_expired()) {
+            partial.deadline_exceeded = 1;
+            break;
+        }
+        VC_STATS_COUNT(VC_STATS_VERIFIED, 1);
+        int verified = verifyCandidate(ctx, &ctx->plate, src, extract, blobs[ranked[i].index], result);
+        if (verified < 0) break;
+        found = verified;
+        if (!found && result->nchars > partial.nchars) {
+            partial.plate = result->plate;
+            partial.nchars = result->nchars;
+            memcpy(partial.chars, result->chars, sizeof(partial.chars));
+        }
+    }
 
-    //printf("Ideal Area: %d",ideal_area);
+    if (!found) {
+        // O prazo também pode ter passado durante a ultima verificação
+        if (vc_deadline_expired()) partial.deadline_exceeded = 1;
+        *result = partial;
+        if (!partial.deadline_exceeded) memset(result, 0, sizeof(VC_RESULT));
+    }
 
+    free(ranked);
+    return found;
+}
+
+/**
+ * Procura entre os blobs uma matricula: forma, racio de branco e 6 caracteres.
+ * Os candidatos são verificados do mais provavel para o menos provavel (plateScore)
+ * @param ctx
+ * @param src imagem original
+ * @param blobs
+ * @param numeroBlobs
+ * @param result matricula e caracteres encontrados
+ * @return 1 se encontrou uma matricula
+ */
+int potentialBlobs(VC_RECOGNIZER *ctx, IVC *src, OVC* blobs, int numeroBlobs, VC_RESULT *result) {
 
     // Verificaçao de erros
     if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
     if ((src->channels != 3)) return 0;
 
-    //percorre os blobs da imagem
-    for (int i = 0; i < numeroBlobs; i++) {
+    VC_STATS_START(t);
 
-        int wh_potential = 0, area_potential = 0;
-        float wh_racio = 0;
+    int found = rankedVerify(ctx, src, &ctx->extract, blobs, numeroBlobs, 0, 0, src->width, src->height, result);
 
-        wh_racio = (float)blobs[i].width / blobs[i].height;
+    VC_STATS_STOP(VC_STATS_CANDIDATES, t);
+    return found;
+}
 
-        // Potencial wh_racio
-        wh_potential = (wh_racio > wh_inf) && (wh_racio < wh_sup);
-        area_potential = (blobs[i].area > area_inf);// && (blobs[i].area < area_sup);
+/**
+ * Desloca as caixas de um resultado (coordenadas da janela -> imagem)
+ * @param result
+ * @param dx
+ * @param dy
+ */
+static void translateResult(VC_RESULT *result, int dx, int dy) {
+    result->plate.x += dx;
+    result->plate.y += dy;
+    result->plate.xc += dx;
+    result->plate.yc += dy;
+    for (int i = 0; i < result->nchars; i++) {
+        result->chars[i].x += dx;
+        result->chars[i].y += dy;
+        result->chars[i].xc += dx;
+        result->chars[i].yc += dy;
+    }
+}
 
-        if(wh_potential && area_potential) {
-            IVC *plate = vc_image_new(src->width, src->height, 3, src->levels);
+/**
+ * Procura a matricula apenas numa janela à volta da ultima posição conhecida (ctx->last).
+ * A janela tem dimensões fixas e segue o centro da matricula, por isso o pipeline
+ * e a extração reutilizam sempre os mesmos buffers e o custo depende só da janela
+ * @param ctx
+ * @param src imagem completa
+ * @param result matricula e caracteres em coordenadas de src
+ * @return 1 se encontrou a matricula na janela
+ */
+static int trackPlate(VC_RECOGNIZER *ctx, IVC *src, VC_RESULT *result) {
+    VC_PIPELINE *track = &ctx->track;
+    OVC last = ctx->last.plate;
+    int width = ctx->track_width, height = ctx->track_height;
+    int found = 0;
+
+    // Janela centrada na ultima matricula, deslocada para dentro da imagem
+    int x0 = last.x + last.width / 2 - width / 2;
+    int y0 = last.y + last.height / 2 - height / 2;
+    if (x0 > src->width - width) x0 = src->width - width;
+    if (y0 > src->height - height) y0 = src->height - height;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+
+    if (ctx->track_roi == NULL || ctx->track_roi->width != width || ctx->track_roi->height != height) {
+        vc_image_free(ctx->track_roi);
+        ctx->track_roi = vc_image_new(width, height, src->channels, src->levels);
+        if (ctx->track_roi == NULL) return 0;
+    }
+    IVC *roi = ctx->track_roi;
+    for (int yy = 0; yy < height; yy++) {
+        memcpy(roi->data + yy * roi->bytesperline,
+               src->data + (y0 + yy) * src->bytesperline + x0 * src->channels,
+               roi->bytesperline);
+    }
 
-            // Potential plate extract
-            float white_ratio = extractBlob(src,plate, blobs[i]);
+    VC_STATS_START(t_detect);
+    if (!vc_pipeline_run(track, roi)) track->nblobs = 0;
+    VC_STATS_STOP(VC_STATS_DETECT, t_detect);
+    VC_STATS_COUNT(VC_STATS_BLOBS, track->nblobs);
+
+    // Candidatos em coordenadas da imagem completa (para o desenho em processImage)
+    ctx->candidates = (OVC *)calloc(track->nblobs + 1, sizeof(OVC));
+    ctx->ncandidates = 0;
+
+    for (int i = 0; (ctx->candidates != NULL) && (i < track->nblobs); i++) {
+        OVC full = track->blobs[i];
+        full.x += x0;
+        full.y += y0;
+        full.xc += x0;
+        full.yc += y0;
+        ctx->candidates[ctx->ncandidates++] = full;
+    }
 
-            if (white_ratio > white_ideal) {
-                // FOUND THE PLATE ?!?!?
-                // Verifica se agora há 6 blobs lá dentro todos catitas com um ratio:D
-                OVC *blobs_caracteres;
-                int numero_caracteres=0, numeros_encontrados = 0;
-                // Retira os blobs da imagem da matricula
+    // A forma e a posição são avaliadas em relação à imagem completa e não à janela
+    VC_STATS_START(t);
+    found = rankedVerify(ctx, roi, &ctx->track_extract, track->blobs, track->nblobs, x0, y0, src->width, src->height, result);
+    if (found || result->deadline_exceeded) translateResult(result, x0, y0);
+    VC_STATS_STOP(VC_STATS_CANDIDATES, t);
 
-                numeros_encontrados = processPlate(plate, blobs_caracteres, &numero_caracteres, blobs[i], blob_matricula, found_blobs_caracteres);
+    return found;
+}
 
-                if (numeros_encontrados == 6) {
-                    // ENCONTREI UMA MATRICULA têm 6 digitos lá dentro
-                    blob_matricula[0] = blobs[i];
+/**
+ * Actualiza o estado do seguimento depois de uma procura na imagem completa
+ * @param ctx
+ * @param src
+ * @param result
+ */
+static void trackUpdate(VC_RECOGNIZER *ctx, IVC *src, VC_RESULT *result) {
+    ctx->track_missed = 0;
+    ctx->track_frames = 0;
+    ctx->tracked = result->found;
+    if (!result->found) return;
+
+    ctx->last = *result;
+
+    // A janela fica com as dimensões da matricula mais a margem de cada lado
+    ctx->track_width = result->plate.width + 2 * (int)(result->plate.width * ctx->track_margin) + 2;
+    ctx->track_height = result->plate.height + 2 * (int)(result->plate.height * ctx->track_margin) + 2;
+    if (ctx->track_width > src->width) ctx->track_width = src->width;
+    if (ctx->track_height > src->height) ctx->track_height = src->height;
+}
 
-                    // Matricula = blobs[i]
-                    // Caracteres =
-                    return 1;
-                }
+/**
+ * Refina na resolução original uma caixa encontrada numa imagem reduzida: o maior blob do pipeline
+ * fine numa região à volta da caixa (com margem de um quarto da largura e metade da altura)
+ * @param ctx
+ * @param src imagem original
+ * @param b caixa em coordenadas da imagem reduzida
+ * @param factor factor de redução
+ * @param refined blob refinado em coordenadas da imagem original
+ * @return 1 se encontrou um blob
+ */
+static int refineCandidate(VC_RECOGNIZER *ctx, IVC *src, OVC b, int factor, OVC *refined) {
+    VC_PIPELINE *fine = &ctx->fine;
+    int found = 0;
+
+    // Região na imagem original com margem para o refinamento
+    int margin_x = (b.width * factor) / 4 + factor;
+    int margin_y = (b.height * factor) / 2 + factor;
+    int x0 = b.x * factor - margin_x;
+    int y0 = b.y * factor - margin_y;
+    int x1 = (b.x + b.width) * factor + margin_x;
+    int y1 = (b.y + b.height) * factor + margin_y;
+
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > src->width) x1 = src->width;
+    if (y1 > src->height) y1 = src->height;
+
+    IVC *roi = cropImage(src, x0, y0, x1 - x0, y1 - y0);
+    if (roi == NULL) return 0;
+
+    // Refinamento: o maior blob da região é a matricula em resolução original
+    if (vc_pipeline_run(fine, roi) && fine->nblobs > 0) {
+        int best = 0;
+        for (int e = 1; e < fine->nblobs; e++) {
+            if (fine->blobs[e].area > fine->blobs[best].area) best = e;
+        }
+        *refined = fine->blobs[best];
+        refined->x += x0;
+        refined->y += y0;
+        refined->xc += x0;
+        refined->yc += y0;
+        found = 1;
+    }
+    vc_image_free(roi);
+    return found;
+}
 
+/**
+ * Procura candidatos a matricula num nivel reduzido da piramide e refina
+ * apenas as bounding boxes selecionadas na resolução original
+ * @param ctx usa ctx->pyramid_levels (1 -> 1/2, 2 -> 1/4)
+ * @param src imagem original
+ * @param ncandidates numero de candidatos devolvidos
+ * @return blobs em coordenadas da imagem original (libertar com free)
+ */
+OVC *pyramidCandidates(VC_RECOGNIZER *ctx, IVC *src, int *ncandidates) {
+    int factor = 1 << ctx->pyramid_levels;
+    VC_PIPELINE *coarse = &ctx->coarse;
+    OVC *candidates;
+    IVC *small;
+
+    *ncandidates = 0;
+
+    small = vc_image_new(src->width / factor, src->height / factor, src->channels, src->levels);
+    if (small == NULL) return NULL;
+    if (!vc_downscale(src, small, factor)) {
+        vc_image_free(small);
+        return NULL;
+    }
 
-            }
-        }
+    // Geração de candidatos no nivel reduzido
+    if (!vc_pipeline_run(coarse, small)) coarse->nblobs = 0;
+
+    candidates = (OVC *)calloc(coarse->nblobs + 1, sizeof(OVC));
 
+    for (int i = 0; (candidates != NULL) && (i < coarse->nblobs); i++) {
+        OVC b = coarse->blobs[i];
 
+        // Prazo ultrapassado: ficam os candidatos já refinados
+        if (vc_deadline_expired()) break;
+
+        // No nivel reduzido os contornos são pouco precisos, os limites são mais largos
+        if (!isPlateCandidate(b, small->width, small->height, 0.5)) continue;
+
+        if (refineCandidate(ctx, src, b, factor, &candidates[*ncandidates])) (*ncandidates)++;
     }
 
-    return 0;
+    vc_image_free(small);
+
+    return candidates;
 }
 
 /**
- * Processa uma imagem passada por argumento e faz o output do processamento para a pasta passada
- * @param name nome da imagem a processar
- * @param directorio directorio de output
+ * Verifica se um blob do mapa de contornos pode ser a faixa dos caracteres de uma matricula:
+ * mais largo que alto (racio entre EDGE_MIN_RATIO e EDGE_MAX_RATIO) e com altura minima
+ * @param blob
+ * @param width largura da imagem onde o blob foi encontrado
+ * @param height altura da imagem onde o blob foi encontrado
+ * @return 1 se for candidato
  */
-int processImage(char *name, char *directorio) {
-    char ficheiro[PATH_MAX] = "";
-    OVC blob_matricula[1];
-    OVC blobs_caracteres[6];
+static int isEdgeBand(OVC blob, int width, int height) {
+    if ((blob.height <= 0) || (blob.height < height * EDGE_MIN_HEIGHT)) return 0;
+    if (blob.width > width / 2) return 0;
 
-    strcat(output_dir,directorio);
-    strcat(output_dir,"");
-    //strcat(ficheiro,directorio);
-    strcat(ficheiro,name);
+    float wh_racio = (float)blob.width / blob.height;
+    return (wh_racio > EDGE_MIN_RATIO) && (wh_racio < EDGE_MAX_RATIO);
+}
 
-    if (!file_exists(ficheiro)) {
-        printf("File %s not found!\n", ficheiro);
-        exit(EXIT_FAILURE);
+/**
+ * Procura candidatos a matricula pela densidade de contornos verticais (os caracteres), sem depender
+ * da cor da matricula: gradiente de Sobel em x a 1/2 (1/4 nas imagens grandes), média horizontal e threshold (edge_stages).
+ * As faixas com forma de linha de caracteres são refinadas na resolução original como em pyramidCandidates
+ * @param ctx
+ * @param src imagem original
+ * @param ncandidates numero de candidatos devolvidos
+ * @return blobs em coordenadas da imagem original (libertar com free)
+ */
+OVC *edgeCandidates(VC_RECOGNIZER *ctx, IVC *src, int *ncandidates) {
+    int factor = (src->width > EDGE_MAX_WIDTH * 2) ? 4 : 2;
+    VC_PIPELINE *edge = &ctx->edge;
+    OVC *candidates;
+    IVC *small;
+
+    *ncandidates = 0;
+
+    small = vc_image_new(src->width / factor, src->height / factor, src->channels, src->levels);
+    if (small == NULL) return NULL;
+    if (!vc_downscale(src, small, factor)) {
+        vc_image_free(small);
+        return NULL;
     }
-    if (!directory_exists(output_dir)) {
-        printf("Directory %s not found!\n", output_dir);
-        exit(EXIT_FAILURE);
+
+    if (!vc_pipeline_run(edge, small)) edge->nblobs = 0;
+
+    candidates = (OVC *)calloc(edge->nblobs + 1, sizeof(OVC));
+
+    for (int i = 0; (candidates != NULL) && (i < edge->nblobs); i++) {
+        OVC b = edge->blobs[i];
+
+        // Prazo ultrapassado: ficam os candidatos já refinados
+        if (vc_deadline_expired()) break;
+
+        if (!isEdgeBand(b, small->width, small->height)) continue;
+
+        if (refineCandidate(ctx, src, b, factor, &candidates[*ncandidates])) (*ncandidates)++;
     }
 
-    IVC *image[10];
-    OVC *blobs[2];
-    OVC *blobs_plate;
-    int numero, numero2;
-    int i;
+    vc_image_free(small);
 
-    // Original file
-    image[0] = vc_read_image(ficheiro);
+    return candidates;
+}
+
+/**
+ * Pipelines de um contexto, sem buffers (criados no primeiro run)
+ * @param ctx
+ */
+static void recognizerPipelinesInit(VC_RECOGNIZER *ctx) {
+    vc_pipeline_init(&ctx->main, main_stages, sizeof(main_stages) / sizeof(VC_STAGE));
+    vc_pipeline_init(&ctx->coarse, coarse_stages, sizeof(coarse_stages) / sizeof(VC_STAGE));
+    vc_pipeline_init(&ctx->fine, main_stages, sizeof(main_stages) / sizeof(VC_STAGE));
+    vc_pipeline_init(&ctx->plate, plate_stages, sizeof(plate_stages) / sizeof(VC_STAGE));
+    vc_pipeline_init(&ctx->edge, edge_stages, sizeof(edge_stages) / sizeof(VC_STAGE));
+    vc_pipeline_init(&ctx->track, main_stages, sizeof(main_stages) / sizeof(VC_STAGE));
+    vc_pipeline_keep(&ctx->plate, 3);
+}
 
-    if (image[0] == NULL) {
-        printf("ERROR -> vc_read_image():\n\tFile not found!\n");
-        exit(EXIT_FAILURE);
+/**
+ * Inicializa um contexto com a configuração por omissão (sem dumps)
+ * @param ctx
+ */
+void vc_recognizer_init(VC_RECOGNIZER *ctx) {
+    memset(ctx, 0, sizeof(VC_RECOGNIZER));
+
+    ctx->threshold_mode = VC_THRESHOLD_FIXED;
+    ctx->white_ratio = 0.3;
+    ctx->char_min_height = 0.4;
+    ctx->char_max_ratio = 0.8;
+    ctx->track_refresh = 25;
+    ctx->track_margin = 0.5;
+
+    recognizerPipelinesInit(ctx);
+}
+
+/**
+ * Inicializa um contexto com toda a configuração de outro (ex: os workers do servidor a partir
+ * do contexto de main). O workspace, o estado do seguimento e o do filtro de frames são próprios:
+ * nada do que config alocou é partilhado
+ * @param ctx
+ * @param config
+ */
+void vc_recognizer_init_from(VC_RECOGNIZER *ctx, const VC_RECOGNIZER *config) {
+    *ctx = *config;
+    ctx->deadline = 0;
+
+    // Workspace
+    recognizerPipelinesInit(ctx);
+    ctx->extract = NULL;
+    ctx->candidates = NULL;
+    ctx->ncandidates = 0;
+    ctx->verify = NULL;
+
+    // Seguimento e filtro de frames (do filtro só o threshold é configuração)
+    ctx->track_roi = NULL;
+    ctx->track_extract = NULL;
+    ctx->track_width = 0;
+    ctx->track_height = 0;
+    memset(&ctx->gate, 0, sizeof(VC_GATE));
+    ctx->gate.threshold = config->gate.threshold;
+    vc_recognizer_reset(ctx);
+}
+
+/**
+ * Liberta o workspace de um contexto
+ * @param ctx
+ */
+void vc_recognizer_free(VC_RECOGNIZER *ctx) {
+    if (ctx->candidates != ctx->main.blobs) free(ctx->candidates);
+    ctx->candidates = NULL;
+    ctx->ncandidates = 0;
+
+    vc_pipeline_free(&ctx->main);
+    vc_pipeline_free(&ctx->coarse);
+    vc_pipeline_free(&ctx->fine);
+    vc_pipeline_free(&ctx->plate);
+    vc_pipeline_free(&ctx->track);
+    vc_pipeline_free(&ctx->edge);
+    ctx->extract = vc_image_free(ctx->extract);
+    ctx->track_roi = vc_image_free(ctx->track_roi);
+    ctx->track_extract = vc_image_free(ctx->track_extract);
+    verifyWorkersFree(ctx->verify);
+    ctx->verify = NULL;
+    vc_recognizer_reset(ctx);
+}
+
+/**
+ * Esquece a matricula seguida e a ultima frame (ex: mudança de camara ou de ligação).
+ * A imagem seguinte é procurada na imagem completa
+ * @param ctx
+ */
+void vc_recognizer_reset(VC_RECOGNIZER *ctx) {
+    ctx->tracked = 0;
+    ctx->track_missed = 0;
+    ctx->track_frames = 0;
+    memset(&ctx->last, 0, sizeof(VC_RESULT));
+    memset(&ctx->previous, 0, sizeof(VC_RESULT));
+    vc_gate_reset(&ctx->gate);
+}
+
+/**
+ * Passa a configuração do contexto para os pipelines.
+ * Só o pipeline principal e o da matricula gravam dumps
+ */
+static void recognizer_configure(VC_RECOGNIZER *ctx) {
+    VC_PIPELINE *pipelines[] = { &ctx->main, &ctx->coarse, &ctx->fine, &ctx->plate, &ctx->track };
+
+    for (int i = 0; i < 5; i++) {
+        pipelines[i]->threshold_mode = ctx->threshold_mode;
+        pipelines[i]->threshold_percentile = ctx->threshold_percentile;
+        pipelines[i]->median_radius = ctx->median_radius;
     }
+    ctx->main.dump_dir = ctx->output_dir;
+    ctx->plate.dump_dir = ctx->output_dir;
+    ctx->edge.dump_dir = ctx->output_dir;
+}
 
-    image[1] = vc_image_new(image[0]->width, image[0]->height, 1, image[0]->levels);
-    image[2] = vc_image_new(image[0]->width, image[0]->height, 1, image[0]->levels);
-    image[3] = vc_image_new(image[0]->width, image[0]->height, 1, image[0]->levels);
-    image[5] = vc_image_new(image[0]->width, image[0]->height, 1, image[0]->levels);
-    image[4] = vc_read_image(ficheiro);
+/**
+ * Reconhece a matricula de uma frame (seguimento ou imagem completa)
+ * @param ctx
+ * @param image imagem valida
+ * @param result
+ * @return 1 se encontrou uma matricula
+ */
+static int recognizeFrame(VC_RECOGNIZER *ctx, IVC *image, VC_RESULT *result) {
+    recognizer_configure(ctx);
+
+    // Os candidatos da imagem anterior deixam de ser validos
+    if (ctx->candidates != ctx->main.blobs) free(ctx->candidates);
+    ctx->candidates = NULL;
+    ctx->ncandidates = 0;
+
+    // Seguimento: só a janela à volta da ultima matricula, até track_misses falhas
+    // seguidas ou track_refresh frames seguidos
+    if (ctx->track_misses > 0 && ctx->tracked &&
+        (ctx->track_refresh <= 0 || ctx->track_frames < ctx->track_refresh)) {
+        VC_STATS_COUNT(VC_STATS_TRACKED, 1);
+        ctx->track_frames++;
+        if (trackPlate(ctx, image, result)) {
+            ctx->track_missed = 0;
+            ctx->last = *result;
+            return 1;
+        }
+        // Sem tempo para procurar: não conta como falha do seguimento
+        if (vc_deadline_expired()) {
+            result->deadline_exceeded = 1;
+            return 0;
+        }
+        if (++ctx->track_missed < ctx->track_misses) return 0;
 
-    debugSave("original",1,image[4]);
-    // Remove cores
-    vc_color_remove(image[4],12,250);
-    debugSave("main_color_remove",2,image[4]);
+        // Falhas a mais: a matricula é procurada na imagem completa nesta mesma frame
+        free(ctx->candidates);
+        ctx->candidates = NULL;
+        ctx->ncandidates = 0;
+    }
 
-    // Transforma em grayscale
-    vc_rgb_to_gray(image[4], image[1]);
-    debugSave("main_rgb_to_gray",3,image[1]);
+    VC_STATS_START(t_detect);
+    if (ctx->edge_candidates) {
+        // Candidatos pela densidade de contornos, refinados na original
+        ctx->candidates = edgeCandidates(ctx, image, &ctx->ncandidates);
+    } else if (ctx->pyramid_levels > 0) {
+        // Candidatos encontrados no nivel reduzido e refinados na original
+        ctx->candidates = pyramidCandidates(ctx, image, &ctx->ncandidates);
+    } else if (vc_pipeline_run(&ctx->main, image)) {
+        ctx->candidates = ctx->main.blobs;
+        ctx->ncandidates = ctx->main.nblobs;
+    }
+    VC_STATS_STOP(VC_STATS_DETECT, t_detect);
+    VC_STATS_COUNT(VC_STATS_BLOBS, ctx->ncandidates);
+
+    int found = potentialBlobs(ctx, image, ctx->candidates, ctx->ncandidates, result);
+    if (!found && vc_deadline_expired()) result->deadline_exceeded = 1;
+
+    // Uma procura interrompida pelo prazo não altera o seguimento
+    if (ctx->track_misses > 0 && !result->deadline_exceeded) trackUpdate(ctx, image, result);
+    return found;
+}
 
-    // Clareia a imagem
-    vc_brigten(image[1],100);
-    debugSave("main_brigten",4,image[1]);
+/**
+ * Reconhece a matricula de uma imagem RGB. A imagem não é alterada.
+ * Com ctx->track_misses > 0 as imagens são tratadas como frames consecutivos:
+ * depois de uma matricula encontrada só é procurada a janela à volta dela.
+ * Com ctx->gate.threshold > 0 uma frame igual à ultima processada devolve o resultado anterior.
+ * Com ctx->deadline != 0 o trabalho pára quando o prazo passa e result->deadline_exceeded indica
+ * que o resultado é parcial (a melhor caixa encontrada, sem texto).
+ * Os tempos e contadores são somados a vc_stats da thread actual
+ * @param ctx contexto (um por thread)
+ * @param image
+ * @param result matricula, caracteres e texto reconhecido
+ * @return 1 se encontrou uma matricula, 0 se não encontrou, -1 se a imagem for invalida
+ */
+int recognize(VC_RECOGNIZER *ctx, IVC *image, VC_RESULT *result) {
+    memset(result, 0, sizeof(VC_RESULT));
+
+    // Verificação de erros
+    if ((image == NULL) || (image->width <= 0) || (image->height <= 0) || (image->data == NULL)) return -1;
+
+    // Frame sem alterações: o resultado anterior continua valido
+    VC_STATS_START(t_gate);
+    int unchanged = vc_gate_check(&ctx->gate, image);
+    VC_STATS_STOP(VC_STATS_GATE, t_gate);
+    if (unchanged) {
+        VC_STATS_COUNT(VC_STATS_SKIPPED, 1);
+        *result = ctx->previous;
+        return result->found;
+    }
+
+    long long deadline = vc_deadline;
+    vc_deadline = ctx->deadline;
+    int found = recognizeFrame(ctx, image, result);
+    vc_deadline = deadline;
+
+    // Um resultado parcial não pode ser reutilizado: a frame seguinte é sempre processada
+    ctx->previous = *result;
+    if (result->deadline_exceeded) vc_gate_reset(&ctx->gate);
+    return found;
+}
+
+/**
+ * Grava a região de uma matricula em dir/<nome da imagem sem extensão>_plate.ppm
+ * @param dir
+ * @param name caminho da imagem original
+ * @param src imagem original
+ * @param plate bounding box da matricula
+ * @return 1 se gravou
+ */
+static int saveCrop(const char *dir, const char *name, IVC *src, OVC plate) {
+    char path[PATH_MAX];
+    const char *base = strrchr(name, '/');
+    const char *ext;
+    int ret;
+
+    base = (base != NULL) ? base + 1 : name;
+    ext = strrchr(base, '.');
+    snprintf(path, sizeof(path), "%s/%.*s_plate.ppm", dir, (ext != NULL) ? (int)(ext - base) : (int)strlen(base), base);
+
+    VC_STATS_START(t);
+    IVC *crop = cropImage(src, plate.x, plate.y, plate.width, plate.height);
+    ret = (crop != NULL) && vc_write_image(path, crop);
+    vc_image_free(crop);
+    VC_STATS_STOP(VC_STATS_DUMP, t);
+    return ret;
+}
+
+/**
+ * Escreve uma caixa como objecto JSON
+ */
+static void printBox(FILE *f, OVC box) {
+    fprintf(f, "{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"area\":%d,\"xc\":%d,\"yc\":%d}",
+            box.x, box.y, box.width, box.height, box.area, box.xc, box.yc);
+}
 
-    // Coloca a imagem em binário
-    vc_gray_to_binary(image[1], image[5], 254);
-    debugSave("main_binary",5,image[5]);
+/**
+ * Escreve o resultado de uma imagem numa linha JSON (NDJSON, um registo por imagem):
+ * matricula, caixa da matricula, caixas dos caracteres e, com vc_stats.enabled, os tempos e contadores
+ * @param f
+ * @param name nome da imagem
+ * @param found retorno de processImage (-1 em erro)
+ * @param result
+ */
+void vc_result_print(FILE *f, const char *name, int found, const VC_RESULT *result) {
+    fprintf(f, "{\"image\":");
+    vc_stats_print_string(f, name);
+    if (found < 0) {
+        fprintf(f, ",\"found\":0,\"error\":1}\n");
+        return;
+    }
+    if (found == 1) fprintf(f, ",\"found\":1,\"plate\":\"%.2s-%.2s-%.2s\"", result->text, result->text + 2, result->text + 4);
+    else fprintf(f, ",\"found\":0,\"plate\":\"\"");
+    fprintf(f, ",\"deadline_exceeded\":%d,\"box\":", result->deadline_exceeded);
+
+    // Sem matricula só o resultado parcial do prazo tem caixa
+    if (found == 1 || result->deadline_exceeded) printBox(f, result->plate);
+    else fprintf(f, "null");
+
+    fprintf(f, ",\"chars\":[");
+    for (int i = 0; i < result->nchars && i < 6; i++) {
+        if (i > 0) fputc(',', f);
+        printBox(f, result->chars[i]);
+    }
+    fputc(']', f);
 
-    // Fecha com kernel 2
-    vc_binary_close(image[5], image[3], 2);
-    debugSave("main_close",6,image[3]);
+    if (vc_stats.enabled) vc_stats_print_fields(f);
+    fprintf(f, "}\n");
+}
 
-    // Dilata a imagem
-    vc_binary_dilate(image[3], image[2], 3);
-    debugSave("main_dilate",7,image[2]);
+/**
+ * Processa uma imagem passada por argumento e faz o output do processamento para ctx->output_dir.
+ * Com ctx->crop_dir != NULL grava também o recorte da matricula encontrada.
+ * Com ctx->budget > 0 o prazo é o inicio desta chamada mais o orçamento
+ * @param ctx
+ * @param name nome da imagem a processar
+ * @param result matricula, caracteres e texto reconhecido
+ * @return 1 se encontrou uma matricula, 0 se não encontrou, -1 em caso de erro
+ */
+int processImage(VC_RECOGNIZER *ctx, char *name, VC_RESULT *result) {
+    IVC *original;
+    int found;
 
-    // Cria imagem de blobs
-    blobs_plate = vc_binary_blob_labelling(image[2], image[3],&numero2);
-    debugSave("main_blobs",8,image[3]);
+    memset(result, 0, sizeof(VC_RESULT));
+    vc_stats_reset();
+    VC_STATS_START(t_total);
 
-    // Vai buscar a info dos blobs
-    vc_binary_blob_info(image[3],blobs_plate, numero2);
+    // O orçamento inclui a leitura da imagem
+    if (ctx->budget > 0) ctx->deadline = vc_stats_now() + ctx->budget;
 
+    // Os erros vão para stderr: no modo só resultados o stdout tem apenas os registos JSON
+    if (!file_exists(name)) {
+        fprintf(stderr, "File %s not found!\n", name);
+        return -1;
+    }
+    if (ctx->output_dir != NULL && !directory_exists(ctx->output_dir)) {
+        fprintf(stderr, "Directory %s not found!\n", ctx->output_dir);
+        return -1;
+    }
+    if (ctx->crop_dir != NULL && !directory_exists(ctx->crop_dir)) {
+        fprintf(stderr, "Directory %s not found!\n", ctx->crop_dir);
+        return -1;
+    }
 
-    int found = potentialBlobs(image[0], blobs_plate, numero2, blob_matricula, blobs_caracteres);
-    if (found == 1) {
-        // Desenha os potenciais blobs
-        desenha_bounding_box(image[0], blob_matricula, 1);
-        debugSave("main_plate_bounding",9,image[0]);
+    // Original file
+    VC_STATS_START(t);
+    original = vc_read_image(name);
+    VC_STATS_STOP(VC_STATS_READ, t);
 
-        desenha_bounding_box(image[0], blobs_caracteres, 6);
-        debugSave("main_plate_bounding_chars",9,image[0]);
+    if (original == NULL) {
+        fprintf(stderr, "ERROR -> vc_read_image():\n\tFile not found!\n");
+        return -1;
+    }
 
-    } else {
-        desenha_bounding_box(image[0], blobs_plate, numero2);
-        debugSave("main_plate_notfound",9,image[0]);
+    found = recognize(ctx, original, result);
 
+    // Só o recorte da matricula, antes de as caixas serem desenhadas na imagem
+    if (ctx->crop_dir != NULL && found == 1) saveCrop(ctx->crop_dir, name, original, result->plate);
 
+    if (ctx->output_dir != NULL) {
+        if (found == 1) {
+            // Desenha os potenciais blobs
+            desenha_bounding_box(original, &result->plate, 1);
+            debugSave(ctx->output_dir, "main_plate_bounding", 9, original);
+
+            desenha_bounding_box(original, result->chars, 6);
+            debugSave(ctx->output_dir, "main_plate_bounding_chars", 9, original);
+        } else {
+            desenha_bounding_box(original, ctx->candidates, ctx->ncandidates);
+            debugSave(ctx->output_dir, "main_plate_notfound", 9, original);
+        }
     }
+
+    vc_image_free(original);
+    VC_STATS_STOP(VC_STATS_TOTAL, t_total);
     return found;
 }
 
 
 /**
- * Clareamento de imagem pela soma
- * @param src
- * @param value
- * @return
+ * Clareamento das linhas (template, channels_src é constante nas instâncias)
  */
-int vc_brigten(IVC *src, int value) {
+VC_TEMPLATE
+static inline int brigten_rows(IVC *src, int value, int channels_src) {
 
     unsigned char *datasrc = (unsigned char *)src->data;
-    int bytesperline_src = src->width * src->channels;
-    int channels_src = src->channels;
+    int bytesperline_src = src->width * channels_src;
     int width = src->width;
     int height = src->height;
     int x, y;
-    long int pos_src, pos_dst;
-
-    // Verifica��o de Erros
-    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
-    if (!((src->channels == 3) || (src->channels == 1))) return 0;
+    long int pos_src;
 
     // Ciclo que vai percorrer todos os pixeis da imagem e converter a imagem
     for (y = 0; y<height; y++)
     {
+        if (VC_DEADLINE_CHECK(y)) return 0;
+
         for (x = 0; x<width; x++)
         {
             pos_src = y * bytesperline_src + x * channels_src;
@@ -474,6 +1584,24 @@ int vc_brigten(IVC *src, int value) {
     return 1;
 }
 
+/**
+ * Clareamento de imagem pela soma
+ * @param src
+ * @param value
+ * @return
+ */
+int vc_brigten(IVC *src, int value) {
+
+    // Verificação de Erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if (!((src->channels == 3) || (src->channels == 1))) return 0;
+
+    // Instâncias com o numero de canais constante: o teste dos canais sai do ciclo
+    if (!vc_cpu_specialised()) return brigten_rows(src, value, src->channels);
+    if (src->channels == 1) return brigten_rows(src, value, 1);
+    return brigten_rows(src, value, 3);
+}
+
 /**
  * Calcula o desvio padrão entre rgb
  * @param r
@@ -505,23 +1633,18 @@ int vc_color_remove(IVC *image, int threshold, int color) {
     int height = image->height;
     int bytesperline = image->bytesperline;
     int channels = image->channels;
-    int x,y;
-    long int pos;
+    int y;
+    const VC_KERNELS *kernels = vc_kernels();
 
     // Verificação de erros
     if((image->width <= 0) || (image->height <= 0) || (image->data == NULL)) return 0;
     if(channels != 3) return 0;
 
+    // O kernel de cada linha faz o mesmo que calcula_desvio(r, g, data[pos + 3]) >= threshold, em inteiros
     for(y = 0; y < height; y++) {
-        for(x = 0; x < width; x++) {
-            pos = y * bytesperline + x * channels;
-            if (calcula_desvio(data[pos],data[pos+1],data[pos+3]) >= threshold) {
-                data[pos] = color;
-                data[pos + 1] = color;
-                data[pos + 2] = color;
-            }
+        if (VC_DEADLINE_CHECK(y)) return 0;
 
-        }
+        kernels->color_remove(data + y * bytesperline, width, threshold, color);
     }
 
     return 1;
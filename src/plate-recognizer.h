@@ -11,20 +11,103 @@
 #ifndef VC_TP1_13871_14383_17442_IMAGE_RECOGNIZER_H
 #define VC_TP1_13871_14383_17442_IMAGE_RECOGNIZER_H
 
+#include <stdio.h> // FILE
 #include "vc.h"
+#include "histogram.h"
+#include "pipeline.h"
+#include "gate.h"
 
+/**
+ * Resultado do reconhecimento de uma imagem
+ */
+typedef struct {
+    int found;                      // 1 se foi encontrada uma matricula com 6 caracteres
+    char text[7];                   // Caracteres reconhecidos, sem separadores
+    OVC plate;                      // Bounding box da matricula
+    OVC chars[6];                   // Bounding boxes dos caracteres
+    int nchars;
+    int deadline_exceeded;          // 1 se o prazo passou: o resultado é o melhor encontrado até lá
+} VC_RESULT;
+
+/**
+ * Contexto do reconhecimento: configuração, destino dos dumps, thresholds e
+ * workspace (pipelines e imagens reutilizados entre imagens).
+ * Não há estado global, cada thread usa o seu contexto
+ */
+typedef struct {
+    // Configuração
+    int pyramid_levels;             // Niveis da piramide na procura de candidatos (0 = resolução original)
+    int edge_candidates;            // 1 procura os candidatos pela densidade de contornos (ignora pyramid_levels)
+    int threshold_mode;             // VC_THRESHOLD_FIXED usa os valores dos estágios
+    float threshold_percentile;
+    int median_radius;              // Mediana dos cinzentos da imagem completa antes da binarização (0 desliga)
+    int deskew;                     // 1 endireita e verifica outra vez os candidatos inclinados que falharam
+
+    // Output: directorio onde são gravadas as imagens intermédias (NULL não grava)
+    const char *output_dir;
+    const char *crop_dir;           // Directorio onde é gravado só o recorte da matricula (NULL não grava)
+
+    // Thresholds da verificação das matriculas
+    float white_ratio;              // Racio de branco a partir do qual é considerado matricula
+    float char_min_height;          // Altura minima de um caracter (fracção da altura da matricula)
+    float char_max_ratio;           // Racio largura/altura máximo de um caracter
+    int max_verifications;          // Candidatos verificados por imagem, do mais provavel para o menos (0 = todos)
+    int verify_threads;             // Threads da verificação dos candidatos (0 ou 1 verifica um de cada vez)
+
+    // Prazo: instante limite (vc_stats_now, ns) da próxima chamada a recognize, 0 sem prazo.
+    // processImage e o servidor calculam-no como inicio do pedido + budget
+    long long deadline;
+    long long budget;               // Orçamento por imagem em ns (0 sem prazo)
+
+    // Seguimento entre frames consecutivos de uma camara fixa
+    int track_misses;               // Falhas seguidas na janela até voltar à imagem completa (0 desliga o seguimento)
+    int track_refresh;              // Procura na imagem completa ao fim de N frames seguidos na janela (0 nunca)
+    float track_margin;             // Margem da janela à volta da matricula (fracção da largura/altura)
+
+    // Frames repetidas: gate.threshold > 0 reutiliza o resultado anterior se a frame não mudou
+    VC_GATE gate;
+    VC_RESULT previous;             // Resultado da ultima frame processada
+
+    // Workspace (um campo novo daqui para baixo tem de ser limpo em vc_recognizer_init_from)
+    VC_PIPELINE main, coarse, fine, plate, track, edge;
+    IVC *extract;                   // Imagem onde cada candidato é extraido
+    OVC *candidates;                // Candidatos da ultima imagem (validos até à chamada seguinte)
+    int ncandidates;
+    struct VC_VERIFY_WORKERS *verify;   // Pool e buffers das threads da verificação (criados no primeiro uso)
+
+    // Estado do seguimento
+    IVC *track_roi;                 // Janela copiada da imagem
+    IVC *track_extract;             // Imagem onde cada candidato da janela é extraido
+    int track_width, track_height;  // Dimensões da janela, fixas enquanto a matricula for seguida
+    int tracked;                    // 1 se last é valido
+    VC_RESULT last;                 // Ultima matricula encontrada (caixa, caracteres e texto)
+    int track_missed;               // Falhas seguidas na janela
+    int track_frames;               // Frames seguidos processados só na janela
+} VC_RECOGNIZER;
+
+void vc_recognizer_init(VC_RECOGNIZER *ctx);
+void vc_recognizer_init_from(VC_RECOGNIZER *ctx, const VC_RECOGNIZER *config);
+void vc_recognizer_free(VC_RECOGNIZER *ctx);
+void vc_recognizer_reset(VC_RECOGNIZER *ctx);
+int recognize(VC_RECOGNIZER *ctx, IVC *image, VC_RESULT *result);
 
 int vc_darken(IVC *src, int value);
 int vc_brigten(IVC *src, int value);
-void debugSave(char *filen,int id, IVC *src);
+void debugSave(const char *dir, char *filen, int id, IVC *src);
 int directory_exists(const char *path);
 int file_exists(const char *path);
 int rgb_to_gray(int r, int g, int b);
 void invertImageBinary(IVC *src);
 void fillImage(IVC *src, unsigned char value);
+IVC *cropImage(IVC *src, int x, int y, int width, int height);
 float extractBlob(IVC *src, IVC *dst, OVC blob);
 float extractBlobBinary(IVC *src, IVC *dst, OVC blob);
-int processImage(char *name, char *directorio);
+int isPlateCandidate(OVC blob, int width, int height, float slack);
+float plateScore(OVC blob, int width, int height);
+OVC *pyramidCandidates(VC_RECOGNIZER *ctx, IVC *src, int *ncandidates);
+OVC *edgeCandidates(VC_RECOGNIZER *ctx, IVC *src, int *ncandidates);
+int processImage(VC_RECOGNIZER *ctx, char *name, VC_RESULT *result);
+void vc_result_print(FILE *f, const char *name, int found, const VC_RESULT *result);
 int calcula_desvio(int r, int g, int b);
 int vc_color_remove(IVC *image, int threshold, int color);
 int desenha_bounding_box(IVC *src, OVC* blobs, int numeroBlobs);
@@ -0,0 +1,516 @@
+/**
+ * Este ficheiro contem o modo servidor (daemon) e o respectivo cliente
+ * @brief Servidor num socket Unix com um pool de workers, cada um com o seu contexto de reconhecimento
+ * @file server.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <stdio.h> // snprintf()
+#include <stdlib.h> // malloc() free()
+#include <string.h> // memcpy() strncmp()
+#include <errno.h> // EINTR
+#include <signal.h> // sigaction()
+#include <pthread.h>
+#include <unistd.h> // read() write() close() unlink() pipe()
+#include <fcntl.h> // O_NONBLOCK
+#include <sys/select.h> // pselect()
+#include <sys/socket.h>
+#include <sys/stat.h> // S_ISSOCK
+#include <sys/un.h> // sockaddr_un
+#include "server.h"
+#include "stats.h"
+
+/**
+ * Leitura com buffer de uma ligação (linhas do protocolo e dados binários)
+ */
+typedef struct {
+    int fd;
+    char buf[VC_SERVER_LINE];
+    int start, end;
+} VC_CONN;
+
+/**
+ * Estado partilhado do servidor: fila de ligações aceites e ligação activa de cada worker
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       // Há ligações na fila (ou o servidor está a terminar)
+    int wake[2];                // Pipe escrito por um worker que tira uma ligação da fila cheia
+    int queue[VC_SERVER_QUEUE];
+    int head, count;
+    int stopping;
+    int stats;                  // Instrumentação ligada no thread principal (vc_stats é por thread)
+    int active[VC_SERVER_MAX_WORKERS];
+    const VC_RECOGNIZER *config;
+} VC_SERVER;
+
+/**
+ * Argumentos de um worker
+ */
+typedef struct {
+    VC_SERVER *server;
+    int id;
+} VC_WORKER;
+
+static volatile sig_atomic_t server_stop = 0;
+
+/**
+ * Handler de SIGINT/SIGTERM: só corre durante o pselect() do thread principal, que o interrompe
+ * @param sig
+ */
+static void server_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+/**
+ * Escreve todos os bytes, repetindo as escritas parciais
+ * @return 1 se escreveu tudo, 0 em caso de erro
+ */
+static int write_all(int fd, const void *data, long int size) {
+    const char *p = data;
+
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+/**
+ * Lê uma linha terminada em '\n' (sem o '\n')
+ * @param c
+ * @param line
+ * @param size
+ * @return comprimento da linha, -1 em EOF/erro ou se a linha não cabe em size
+ */
+static int conn_read_line(VC_CONN *c, char *line, int size) {
+    int len = 0;
+
+    for (;;) {
+        while (c->start < c->end) {
+            char ch = c->buf[c->start++];
+            if (ch == '\n') {
+                if (len > 0 && line[len - 1] == '\r') len--;
+                line[len] = '\0';
+                return len;
+            }
+            if (len >= size - 1) return -1;
+            line[len++] = ch;
+        }
+
+        ssize_t n = read(c->fd, c->buf, sizeof(c->buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        c->start = 0;
+        c->end = (int)n;
+    }
+}
+
+/**
+ * Lê exactamente size bytes, consumindo primeiro o que já está no buffer
+ * @return 1 se leu tudo, 0 em EOF/erro
+ */
+static int conn_read_exact(VC_CONN *c, unsigned char *data, long int size) {
+    int buffered = c->end - c->start;
+
+    if (buffered > 0) {
+        if (buffered > size) buffered = (int)size;
+        memcpy(data, c->buf + c->start, buffered);
+        c->start += buffered;
+        data += buffered;
+        size -= buffered;
+    }
+    while (size > 0) {
+        ssize_t n = read(c->fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        data += n;
+        size -= n;
+    }
+    return 1;
+}
+
+/**
+ * Atende todos os pedidos de uma ligação até o cliente a fechar
+ * @param ctx contexto do worker (workspace reutilizado entre pedidos)
+ * @param fd
+ * @param data buffer das imagens inline, cresce conforme necessário
+ * @param capacity
+ */
+static void server_serve(VC_RECOGNIZER *ctx, int fd, unsigned char **data, long int *capacity) {
+    VC_CONN conn = { .fd = fd };
+    VC_RESULT result;
+    char line[VC_SERVER_LINE];
+    char reply[128];
+    char plate[9];
+    IVC *image;
+    long int size;
+    int found;
+
+    while (conn_read_line(&conn, line, sizeof(line)) >= 0) {
+        vc_stats_reset();
+        VC_STATS_START(t_total);
+        long long start = vc_stats_now();
+
+        // O orçamento conta a partir da chegada do pedido
+        ctx->deadline = ctx->budget > 0 ? start + ctx->budget : 0;
+
+        if (strncmp(line, "FILE ", 5) == 0) {
+            VC_STATS_START(t);
+            image = vc_read_image(line + 5);
+            VC_STATS_STOP(VC_STATS_READ, t);
+            if (image == NULL) {
+                if (!write_all(fd, "ERR cannot read image\n", 22)) break;
+                continue;
+            }
+        } else if (strncmp(line, "DATA ", 5) == 0) {
+            size = atol(line + 5);
+            if (size <= 0 || size > VC_SERVER_MAX_DATA) {
+                // Não é possivel voltar a sincronizar com o cliente
+                write_all(fd, "ERR bad size\n", 13);
+                break;
+            }
+            if (size > *capacity) {
+                unsigned char *grown = realloc(*data, size);
+                if (grown == NULL) {
+                    write_all(fd, "ERR out of memory\n", 18);
+                    break;
+                }
+                *data = grown;
+                *capacity = size;
+            }
+            if (!conn_read_exact(&conn, *data, size)) break;
+
+            VC_STATS_START(t);
+            image = vc_read_image_mem(*data, size);
+            VC_STATS_STOP(VC_STATS_READ, t);
+            if (image == NULL) {
+                if (!write_all(fd, "ERR bad image\n", 14)) break;
+                continue;
+            }
+        } else {
+            if (!write_all(fd, "ERR bad request\n", 16)) break;
+            continue;
+        }
+
+        found = recognize(ctx, image, &result);
+        vc_image_free(image);
+        VC_STATS_STOP(VC_STATS_TOTAL, t_total);
+
+        if (found == 1) {
+            snprintf(plate, sizeof(plate), "%.2s-%.2s-%.2s", result.text, result.text + 2, result.text + 4);
+        } else {
+            strcpy(plate, "-");
+        }
+        if (vc_stats.enabled) {
+            // Uma linha por pedido, sem misturar as linhas dos vários workers
+            flockfile(stderr);
+            vc_stats_print(stderr, line, found == 1, plate);
+            funlockfile(stderr);
+        }
+
+        int len = snprintf(reply, sizeof(reply), "OK %d %s %d %d %d %d %lld %d\n", found == 1, plate,
+                           result.plate.x, result.plate.y, result.plate.width, result.plate.height,
+                           (vc_stats_now() - start) / 1000, result.deadline_exceeded);
+        if (!write_all(fd, reply, len)) break;
+    }
+}
+
+/**
+ * Worker: retira ligações da fila e atende-as com o seu próprio contexto
+ * @param arg VC_WORKER
+ * @return
+ */
+static void *server_worker(void *arg) {
+    VC_WORKER *w = arg;
+    VC_SERVER *s = w->server;
+    VC_RECOGNIZER ctx;
+    unsigned char *data = NULL;
+    long int capacity = 0;
+    int fd;
+
+    // Toda a configuração de main com workspace próprio; os workers nunca gravam imagens intermédias
+    vc_recognizer_init_from(&ctx, s->config);
+    ctx.output_dir = NULL;
+    ctx.crop_dir = NULL;
+    vc_stats.enabled = s->stats;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (s->count == 0 && !s->stopping) pthread_cond_wait(&s->ready, &s->lock);
+        if (s->count == 0) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        fd = s->queue[s->head];
+        s->head = (s->head + 1) % VC_SERVER_QUEUE;
+        s->count--;
+        s->active[w->id] = fd;
+        // O thread principal deixou de aceitar com a fila cheia e espera por este byte
+        if (s->count == VC_SERVER_QUEUE - 1 && write(s->wake[1], "", 1) < 0) perror("wake");
+        pthread_mutex_unlock(&s->lock);
+
+        // Cada ligação é uma sequência de frames independente das anteriores
+        vc_recognizer_reset(&ctx);
+        server_serve(&ctx, fd, &data, &capacity);
+
+        pthread_mutex_lock(&s->lock);
+        s->active[w->id] = -1;
+        pthread_mutex_unlock(&s->lock);
+        close(fd);
+    }
+
+    if (ctx.gate.threshold > 0) {
+        fprintf(stderr, "Worker %d: %ld frames, %ld skipped (%.1f%%)\n", w->id, ctx.gate.frames, ctx.gate.skipped,
+                ctx.gate.frames > 0 ? 100.0 * ctx.gate.skipped / ctx.gate.frames : 0.0);
+    }
+
+    free(data);
+    vc_recognizer_free(&ctx);
+    vc_stats_hw_close();
+    return NULL;
+}
+
+/**
+ * Abre o socket Unix em escuta. Um socket antigo no mesmo caminho é removido
+ * @param path
+ * @return descritor ou -1
+ */
+static int server_listen(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path %s too long!\n", path);
+        return -1;
+    }
+    if (stat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s exists and is not a socket!\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, VC_SERVER_QUEUE) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Corre o servidor até receber SIGINT ou SIGTERM.
+ * O thread principal aceita as ligações e entrega-as aos workers por uma fila;
+ * cada worker mantém o seu workspace entre pedidos (pools dos pipelines, buffer inline)
+ * @param path caminho do socket
+ * @param nworkers numero de workers [1, VC_SERVER_MAX_WORKERS]
+ * @param config configuração copiada para o contexto de cada worker
+ * @return 0 se terminou normalmente, 1 em caso de erro
+ */
+int vc_server_run(const char *path, int nworkers, const VC_RECOGNIZER *config) {
+    VC_SERVER server;
+    VC_WORKER workers[VC_SERVER_MAX_WORKERS];
+    pthread_t threads[VC_SERVER_MAX_WORKERS];
+    struct sigaction sa;
+    sigset_t mask, old;
+    int listen_fd, fd, started = 0;
+
+    if (nworkers < 1) nworkers = 1;
+    if (nworkers > VC_SERVER_MAX_WORKERS) nworkers = VC_SERVER_MAX_WORKERS;
+
+    if ((listen_fd = server_listen(path)) < 0) return 1;
+
+    memset(&server, 0, sizeof(server));
+    if (pipe(server.wake) != 0) {
+        perror("pipe");
+        close(listen_fd);
+        unlink(path);
+        return 1;
+    }
+    // accept() e a leitura do pipe nunca bloqueiam: o thread principal só espera no pselect()
+    fcntl(server.wake[0], F_SETFL, fcntl(server.wake[0], F_GETFL) | O_NONBLOCK);
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    server.config = config;
+    server.stats = vc_stats.enabled;
+    for (int i = 0; i < VC_SERVER_MAX_WORKERS; i++) server.active[i] = -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = server_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Os sinais ficam bloqueados em todos os threads e só são entregues dentro do pselect() do
+    // thread principal, que os desbloqueia atomicamente: um sinal que chega entre o teste de
+    // server_stop e a espera fica pendente e interrompe o pselect() logo que começa
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old);
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].server = &server;
+        workers[i].id = i;
+        if (pthread_create(&threads[i], NULL, server_worker, &workers[i]) != 0) break;
+        started++;
+    }
+
+    if (started == 0) {
+        fprintf(stderr, "Could not start workers!\n");
+    } else {
+        fprintf(stderr, "Listening on %s with %d workers\n", path, started);
+    }
+
+    while (started > 0 && !server_stop) {
+        fd_set fds;
+        char drain[64];
+        int full;
+
+        pthread_mutex_lock(&server.lock);
+        full = (server.count == VC_SERVER_QUEUE);
+        pthread_mutex_unlock(&server.lock);
+
+        // Com a fila cheia só espera pelo pipe (um worker libertou um lugar) ou pelo sinal
+        FD_ZERO(&fds);
+        FD_SET(server.wake[0], &fds);
+        if (!full) FD_SET(listen_fd, &fds);
+        if (pselect(MAX(listen_fd, server.wake[0]) + 1, &fds, NULL, NULL, NULL, &old) < 0) {
+            if (errno == EINTR) continue;
+            perror("pselect");
+            break;
+        }
+        if (FD_ISSET(server.wake[0], &fds)) {
+            while (read(server.wake[0], drain, sizeof(drain)) > 0);
+        }
+        if (full || !FD_ISSET(listen_fd, &fds)) continue;
+
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            perror("accept");
+            break;
+        }
+        // A ligação aceite é bloqueante (o O_NONBLOCK do socket de escuta não passa para ela)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+        // Só este thread acrescenta à fila, por isso ainda há espaço
+        pthread_mutex_lock(&server.lock);
+        server.queue[(server.head + server.count) % VC_SERVER_QUEUE] = fd;
+        server.count++;
+        pthread_cond_signal(&server.ready);
+        pthread_mutex_unlock(&server.lock);
+    }
+
+    // Fecha as ligações activas e em espera e acorda os workers
+    close(listen_fd);
+    unlink(path);
+    pthread_mutex_lock(&server.lock);
+    server.stopping = 1;
+    for (int i = 0; i < server.count; i++) {
+        shutdown(server.queue[(server.head + i) % VC_SERVER_QUEUE], SHUT_RDWR);
+    }
+    for (int i = 0; i < started; i++) {
+        if (server.active[i] >= 0) shutdown(server.active[i], SHUT_RDWR);
+    }
+    pthread_cond_broadcast(&server.ready);
+    pthread_mutex_unlock(&server.lock);
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    close(server.wake[0]);
+    close(server.wake[1]);
+    pthread_cond_destroy(&server.ready);
+    pthread_mutex_destroy(&server.lock);
+    return started == 0;
+}
+
+/**
+ * Liga ao socket do servidor
+ * @param path
+ * @return descritor ou -1
+ */
+int vc_client_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Envia um pedido e espera pela linha de resposta
+ * @param fd ligação aberta com vc_client_connect
+ * @param filename imagem a reconhecer
+ * @param send_inline 1 envia o conteudo do ficheiro (DATA), 0 envia o caminho (FILE)
+ * @param reply resposta do servidor, sem o '\n'
+ * @param size
+ * @return 1 se recebeu a resposta, 0 em caso de erro
+ */
+int vc_client_request(int fd, const char *filename, int send_inline, char *reply, int size) {
+    char header[VC_SERVER_LINE];
+    unsigned char *data = NULL;
+    long int length = 0;
+    int len, ok = 1;
+
+    if (send_inline) {
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL) return 0;
+        fseek(file, 0, SEEK_END);
+        length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length <= 0 || (data = malloc(length)) == NULL || fread(data, 1, length, file) != (size_t)length) ok = 0;
+        fclose(file);
+
+        len = snprintf(header, sizeof(header), "DATA %ld\n", length);
+    } else {
+        len = snprintf(header, sizeof(header), "FILE %s\n", filename);
+        if (len >= (int)sizeof(header)) ok = 0;
+    }
+
+    ok = ok && write_all(fd, header, len) && (data == NULL || write_all(fd, data, length));
+    free(data);
+    if (!ok) return 0;
+
+    // A resposta é uma linha; lida byte a byte para não consumir a resposta seguinte
+    len = 0;
+    for (;;) {
+        char ch;
+        ssize_t n = read(fd, &ch, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        if (ch == '\n') break;
+        if (len < size - 1) reply[len++] = ch;
+    }
+    reply[len] = '\0';
+    return 1;
+}
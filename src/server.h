@@ -0,0 +1,38 @@
+/**
+ * Este ficheiro contem as assinaturas do modo servidor (daemon) e do respectivo cliente
+ * @brief Servidor num socket Unix com um pool de workers, cada um com o seu contexto de reconhecimento
+ * @file server.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Protocolo (uma ligação pode fazer vários pedidos seguidos):
+ *   FILE <caminho>\n           imagem lida pelo servidor do disco
+ *   DATA <bytes>\n<netpbm>     imagem enviada inline (PBM, PGM ou PPM)
+ * Resposta, uma linha por pedido:
+ *   OK <found> <matricula|-> <x> <y> <largura> <altura> <microsegundos> <prazo excedido>\n
+ *   ERR <motivo>\n
+ * Com prazo excedido = 1 a caixa é a melhor encontrada até ao fim do orçamento
+ */
+
+#ifndef VC_TP1_13871_14383_17442_SERVER_H
+#define VC_TP1_13871_14383_17442_SERVER_H
+
+#include "plate-recognizer.h"
+
+// Numero maximo de workers e de ligações em espera
+#define VC_SERVER_MAX_WORKERS 64
+#define VC_SERVER_QUEUE 64
+
+// Tamanho maximo de uma imagem enviada inline (4k RGB cabe com folga)
+#define VC_SERVER_MAX_DATA (64L * 1024 * 1024)
+
+// Tamanho maximo de uma linha do protocolo
+#define VC_SERVER_LINE 4096
+
+int vc_server_run(const char *path, int nworkers, const VC_RECOGNIZER *config);
+int vc_client_connect(const char *path);
+int vc_client_request(int fd, const char *filename, int send_inline, char *reply, int size);
+
+#endif //VC_TP1_13871_14383_17442_SERVER_H
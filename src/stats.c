@@ -0,0 +1,269 @@
+/**
+ * Este ficheiro contem a instrumentação do reconhecimento
+ * @brief Tempos por estágio (relógio monotónico) e contadores de candidatos, uma linha por imagem
+ * @file stats.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memset()
+#include <time.h> // clock_gettime()
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h> // read(), close()
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "stats.h"
+
+_Thread_local VC_STATS vc_stats;
+int vc_stats_hw;
+
+// Contadores de hardware da thread: hw_state 0 por abrir, 1 abertos, -1 indisponiveis
+static _Thread_local int hw_state;
+static _Thread_local int hw_fd[VC_STATS_NHW];
+static _Thread_local int hw_slot[VC_STATS_NHW];    // Posição no grupo ou -1
+static _Thread_local int hw_mask;
+static _Thread_local int hw_count;
+static int hw_warned;
+
+static const char *stage_names[VC_STATS_NSTAGES] = {
+        "total", "read", "detect", "candidates", "extract", "plate", "ocr", "dump", "gate", "deskew"
+};
+
+static const char *op_names[VC_OP_COUNT] = {
+        "dump", "copy", "color_remove", "rgb_to_gray", "brigten", "gray_to_binary",
+        "dilate", "erode", "close", "invert", "labelling", "median",
+        "box_blur", "gaussian_blur", "sobel_x", "box_blur_x"
+};
+
+static const char *counter_names[VC_STATS_NCOUNTERS] = {
+        "blobs", "shape", "verified", "white_ratio", "chars", "tracked", "skipped", "deskewed"
+};
+
+static const char *hw_names[VC_STATS_NHW] = {
+        "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+/**
+ * Tempo monotónico em nanosegundos
+ * @return
+ */
+long long vc_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#ifdef __linux__
+/**
+ * Abre os contadores de hardware da thread actual num grupo (lidos todos com um read).
+ * O primeiro que abrir é o lider; os que o processador não tem ficam de fora
+ */
+static void stats_hw_open(void) {
+    static const unsigned long long configs[VC_STATS_NHW] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    int leader = -1, error = 0;
+
+    hw_mask = 0;
+    hw_count = 0;
+    for (int i = 0; i < VC_STATS_NHW; i++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        hw_slot[i] = -1;
+        hw_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (hw_fd[i] < 0) {
+            error = errno;
+            continue;
+        }
+        if (leader < 0) leader = hw_fd[i];
+        hw_slot[i] = hw_count++;
+        hw_mask |= 1 << i;
+    }
+    hw_state = (leader < 0) ? -1 : 1;
+
+    if (hw_state < 0 && !__atomic_exchange_n(&hw_warned, 1, __ATOMIC_RELAXED)) {
+        fprintf(stderr, "stats: hardware counters unavailable (%s), timings only\n", strerror(error));
+    }
+}
+
+/**
+ * Lê os contadores da thread actual, escalados se o grupo partilhou o processador com outros
+ * @param hw valores por VC_STATS_HW (0 nos que não existem)
+ * @return 0 se não foi possivel ler
+ */
+static int stats_hw_read(long long *hw) {
+    unsigned long long buf[3 + VC_STATS_NHW];
+    int leader = -1;
+
+    memset(hw, 0, VC_STATS_NHW * sizeof(long long));
+    if (hw_state == 0) stats_hw_open();
+    if (hw_state < 0) return 0;
+
+    for (int i = 0; i < VC_STATS_NHW && leader < 0; i++) {
+        if (hw_slot[i] == 0) leader = hw_fd[i];
+    }
+    // nr, tempo activo, tempo a contar e um valor por membro do grupo
+    if (read(leader, buf, sizeof(buf)) < (ssize_t)((3 + hw_count) * sizeof(unsigned long long))) return 0;
+    for (int i = 0; i < VC_STATS_NHW; i++) {
+        if (hw_slot[i] < 0) continue;
+        unsigned long long value = buf[3 + hw_slot[i]];
+        if (buf[2] > 0 && buf[2] < buf[1]) value = (unsigned long long)((double)value * buf[1] / buf[2]);
+        hw[i] = (long long)value;
+    }
+    return 1;
+}
+
+/**
+ * Fecha os contadores de hardware da thread actual (a thread vai terminar)
+ */
+void vc_stats_hw_close(void) {
+    if (hw_state > 0) {
+        for (int i = 0; i < VC_STATS_NHW; i++) {
+            if (hw_slot[i] >= 0) close(hw_fd[i]);
+        }
+    }
+    hw_state = 0;
+}
+#else
+static int stats_hw_read(long long *hw) {
+    memset(hw, 0, VC_STATS_NHW * sizeof(long long));
+    hw_mask = 0;
+    return 0;
+}
+
+void vc_stats_hw_close(void) {
+}
+#endif
+
+/**
+ * Inicio de uma medição: o tempo e, com vc_stats_hw, os contadores de hardware
+ * @return
+ */
+VC_STATS_MARK vc_stats_mark(void) {
+    VC_STATS_MARK mark;
+
+    if (vc_stats_hw) stats_hw_read(mark.hw);
+    else memset(mark.hw, 0, sizeof(mark.hw));
+    mark.ns = vc_stats_now();
+    return mark;
+}
+
+/**
+ * Fim de uma medição: soma o tempo e os contadores desde start
+ * @param ns tempo acumulado do estágio ou operação
+ * @param hw contadores acumulados do estágio ou operação
+ * @param start
+ */
+void vc_stats_stop(long long *ns, long long *hw, const VC_STATS_MARK *start) {
+    *ns += vc_stats_now() - start->ns;
+    if (vc_stats_hw) {
+        long long now[VC_STATS_NHW];
+
+        if (!stats_hw_read(now)) return;
+        for (int i = 0; i < VC_STATS_NHW; i++) hw[i] += now[i] - start->hw[i];
+        vc_stats.hw |= hw_mask;
+    }
+}
+
+/**
+ * Soma à thread actual as medições de outra thread (os tempos e contadores somam o trabalho de todas).
+ * A soma dos picos de memória é um limite superior: as threads não chegam todas ao pico ao mesmo tempo
+ * @param stats
+ */
+void vc_stats_merge(const VC_STATS *stats) {
+    for (int i = 0; i < VC_STATS_NSTAGES; i++) {
+        vc_stats.stage_ns[i] += stats->stage_ns[i];
+        for (int h = 0; h < VC_STATS_NHW; h++) vc_stats.stage_hw[i][h] += stats->stage_hw[i][h];
+    }
+    for (int i = 0; i < VC_OP_COUNT; i++) {
+        vc_stats.op_ns[i] += stats->op_ns[i];
+        for (int h = 0; h < VC_STATS_NHW; h++) vc_stats.op_hw[i][h] += stats->op_hw[i][h];
+    }
+    for (int i = 0; i < VC_STATS_NCOUNTERS; i++) vc_stats.counters[i] += stats->counters[i];
+    vc_stats.hw |= stats->hw;
+
+    vc_stats.memory.live += stats->memory.live;
+    vc_stats.memory.peak += stats->memory.peak;
+    vc_stats.memory.bytes += stats->memory.bytes;
+    vc_stats.memory.allocations += stats->memory.allocations;
+    vc_stats.memory.frees += stats->memory.frees;
+}
+
+/**
+ * Limpa as medições da thread actual, mantendo o estado enabled
+ */
+void vc_stats_reset(void) {
+    int enabled = vc_stats.enabled;
+    memset(&vc_stats, 0, sizeof(VC_STATS));
+    vc_stats.enabled = enabled;
+}
+
+/**
+ * Escreve uma string JSON (entre aspas, com as aspas, barras e caracteres de controlo escapados)
+ * @param f
+ * @param str
+ */
+void vc_stats_print_string(FILE *f, const char *str) {
+    fputc('"', f);
+    for (; str != NULL && *str != '\0'; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/**
+ * Escreve os tempos, contadores e a memória das imagens (bytes) da thread actual como campos de um objecto JSON (",nome":valor...).
+ * Com vc_stats_hw cada tempo é seguido dos contadores de hardware do mesmo estágio ou operação (ex: "op_labelling_cycles")
+ * @param f
+ */
+void vc_stats_print_fields(FILE *f) {
+    if (vc_stats_hw) fprintf(f, ",\"hw\":%d", vc_stats.hw != 0);
+    for (int i = 0; i < VC_STATS_NSTAGES; i++) {
+        fprintf(f, ",\"%s_us\":%.1f", stage_names[i], vc_stats.stage_ns[i] / 1000.0);
+        for (int h = 0; h < VC_STATS_NHW; h++) {
+            if (vc_stats.hw & (1 << h)) fprintf(f, ",\"%s_%s\":%lld", stage_names[i], hw_names[h], vc_stats.stage_hw[i][h]);
+        }
+    }
+    for (int i = 0; i < VC_OP_COUNT; i++) {
+        if (vc_stats.op_ns[i] <= 0) continue;
+        fprintf(f, ",\"op_%s_us\":%.1f", op_names[i], vc_stats.op_ns[i] / 1000.0);
+        for (int h = 0; h < VC_STATS_NHW; h++) {
+            if (vc_stats.hw & (1 << h)) fprintf(f, ",\"op_%s_%s\":%lld", op_names[i], hw_names[h], vc_stats.op_hw[i][h]);
+        }
+    }
+    for (int i = 0; i < VC_STATS_NCOUNTERS; i++) {
+        fprintf(f, ",\"%s\":%ld", counter_names[i], vc_stats.counters[i]);
+    }
+    fprintf(f, ",\"mem_allocations\":%lld,\"mem_bytes\":%lld,\"mem_peak\":%lld,\"mem_live\":%lld",
+            vc_stats.memory.allocations, vc_stats.memory.bytes, vc_stats.memory.peak, vc_stats.memory.live);
+}
+
+/**
+ * Escreve as medições da thread actual numa linha JSON (tempos em microsegundos)
+ * @param f
+ * @param name nome da imagem
+ * @param found 1 se foi encontrada matricula
+ * @param plate texto da matricula (pode ser NULL)
+ */
+void vc_stats_print(FILE *f, const char *name, int found, const char *plate) {
+    fprintf(f, "{\"image\":");
+    vc_stats_print_string(f, name);
+    fprintf(f, ",\"found\":%d,\"plate\":\"%s\"", found, (found && plate != NULL) ? plate : "");
+    vc_stats_print_fields(f);
+    fprintf(f, "}\n");
+}
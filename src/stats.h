@@ -0,0 +1,109 @@
+/**
+ * Este ficheiro contem as assinaturas da instrumentação do reconhecimento
+ * @brief Tempos por estágio (relógio monotónico) e contadores de candidatos, uma linha por imagem
+ * @file stats.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * Com vc_stats_hw ligado cada ponto de medida lê também os contadores de hardware da thread
+ * (perf_event_open, só modo utilizador): ciclos, instruções, falhas da cache de ultimo nivel e
+ * falhas de previsão de saltos. Cada thread abre os seus na primeira medição; sem contadores
+ * (container, VM, kernel.perf_event_paranoid) ficam só os tempos e o registo tem "hw":0.
+ */
+
+#ifndef VC_TP1_13871_14383_17442_STATS_H
+#define VC_TP1_13871_14383_17442_STATS_H
+
+#include <stdio.h>
+#include "pipeline.h"
+#include "memory.h"
+
+/**
+ * Estágios medidos. Os tempos são inclusivos: candidates inclui extract,
+ * plate e ocr; plate inclui os dumps feitos pelo pipeline da matricula
+ */
+typedef enum {
+    VC_STATS_TOTAL,         // processImage completo
+    VC_STATS_READ,          // Leitura da imagem
+    VC_STATS_DETECT,        // Pipeline principal ou piramide
+    VC_STATS_CANDIDATES,    // potentialBlobs
+    VC_STATS_EXTRACT,       // extractBlob (racio de branco)
+    VC_STATS_PLATE,         // processPlate
+    VC_STATS_OCR,           // vc_ocr_plate
+    VC_STATS_DUMP,          // debugSave
+    VC_STATS_GATE,          // Assinatura e comparação com a frame anterior
+    VC_STATS_DESKEW,        // Inclinação e reamostragem dos candidatos inclinados
+    VC_STATS_NSTAGES
+} VC_STATS_STAGE;
+
+/**
+ * Contadores
+ */
+typedef enum {
+    VC_STATS_BLOBS,         // Blobs etiquetados na imagem completa
+    VC_STATS_SHAPE,         // Candidatos com racio e área de matricula
+    VC_STATS_VERIFIED,      // Candidatos extraidos e verificados (até max_verifications)
+    VC_STATS_WHITE,         // Candidatos com racio de branco suficiente
+    VC_STATS_CHARS,         // Caracteres encontrados nos candidatos
+    VC_STATS_TRACKED,       // Imagens processadas só na janela de seguimento
+    VC_STATS_SKIPPED,       // Imagens iguais à anterior (resultado reutilizado)
+    VC_STATS_DESKEWED,      // Candidatos endireitados
+    VC_STATS_NCOUNTERS
+} VC_STATS_COUNTER;
+
+/**
+ * Contadores de hardware
+ */
+typedef enum {
+    VC_STATS_CYCLES,
+    VC_STATS_INSTRUCTIONS,
+    VC_STATS_LLC_MISSES,    // PERF_COUNT_HW_CACHE_MISSES (normalmente a cache de ultimo nivel)
+    VC_STATS_BRANCH_MISSES,
+    VC_STATS_NHW
+} VC_STATS_HW;
+
+/**
+ * Inicio de uma medição
+ */
+typedef struct {
+    long long ns;
+    long long hw[VC_STATS_NHW];
+} VC_STATS_MARK;
+
+/**
+ * Medições de uma imagem. Uma instância por thread
+ */
+typedef struct {
+    int enabled;
+    long long stage_ns[VC_STATS_NSTAGES];
+    long long op_ns[VC_OP_COUNT];           // Tempo por operação dos pipelines
+    long int counters[VC_STATS_NCOUNTERS];
+    long long stage_hw[VC_STATS_NSTAGES][VC_STATS_NHW];
+    long long op_hw[VC_OP_COUNT][VC_STATS_NHW];
+    int hw;                                 // Contadores de hardware lidos (bit 1 << VC_STATS_HW)
+    VC_MEMORY memory;                       // Imagens criadas e libertadas pela imagem (memory.h)
+} VC_STATS;
+
+extern _Thread_local VC_STATS vc_stats;
+// Contadores de hardware pedidos (para todas as threads, ligado antes de as criar)
+extern int vc_stats_hw;
+
+// Com a instrumentação desligada cada ponto de medida custa um teste a vc_stats.enabled
+#define VC_STATS_START(t) VC_STATS_MARK t = vc_stats.enabled ? vc_stats_mark() : (VC_STATS_MARK){ 0 }
+#define VC_STATS_STOP(stage, t) do { if (vc_stats.enabled) vc_stats_stop(&vc_stats.stage_ns[stage], vc_stats.stage_hw[stage], &(t)); } while (0)
+#define VC_STATS_STOP_OP(op, t) do { if (vc_stats.enabled) vc_stats_stop(&vc_stats.op_ns[op], vc_stats.op_hw[op], &(t)); } while (0)
+#define VC_STATS_COUNT(counter, n) do { if (vc_stats.enabled) vc_stats.counters[counter] += (n); } while (0)
+
+long long vc_stats_now(void);
+VC_STATS_MARK vc_stats_mark(void);
+void vc_stats_stop(long long *ns, long long *hw, const VC_STATS_MARK *start);
+void vc_stats_merge(const VC_STATS *stats);
+void vc_stats_hw_close(void);
+void vc_stats_reset(void);
+void vc_stats_print(FILE *f, const char *name, int found, const char *plate);
+void vc_stats_print_string(FILE *f, const char *str);
+void vc_stats_print_fields(FILE *f);
+
+#endif //VC_TP1_13871_14383_17442_STATS_H
@@ -0,0 +1,106 @@
+/**
+ * Este ficheiro contem o pool de threads
+ * @brief Pool de threads fixo: cada chamada corre a mesma função em todas as threads e espera por elas
+ * @file threadpool.c
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ */
+
+#include <string.h> // memset()
+#include "threadpool.h"
+#include "stats.h" // vc_stats_hw_close()
+
+/**
+ * Thread do pool: espera por cada chamada nova, corre a função e avisa quando acaba
+ * @param arg VC_THREADPOOL_THREAD
+ * @return
+ */
+static void *threadpool_thread(void *arg) {
+    VC_THREADPOOL_THREAD *t = arg;
+    VC_THREADPOOL *pool = t->pool;
+    unsigned long generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == generation && !pool->stopping) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stopping) break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->fn(pool->arg, t->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    // Contadores de hardware abertos pelas medições desta thread
+    vc_stats_hw_close();
+    return NULL;
+}
+
+/**
+ * Cria as threads de um pool
+ * @param pool
+ * @param nworkers numero de threads de cada chamada, incluindo a que chama vc_threadpool_run
+ * @return numero de threads de cada chamada (menos que o pedido se não foi possivel criar todas)
+ */
+int vc_threadpool_init(VC_THREADPOOL *pool, int nworkers) {
+    memset(pool, 0, sizeof(VC_THREADPOOL));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (nworkers > VC_THREADPOOL_MAX + 1) nworkers = VC_THREADPOOL_MAX + 1;
+    for (int i = 0; i < nworkers - 1; i++) {
+        pool->thread[i].pool = pool;
+        pool->thread[i].id = i + 1;
+        if (pthread_create(&pool->threads[i], NULL, threadpool_thread, &pool->thread[i]) != 0) break;
+        pool->nthreads++;
+    }
+    pool->nworkers = pool->nthreads + 1;
+    return pool->nworkers;
+}
+
+/**
+ * Corre fn(arg, worker) em todas as threads do pool, incluindo a actual (worker 0),
+ * e espera que todas acabem. Não pode ser chamada ao mesmo tempo por duas threads
+ * @param pool
+ * @param fn
+ * @param arg
+ */
+void vc_threadpool_run(VC_THREADPOOL *pool, VC_THREADPOOL_FN fn, void *arg) {
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->running = pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    fn(arg, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Termina as threads de um pool
+ * @param pool
+ */
+void vc_threadpool_free(VC_THREADPOOL *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    pool->nthreads = 0;
+    pool->nworkers = 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * Este ficheiro contem as assinaturas do pool de threads
+ * @brief Pool de threads fixo: cada chamada corre a mesma função em todas as threads e espera por elas
+ * @file threadpool.h
+ * @date 04 Maio de 2020
+ * @author Rafael Pereira <a13871@alunos.ipca.pt>
+ * @author Óscar Silva <a14383@alunos.ipca.pt>
+ * @author Daniel Torres <a17442@alunos.ipca.pt>
+ *
+ * As threads são criadas uma vez e ficam à espera entre chamadas, por isso uma chamada custa
+ * apenas o acordar das threads. A divisão do trabalho fica a cargo da função (ex: um indice
+ * partilhado protegido por um mutex)
+ */
+
+#ifndef VC_TP1_13871_14383_17442_THREADPOOL_H
+#define VC_TP1_13871_14383_17442_THREADPOOL_H
+
+#include <pthread.h>
+
+// Numero maximo de threads de um pool (sem contar com a que chama vc_threadpool_run)
+#define VC_THREADPOOL_MAX 64
+
+/**
+ * Função corrida por cada thread; worker vai de 0 (a thread que chamou vc_threadpool_run) a nworkers - 1
+ */
+typedef void (*VC_THREADPOOL_FN)(void *arg, int worker);
+
+struct VC_THREADPOOL;
+
+/**
+ * Uma thread do pool
+ */
+typedef struct {
+    struct VC_THREADPOOL *pool;
+    int id;
+} VC_THREADPOOL_THREAD;
+
+/**
+ * Estado do pool
+ */
+typedef struct VC_THREADPOOL {
+    pthread_t threads[VC_THREADPOOL_MAX];
+    VC_THREADPOOL_THREAD thread[VC_THREADPOOL_MAX];
+    int nthreads;                   // Threads criadas
+    int nworkers;                   // nthreads + a thread que chama vc_threadpool_run
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;           // Há uma chamada nova (ou o pool está a terminar)
+    pthread_cond_t done;            // Todas as threads acabaram a chamada
+    unsigned long generation;       // Numero da chamada em curso
+    int running;                    // Threads que ainda não acabaram a chamada
+    int stopping;
+
+    VC_THREADPOOL_FN fn;
+    void *arg;
+} VC_THREADPOOL;
+
+int vc_threadpool_init(VC_THREADPOOL *pool, int nworkers);
+void vc_threadpool_run(VC_THREADPOOL *pool, VC_THREADPOOL_FN fn, void *arg);
+void vc_threadpool_free(VC_THREADPOOL *pool);
+
+#endif //VC_TP1_13871_14383_17442_THREADPOOL_H
@@ -23,7 +23,10 @@
 #include <string.h>
 #include <malloc.h>
 #include "vc.h"
+#include "cpu.h"
+#include "memory.h"
 #include <math.h>
+#include <time.h>
 
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -32,18 +35,31 @@
 
 
 // Alocar memria para uma imagem
-IVC *vc_image_new(int width, int height, int channels, int levels)
+IVC *(vc_image_new)(int width, int height, int channels, int levels)
+{
+	return vc_image_new_at(width, height, channels, levels, NULL, 0);
+}
+
+
+// Alocar memria para uma imagem, contada no sitio file:line (memory.h, file NULL sem sitio)
+IVC *vc_image_new_at(int width, int height, int channels, int levels, const char *file, int line)
 {
 	IVC *image = (IVC *) malloc(sizeof(IVC));
 
 	if(image == NULL) return NULL;
-	if((levels <= 0) || (levels > 255)) return NULL;
+	if((levels <= 0) || (levels > 255))
+	{
+		free(image);
+		return NULL;
+	}
 
 	image->width = width;
 	image->height = height;
 	image->channels = channels;
 	image->levels = levels;
 	image->bytesperline = image->width * image->channels;
+	image->allocated = 0;
+	image->site = -1;
 	image->data = (unsigned char *) malloc(image->width * image->height * image->channels * sizeof(char));
 
 	if(image->data == NULL)
@@ -51,6 +67,9 @@ IVC *vc_image_new(int width, int height, int channels, int levels)
 		return vc_image_free(image);
 	}
 
+	image->allocated = sizeof(IVC) + (long long) image->width * image->height * image->channels;
+	image->site = vc_memory_alloc(image->allocated, file, line);
+
 	return image;
 }
 
@@ -60,6 +79,8 @@ IVC *vc_image_free(IVC *image)
 {
 	if(image != NULL)
 	{
+		if(image->allocated > 0) vc_memory_free(image->allocated, image->site);
+
 		if(image->data != NULL)
 		{
 			free(image->data);
@@ -194,9 +215,13 @@ void bit_to_unsigned_char(unsigned char *databit, unsigned char *datauchar, int
 }
 
 
-IVC *vc_read_image(char *filename)
+/**
+ * L uma imagem PBM, PGM ou PPM de um stream j aberto (no fecha o stream)
+ * @param file
+ * @return imagem lida ou NULL
+ */
+static IVC *vc_read_image_stream(FILE *file)
 {
-	FILE *file = NULL;
 	IVC *image = NULL;
 	unsigned char *tmp;
 	char tok[20];
@@ -205,8 +230,7 @@ IVC *vc_read_image(char *filename)
 	int levels = 255;
 	int v;
 	
-	// Abre o ficheiro
-	if((file = fopen(filename, "rb")) != NULL)
+	if(file != NULL)
 	{
 		// Efectua a leitura do header
 		netpbm_get_token(file, tok, sizeof(tok));
@@ -220,7 +244,6 @@ IVC *vc_read_image(char *filename)
 			printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM, PGM or PPM file.\n\tBad magic number!\n");
 			#endif
 
-			fclose(file);
 			return NULL;
 		}
 		
@@ -233,7 +256,6 @@ IVC *vc_read_image(char *filename)
 				printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM file.\n\tBad size!\n");
 				#endif
 
-				fclose(file);
 				return NULL;
 			}
 
@@ -256,7 +278,6 @@ IVC *vc_read_image(char *filename)
 				#endif
 
 				vc_image_free(image);
-				fclose(file);
 				free(tmp);
 				return NULL;
 			}
@@ -275,7 +296,6 @@ IVC *vc_read_image(char *filename)
 				printf("ERROR -> vc_read_image():\n\tFile is not a valid PGM or PPM file.\n\tBad size!\n");
 				#endif
 
-				fclose(file);
 				return NULL;
 			}
 
@@ -296,11 +316,24 @@ IVC *vc_read_image(char *filename)
 				#endif
 
 				vc_image_free(image);
-				fclose(file);
 				return NULL;
 			}
 		}
-		
+	}
+	
+	return image;
+}
+
+
+IVC *vc_read_image(char *filename)
+{
+	FILE *file = NULL;
+	IVC *image = NULL;
+	
+	// Abre o ficheiro
+	if((file = fopen(filename, "rb")) != NULL)
+	{
+		image = vc_read_image_stream(file);
 		fclose(file);
 	}
 	else
@@ -314,6 +347,29 @@ IVC *vc_read_image(char *filename)
 }
 
 
+/**
+ * L uma imagem PBM, PGM ou PPM a partir de memria (ex: recebida por um socket)
+ * @param data conteudo do ficheiro netpbm
+ * @param size tamanho em bytes
+ * @return imagem lida ou NULL
+ */
+IVC *vc_read_image_mem(const unsigned char *data, long int size)
+{
+	FILE *file = NULL;
+	IVC *image = NULL;
+	
+	if((data == NULL) || (size <= 0)) return NULL;
+	
+	if((file = fmemopen((void *) data, size, "rb")) != NULL)
+	{
+		image = vc_read_image_stream(file);
+		fclose(file);
+	}
+	
+	return image;
+}
+
+
 int vc_write_image(char *filename, IVC *image)
 {
 	FILE *file = NULL;
@@ -381,39 +437,29 @@ int vc_write_image(char *filename, IVC *image)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 // Converter de RGB para Gray
+// O ciclo de cada linha  um kernel de cpu.h (escalar, SSE2, AVX2 ou AVX-512)
 int vc_rgb_to_gray(IVC *src, IVC *dst) {
 
     unsigned char *datasrc = (unsigned char *)src->data;
     int bytesperline_src = src->width * src->channels;
-    int channels_src = src->channels;
     unsigned char *datadst = (unsigned char *)dst->data;
     int bytesperline_dst = dst->width * dst->channels;
-    int channels_dst = dst->channels;
     int width = src->width;
     int height = src->height;
-    int x, y;
-    long int pos_src, pos_dst;
-    float rf, gf, bf;
+    int y;
+    const VC_KERNELS *kernels = vc_kernels();
 
     // Verificao de Erros
     if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
     if ((src->width != dst->width) || (src->height != dst->height)) return 0;
     if ((src->channels != 3) || (dst->channels != 1)) return 0;
 
-    // Ciclo que vai percorrer todos os pixeis da imagem e converter a imagem
+    // Ciclo que vai percorrer todas as linhas da imagem e converter a imagem
     for (y = 0; y<height; y++)
     {
-        for (x = 0; x<width; x++)
-        {
-            pos_src = y * bytesperline_src + x * channels_src;
-            pos_dst = y * bytesperline_dst + x * channels_dst;
-
-            rf = (float)datasrc[pos_src];
-            gf = (float)datasrc[pos_src + 1];
-            bf = (float)datasrc[pos_src + 2];
+        if (VC_DEADLINE_CHECK(y)) return 0;
 
-            datadst[pos_dst] = (unsigned char)((rf * 0.299) + (gf * 0.587) + (bf * 0.114));
-        }
+        kernels->gray(datasrc + y * bytesperline_src, datadst + y * bytesperline_dst, width);
     }
     return 1;
 }
@@ -426,11 +472,10 @@ int vc_gray_to_binary(IVC* src,IVC* dst, int threshold) {
     int channels = src->channels;
     unsigned char *datadst = (unsigned char *)dst->data;
     int bytesperline_dst = dst->width * dst->channels;
-    int channels_dst = dst->channels;
     int width = src->width;
     int height = src->height;
-    int x, y;
-    long int pos_src, pos_dst;
+    int y;
+    const VC_KERNELS *kernels = vc_kernels();
 
     // Verificao de Erros
     if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
@@ -438,129 +483,330 @@ int vc_gray_to_binary(IVC* src,IVC* dst, int threshold) {
     if ((src->channels != 1) || (dst->channels != 1)) return 0;
     if (channels != 1) return 0;
 
-    // Ciclo que vai percorrer todos os pixeis da imagem
+    // Ciclo que vai percorrer todas as linhas da imagem
     for (y = 0; y<height; y++)
     {
-        for (x = 0; x<width; x++)
-        {
-            pos_src = y * bytesperline + x * channels;
-            pos_dst = y * bytesperline_dst + x * channels_dst;
+        if (VC_DEADLINE_CHECK(y)) return 0;
 
-            if (datasrc[pos_src] > threshold) datadst[pos_dst] = 255;
-            else if (datasrc[pos_src] <= threshold) datadst[pos_src] = 0;
-        }
+        kernels->binary(datasrc + y * bytesperline, datadst + y * bytesperline_dst, width, threshold);
     }
     return 1;
 }
 
-// Dilatao de uma imagem em binrio
-int vc_binary_dilate(IVC * src, IVC * dst, int kernel)
+// Actualiza os histogramas das colunas de uma mediana: junta a linha add e tira a linha remove (NULL nenhuma)
+static void vc_median_columns(uint16_t *coarse, uint16_t *fine, const unsigned char *add, const unsigned char *remove, int width)
+{
+	int x;
+
+	for (x = 0; x < width; x++)
+	{
+		coarse[x * 16 + (add[x] >> 4)]++;
+		fine[x * 256 + add[x]]++;
+	}
+	if (remove == NULL) return;
+	for (x = 0; x < width; x++)
+	{
+		coarse[x * 16 + (remove[x] >> 4)]--;
+		fine[x * 256 + remove[x]]--;
+	}
+}
+
+// Filtro de mediana de uma imagem em cinzentos com um quadrado de lado 2 * radius + 1 (rudo sal e pimenta).
+// Cada coluna tem o histograma das 2 * radius + 1 linhas vizinhas, actualizado com uma linha a entrar
+// e outra a sair; a mediana de cada linha sai dos histogramas das colunas (kernel median_row de cpu.h).
+// As margens repetem a primeira / ultima linha e coluna. Pode ser feito in-place (src == dst)
+int vc_gray_median(IVC *src, IVC *dst, int radius)
 {
 	unsigned char *datasrc = (unsigned char *)src->data;
 	int bytesperline_src = src->width * src->channels;
-	int channels_src = src->channels;
 	unsigned char *datadst = (unsigned char *)dst->data;
 	int bytesperline_dst = dst->width * dst->channels;
-	int channels_dst = dst->channels;
 	int width = src->width;
 	int height = src->height;
-	long int pos;
-	int y, x;
-	int aux;
+	int y, ky;
+	const VC_KERNELS *kernels = vc_kernels();
 
-	int offset = kernel / 2;
-	int ky, kx;
-	long int posk;
-
-	// Verificação de erros
+	// Verificao de erros
 	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
-	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
-	if (channels_src != 1) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 1) || (dst->channels != 1)) return 0;
+	if ((radius < 0) || (radius > VC_MEDIAN_MAX_RADIUS)) return 0;
+
+	if (radius == 0) {
+		if (datadst != datasrc) memcpy(datadst, datasrc, bytesperline_src * height);
+		return 1;
+	}
+
+	// In-place: as linhas que ainda vo sair dos histogramas so guardadas antes de serem escritas
+	int nring = radius + 1;
+	int inplace = (datasrc == datadst);
+	uint16_t *coarse = (uint16_t *)calloc(width * 16, sizeof(uint16_t));
+	uint16_t *fine = (uint16_t *)calloc(width * 256, sizeof(uint16_t));
+	unsigned char *ring = inplace ? (unsigned char *)malloc(nring * width) : NULL;
+	if ((coarse == NULL) || (fine == NULL) || (inplace && (ring == NULL))) {
+		free(coarse);
+		free(fine);
+		free(ring);
+		return 0;
+	}
+
+	// Linhas -radius a radius  volta da primeira linha
+	for (ky = -radius; ky <= radius; ky++)
+	{
+		vc_median_columns(coarse, fine, datasrc + MAX(0, MIN(height - 1, ky)) * bytesperline_src, NULL, width);
+	}
 
 	for (y = 0; y < height; y++)
 	{
+		if (VC_DEADLINE_CHECK(y)) {
+			free(coarse);
+			free(fine);
+			free(ring);
+			return 0;
+		}
+
+		if (y > 0) {
+			int yin = MIN(height - 1, y + radius);
+			int yout = MAX(0, y - radius - 1);
+			const unsigned char *out = inplace ? ring + (yout % nring) * width : datasrc + yout * bytesperline_src;
+
+			vc_median_columns(coarse, fine, datasrc + yin * bytesperline_src, out, width);
+		}
+		if (inplace) memcpy(ring + (y % nring) * width, datasrc + y * bytesperline_src, width);
+
+		kernels->median_row(coarse, fine, datadst + y * bytesperline_dst, width, radius);
+	}
+
+	free(coarse);
+	free(fine);
+	free(ring);
+	return 1;
+}
+
+// Passagem horizontal da mdia de uma linha com channels canais intercalados: soma corrente
+// das 2 * radius + 1 colunas vizinhas de cada canal, com as margens repetidas
+static void vc_box_line(const unsigned char *src, unsigned char *dst, int width, int channels, int radius)
+{
+	int divisor = 2 * radius + 1;
+	int x, c, k;
+
+	for (c = 0; c < channels; c++)
+	{
+		int sum = 0;
+
+		for (k = -radius; k <= radius; k++) sum += src[MAX(0, MIN(width - 1, k)) * channels + c];
 		for (x = 0; x < width; x++)
 		{
-			pos = y * bytesperline_src + x * channels_src;
-			aux = 0;
+			if (x > 0) sum += src[MIN(width - 1, x + radius) * channels + c] - src[MAX(0, x - radius - 1) * channels + c];
+			dst[x * channels + c] = (unsigned char)((sum + divisor / 2) / divisor);
+		}
+	}
+}
 
-			// NxM Vizinhos
-			for (ky = -offset; ky <= offset; ky++)
-			{
-				for (kx = -offset; kx <= offset; kx++)
-				{
-					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
-					{
-						posk = (y + ky) * bytesperline_src + (x + kx) * channels_src;
-
-						if (datasrc[posk] == 255) {
-							aux = 255;
-						}
-					}
-				}
-			}
+// Mdia de um quadrado de lado 2 * radius + 1: passagem horizontal para aux e vertical de aux para dst.
+// A vertical mantm uma soma de 16 bits por coluna, actualizada com uma linha a entrar e outra a sair
+// (kernel box_rows de cpu.h). sum tem bytesperline contadores
+static int vc_box_pass(IVC *src, IVC *dst, int radius, unsigned char *aux, uint16_t *sum)
+{
+	int bytesperline = src->width * src->channels;
+	int height = src->height;
+	int y, ky;
+	const VC_KERNELS *kernels = vc_kernels();
 
-			if (aux == 255) datadst[pos] = 255;
-			else datadst[pos] = 0;
-		}
+	for (y = 0; y < height; y++)
+	{
+		if (VC_DEADLINE_CHECK(y)) return 0;
+		vc_box_line(src->data + y * bytesperline, aux + y * bytesperline, src->width, src->channels, radius);
+	}
+
+	// Soma das linhas -radius - 1 a radius - 1: a primeira iterao junta a linha radius e tira a -radius - 1
+	memset(sum, 0, bytesperline * sizeof(uint16_t));
+	for (ky = -radius - 1; ky < radius; ky++)
+	{
+		const unsigned char *row = aux + MAX(0, MIN(height - 1, ky)) * bytesperline;
+		for (int i = 0; i < bytesperline; i++) sum[i] += row[i];
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		if (VC_DEADLINE_CHECK(y)) return 0;
+
+		const unsigned char *add = aux + MIN(height - 1, y + radius) * bytesperline;
+		const unsigned char *sub = aux + MAX(0, y - radius - 1) * bytesperline;
+		kernels->box_rows(sum, add, sub, dst->data + y * bytesperline, bytesperline, 2 * radius + 1);
 	}
 	return 1;
+}
+
+// passes mdias seguidas de src para dst (as seguintes  primeira in-place em dst)
+static int vc_box_blur_passes(IVC *src, IVC *dst, int radius, int passes)
+{
+	int ret = 1;
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+	if ((src->channels != 1) && (src->channels != 3)) return 0;
+	if ((radius < 0) || (radius > VC_BLUR_MAX_RADIUS)) return 0;
+
+	unsigned char *aux = (unsigned char *)malloc(src->width * src->channels * src->height);
+	uint16_t *sum = (uint16_t *)malloc(src->width * src->channels * sizeof(uint16_t));
+	if ((aux == NULL) || (sum == NULL)) {
+		free(aux);
+		free(sum);
+		return 0;
+	}
+
+	for (int pass = 0; (pass < passes) && ret; pass++) ret = vc_box_pass(pass == 0 ? src : dst, dst, radius, aux, sum);
 
+	free(aux);
+	free(sum);
+	return ret;
 }
 
-// Eroso de uma imagem em Binrio
-int vc_binary_erode(IVC * src, IVC * dst, int kernel)
+// Mdia (box blur) de uma imagem de 1 ou 3 canais com um quadrado de lado 2 * radius + 1, em inteiros
+// e arredondada em cada passagem. O custo por pixel no depende do raio. Pode ser feito in-place (src == dst)
+int vc_box_blur(IVC *src, IVC *dst, int radius)
+{
+	return vc_box_blur_passes(src, dst, radius, 1);
+}
+
+// Aproximao de um filtro gaussiano com trs mdias seguidas de raio radius (desvio padro sqrt(radius * (radius + 1)))
+int vc_gaussian_blur(IVC *src, IVC *dst, int radius)
+{
+	return vc_box_blur_passes(src, dst, radius, 3);
+}
+
+// Gradiente horizontal (Sobel x) de uma imagem em cinzentos: |Gx| limitado a 255, margens repetidas.
+// Reala os contornos verticais, como os dos caracteres de uma matricula. src e dst tm de ser diferentes
+int vc_gray_sobel_x(IVC *src, IVC *dst)
 {
 	unsigned char *datasrc = (unsigned char *)src->data;
 	int bytesperline_src = src->width * src->channels;
-	int channels_src = src->channels;
 	unsigned char *datadst = (unsigned char *)dst->data;
 	int bytesperline_dst = dst->width * dst->channels;
-	int channels_dst = dst->channels;
 	int width = src->width;
 	int height = src->height;
-	long int pos;
-	int y, x;
-	int nb;
+	int y;
+	const VC_KERNELS *kernels = vc_kernels();
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 1) || (dst->channels != 1) || (datasrc == datadst)) return 0;
+
+	for (y = 0; y < height; y++)
+	{
+		if (VC_DEADLINE_CHECK(y)) return 0;
+
+		kernels->sobel_x(datasrc + MAX(0, y - 1) * bytesperline_src, datasrc + y * bytesperline_src,
+		                 datasrc + MIN(height - 1, y + 1) * bytesperline_src, datadst + y * bytesperline_dst, width);
+	}
+	return 1;
+}
 
+// Mdia horizontal de 2 * radius + 1 colunas (s a passagem horizontal de vc_box_blur), 1 ou 3 canais.
+// Pode ser feito in-place (src == dst)
+int vc_box_blur_x(IVC *src, IVC *dst, int radius)
+{
+	int bytesperline = src->width * src->channels;
+	int y;
+
+	// Verificao de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+	if ((src->channels != 1) && (src->channels != 3)) return 0;
+	if ((radius < 0) || (radius > VC_BLUR_MAX_RADIUS)) return 0;
+
+	unsigned char *line = (unsigned char *)malloc(bytesperline);
+	if (line == NULL) return 0;
+
+	for (y = 0; y < src->height; y++)
+	{
+		if (VC_DEADLINE_CHECK(y)) {
+			free(line);
+			return 0;
+		}
+		memcpy(line, src->data + y * bytesperline, bytesperline);
+		vc_box_line(line, dst->data + y * bytesperline, src->width, src->channels, radius);
+	}
+
+	free(line);
+	return 1;
+}
+
+// Dilatao (erode = 0) ou eroso (erode = 1) de uma imagem em binrio com um quadrado de lado 2 * (kernel / 2) + 1.
+// O quadrado  separvel: primeiro as linhas vizinhas (255 / 0 exactos como nas verses originais),
+// depois o mximo ou mnimo das colunas vizinhas numa linha com margens neutras
+static int vc_binary_morph(IVC *src, IVC *dst, int kernel, int erode)
+{
+	unsigned char *datasrc = (unsigned char *)src->data;
+	int bytesperline_src = src->width * src->channels;
+	unsigned char *datadst = (unsigned char *)dst->data;
+	int bytesperline_dst = dst->width * dst->channels;
+	int width = src->width;
+	int height = src->height;
+	int y, ky, nrows;
 	int offset = kernel / 2;
-	int ky, kx;
-	long int posk;
+	const VC_KERNELS *kernels = vc_kernels();
+	int square3 = (offset == 1) && vc_cpu_specialised();
 
 	// Verificação de erros
 	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
 	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
-	if (channels_src != 1) return 0;
+	if (src->channels != 1) return 0;
+
+	// Kernel negativo: sem vizinhos, a dilatao d 0 e a eroso 255 em todos os pixeis
+	int empty = (offset < 0);
+	if (empty) offset = 0;
+
+	const unsigned char **rows = (const unsigned char **)malloc((2 * offset + 1) * sizeof(unsigned char *));
+	unsigned char *line = (unsigned char *)malloc(width + 2 * offset);
+	if ((rows == NULL) || (line == NULL)) {
+		free(rows);
+		free(line);
+		return 0;
+	}
+	memset(line, erode ? 255 : 0, width + 2 * offset);
 
 	for (y = 0; y < height; y++)
 	{
-		for (x = 0; x < width; x++)
+		if (VC_DEADLINE_CHECK(y)) {
+			free(rows);
+			free(line);
+			return 0;
+		}
+
+		// NxM Vizinhos: linhas dentro da imagem
+		nrows = 0;
+		for (ky = -offset; ky <= offset && !empty; ky++)
 		{
-			pos = y * bytesperline_src + x * channels_src;
-			nb = 255;
+			if ((y + ky >= 0) && (y + ky < height)) rows[nrows++] = datasrc + (y + ky) * bytesperline_src;
+		}
 
-			// NxM Vizinhos
-			for (ky = -offset; ky <= offset; ky++)
-			{
-				for (kx = -offset; kx <= offset; kx++)
-				{
-					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
-					{
-						posk = (y + ky) * bytesperline_src + (x + kx) * channels_src;
-
-						if (datasrc[posk] == 0) {
-							nb = 0;
-						}
-					}
-				}
-			}
+		// Quadrado 3x3 (kernel 2 e 3, os do pipeline): passagens especializadas, sem ciclos nos vizinhos
+		if (square3 && (nrows == 3)) kernels->morph_rows3(rows, line + offset, width, erode);
+		else kernels->morph_rows(rows, nrows, line + offset, width, erode);
 
-			if (nb != 0) datadst[pos] = 255;
-			else datadst[pos] = 0;
-		}
+		if (square3) kernels->morph_cols3(line + offset, datadst + y * bytesperline_dst, width, erode);
+		else kernels->morph_cols(line + offset, datadst + y * bytesperline_dst, width, offset, erode);
 	}
+
+	free(rows);
+	free(line);
 	return 1;
+}
 
+// Dilatao de uma imagem em binrio
+int vc_binary_dilate(IVC * src, IVC * dst, int kernel)
+{
+	return vc_binary_morph(src, dst, kernel, 0);
+}
+
+// Eroso de uma imagem em Binrio
+int vc_binary_erode(IVC * src, IVC * dst, int kernel)
+{
+	return vc_binary_morph(src, dst, kernel, 1);
 }
 
 // Fecho de uma imagem em Binrio
@@ -625,6 +871,11 @@ OVC* vc_binary_blob_labelling(IVC *src, IVC *dst, int *nlabels) {
 
     // Efectua a etiquetagem
     for (y = 1; y<height - 1; y++) {
+        if (VC_DEADLINE_CHECK(y)) {
+            *nlabels = 0;
+            return NULL;
+        }
+
         for (x = 1; x<width - 1; x++) {
             // Kernel:
             // A B C
@@ -639,6 +890,11 @@ OVC* vc_binary_blob_labelling(IVC *src, IVC *dst, int *nlabels) {
             // Se o pixel foi marcado
             if (datadst[posX] != 0) {
                 if ((datadst[posA] == 0) && (datadst[posB] == 0) && (datadst[posC] == 0) && (datadst[posD] == 0)) {
+                    // Tabela de etiquetas cheia: a imagem tem demasiados objectos
+                    if (label >= 1024) {
+                        *nlabels = 0;
+                        return NULL;
+                    }
                     datadst[posX] = label;
                     labeltable[label] = label;
                     label++;
@@ -757,6 +1013,9 @@ int vc_binary_blob_info(IVC *src, OVC *blobs, int nblobs) {
 
     // Conta rea de cada blob
     for (i = 0; i<nblobs; i++) {
+        // Cada blob percorre a imagem inteira
+        if (vc_deadline_expired()) return 0;
+
         xmin = width - 1;
         ymin = height - 1;
         xmax = 0;
@@ -810,4 +1069,84 @@ int vc_binary_blob_info(IVC *src, OVC *blobs, int nblobs) {
 }
 
 
+// Reduo 2x por mdia de blocos 2x2 (1 ou 3 canais). O ciclo de cada linha  o kernel downscale2 de cpu.h
+static int vc_downscale2(IVC *src, IVC *dst) {
+    const VC_KERNELS *kernels = vc_kernels();
+
+    for (int y = 0; y < dst->height; y++) {
+        unsigned char *row0 = src->data + (2 * y) * src->bytesperline;
+
+        kernels->downscale2(row0, row0 + src->bytesperline, dst->data + y * dst->bytesperline, dst->width, src->channels);
+    }
+    return 1;
+}
+
+// Reduo de uma imagem por um factor 2 ou 4 (mdia de blocos)
+// O factor 4  feito com duas redues 2x, como os niveis de uma piramide
+int vc_downscale(IVC *src, IVC *dst, int factor) {
+    int ret;
+
+    // Verificao de erros
+    if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+    if ((factor != 2) && (factor != 4)) return 0;
+    if ((dst->width != src->width / factor) || (dst->height != src->height / factor)) return 0;
+    if ((src->channels != dst->channels) || (dst->width <= 0) || (dst->height <= 0)) return 0;
+
+    if (factor == 2) return vc_downscale2(src, dst);
+
+    IVC *aux = vc_image_new(src->width / 2, src->height / 2, src->channels, src->levels);
+    if (aux == NULL) return 0;
+
+    ret = vc_downscale2(src, aux) && vc_downscale2(aux, dst);
+
+    vc_image_free(aux);
+
+    return ret;
+}
+
+
+// Reamostragem bilinear (virgula fixa 16.16, pesos de 8 bits) de uma regio rodada de uma imagem RGB:
+// o pixel (u, v) de dst vem do ponto de src a (u - (W - 1) / 2, v - (H - 1) / 2) de (cx, cy) nos eixos rodados
+// de angle radianos (y para baixo). Pontos fora de src repetem as margens. O custo  o da rea de dst
+int vc_rgb_deskew(IVC *src, IVC *dst, float cx, float cy, float angle)
+{
+	const VC_KERNELS *kernels = vc_kernels();
+	double c = cos(angle), s = sin(angle);
+	int32_t dx = (int32_t)lround(c * 65536.0), dy = (int32_t)lround(s * 65536.0);
+	int v;
+
+	// Verificao de erros
+	if ((src->width < 2) || (src->height < 2) || (src->data == NULL)) return 0;
+	if ((dst->width <= 0) || (dst->height <= 0) || (dst->width > 32767) || (dst->data == NULL)) return 0;
+	if ((src->channels != 3) || (dst->channels != 3) || (src->data == dst->data)) return 0;
+
+	for (v = 0; v < dst->height; v++)
+	{
+		if (VC_DEADLINE_CHECK(v)) return 0;
+
+		// Inicio da linha em double, os pixeis seguintes com o passo em virgula fixa
+		double u0 = -(dst->width - 1) / 2.0, v0 = v - (dst->height - 1) / 2.0;
+		double x = cx + u0 * c - v0 * s, y = cy + u0 * s + v0 * c;
+
+		kernels->warp_row(src->data, src->bytesperline, src->width, src->height, dst->data + v * dst->bytesperline, dst->width,
+		                  (int32_t)lround(x * 65536.0), (int32_t)lround(y * 65536.0), dx, dy);
+	}
+	return 1;
+}
+
+
+_Thread_local long long vc_deadline = 0;
+
+/**
+ * Verifica se o prazo da thread actual (vc_deadline) j passou
+ * @return 1 se h prazo e j foi ultrapassado
+ */
+int vc_deadline_expired(void)
+{
+	struct timespec ts;
+	long long deadline = __atomic_load_n(&vc_deadline, __ATOMIC_RELAXED);
 
+	if (deadline == 0) return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec) >= deadline;
+}
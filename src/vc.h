@@ -14,8 +14,11 @@
 //             [  DUARTE DUQUE - dduque@ipca.pt  ]
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
+#ifndef VC_H
+#define VC_H
 
 //#define VC_DEBUG 0
+//#define VC_MEMORY_SITES	// vc_image_new regista o ficheiro e a linha de cada chamada (memory.h)
 
 #define MAX(a, b) (a > b ? a : b)
 #define MIN(a, b) (a < b ? a : b)
@@ -47,6 +50,8 @@ typedef struct {
 	int channels;			// Binário/Cinzentos=1; RGB=3
 	int levels;				// Binário=1; Cinzentos [1,255]; RGB [1,255]
 	int bytesperline;		// width * channels
+	long long allocated;	// Bytes contados por vc_image_new (0 se a imagem no foi criada por vc_image_new)
+	int site;				// Sitio de vc_image_new na contabilidade da memria (-1 sem sitio)
 } IVC;
 
 
@@ -57,10 +62,16 @@ typedef struct {
 
 // FUNÇOES: ALOCAR E LIBERTAR UMA IMAGEM
 IVC *vc_image_new(int width, int height, int channels, int levels);
+IVC *vc_image_new_at(int width, int height, int channels, int levels, const char *file, int line);
 IVC *vc_image_free(IVC *image);
 
+#ifdef VC_MEMORY_SITES
+#define vc_image_new(width, height, channels, levels) vc_image_new_at(width, height, channels, levels, __FILE__, __LINE__)
+#endif
+
 // FUNÇOES: LEITURA E ESCRITA DE IMAGENS (PBM, PGM E PPM)
 IVC *vc_read_image(char *filename);
+IVC *vc_read_image_mem(const unsigned char *data, long int size);
 int vc_write_image(char *filename, IVC *image);
 
 
@@ -81,6 +92,21 @@ int vc_rgb_to_gray(IVC *src, IVC *dst);
 int vc_gray_to_binary(IVC* src,IVC* dst, int threshold);
 
 
+// FUNÇÃO DE FILTRAGEM: mediana de um quadrado de lado 2 * radius + 1 (custo por pixel independente do raio)
+#define VC_MEDIAN_MAX_RADIUS 127
+int vc_gray_median(IVC *src, IVC *dst, int radius);
+
+// FUNÇÕES DE SUAVIZAÇÃO: média de um quadrado de lado 2 * radius + 1 e gaussiana aproximada por três médias
+// (1 ou 3 canais, só inteiros, custo por pixel independente do raio)
+#define VC_BLUR_MAX_RADIUS 127
+int vc_box_blur(IVC *src, IVC *dst, int radius);
+int vc_gaussian_blur(IVC *src, IVC *dst, int radius);
+int vc_box_blur_x(IVC *src, IVC *dst, int radius);
+
+// FUNÇÃO DE CONTORNOS: gradiente horizontal de Sobel (|Gx| limitado a 255)
+int vc_gray_sobel_x(IVC *src, IVC *dst);
+
+
 // FUNÇOES DE OPERADORES MORFOLOGICOS
 int vc_binary_dilate(IVC *src, IVC *dst, int kernel);
 int vc_binary_erode(IVC *src, IVC *dst, int kernel);
@@ -90,4 +116,18 @@ int vc_binary_close(IVC *src, IVC *dst, int kernel);
 OVC* vc_binary_blob_labelling(IVC *src, IVC *dst, int *nlabels);
 int vc_binary_blob_info(IVC *src, OVC *blobs, int nblobs);
 
+// FUNÇÕES DE REDIMENSIONAMENTO
+int vc_downscale(IVC *src, IVC *dst, int factor);
+
+// FUNÇÃO DE REAMOSTRAGEM: região rodada de uma imagem RGB com interpolação bilinear em virgula fixa
+int vc_rgb_deskew(IVC *src, IVC *dst, float cx, float cy, float angle);
+
+// PRAZO DE EXECUÇÃO: instante limite da thread actual (ns, CLOCK_MONOTONIC), 0 sem prazo.
+// Os kernels longos verificam-no a cada VC_DEADLINE_ROWS linhas e devolvem erro se já passou.
+// Outra thread pode pô-lo no passado para cancelar o trabalho (verificação dos candidatos em paralelo)
+extern _Thread_local long long vc_deadline;
+#define VC_DEADLINE_ROWS 16
+#define VC_DEADLINE_CHECK(y) ((__atomic_load_n(&vc_deadline, __ATOMIC_RELAXED) != 0) && (((y) % VC_DEADLINE_ROWS) == 0) && vc_deadline_expired())
+int vc_deadline_expired(void);
 
+#endif //VC_H